@@ -0,0 +1,427 @@
+// lumine_bench: throughput of the hot paths on synthetic images.
+//
+// Every case runs on images generated in-process (smooth shading plus
+// text-like strokes and noise, seeded, so runs are comparable), is warmed
+// up once and then timed until both --reps and --min-time are reached.
+// Results report the median per-run time as Mpix/s and ns/pixel of the
+// input, plus the spread across runs. --json writes them in a format
+// --baseline reads back: cases slower than the baseline by more than
+// --tolerance are flagged and make the exit status 1.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lumine/binary_image.hpp"
+#include "lumine/components.hpp"
+#include "lumine/conv_plan.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/filter_bank.hpp"
+#include "lumine/image.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/pipeline.hpp"
+#include "lumine/preprocessing.hpp"
+#include "lumine/thread_pool.hpp"
+
+using namespace lumine;
+
+namespace {
+
+struct Options {
+    std::vector<Size> sizes{{640, 480}, {1920, 1080}};
+    std::vector<int> threads;  // default: 1 and all hardware threads
+    std::vector<std::string> filters;
+    int reps{5};
+    double min_time{0.2};
+    std::string json, baseline;
+    double tolerance{0.10};
+    bool list{false};
+};
+
+struct Result {
+    std::string name;
+    Size size;
+    int threads{1};
+    int runs{0};
+    double median_ms{0}, mean_ms{0}, min_ms{0}, stddev_ms{0};
+
+    double pixels() const { return (double)size.width * size.height; }
+    double mpix_per_s() const { return pixels() / (median_ms * 1e3); }
+    double ns_per_pixel() const { return median_ms * 1e6 / pixels(); }
+    double cv_percent() const { return mean_ms > 0 ? 100.0 * stddev_ms / mean_ms : 0.0; }
+};
+
+// A case is prepared once per (size, threads) and returns the timed body.
+struct Case {
+    std::string name;
+    std::function<std::function<void()>(Size, int)> prepare;
+};
+
+uint32_t xorshift(uint32_t& s) {
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+// Page-like content: a smooth illumination gradient, dark horizontal
+// "text" strokes of varying length, and a little noise per channel.
+Image synthetic_image(Size size, int channels, uint32_t seed = 0x9e3779b9u) {
+    Image img(size.width, size.height, channels, Fill::None);
+    for (int c = 0; c < channels; ++c) {
+        uint32_t s = seed + 7919u * (uint32_t)c;
+        for (int y = 0; y < size.height; ++y) {
+            float* row = img.row(y, c);
+            const bool text_line = (y / 6) % 4 != 3 && y % 6 < 4;
+            for (int x = 0; x < size.width; ++x) {
+                float v = 0.75f + 0.2f * (float)x / (float)size.width - 0.15f * (float)y / (float)size.height;
+                if (text_line && ((x / 9) * 2654435761u >> 28) % 3 != 0 && x % 9 < 6) v *= 0.25f;
+                v += ((float)(xorshift(s) & 0xff) - 127.5f) * (0.04f / 255.0f);
+                row[x] = std::clamp(v, 0.0f, 1.0f);
+            }
+        }
+    }
+    return img;
+}
+
+Kernel random_kernel(int size, uint32_t seed) {
+    std::vector<float> w((size_t)size * size);
+    uint32_t s = seed;
+    for (float& v : w) v = ((float)(xorshift(s) & 0xffff) / 65535.0f - 0.5f) / (float)size;
+    return Kernel(size, size, w);
+}
+
+Kernel gaussian_kernel(int size) {
+    std::vector<float> g(size), w((size_t)size * size);
+    const float sigma = size / 6.0f;
+    float sum = 0;
+    for (int i = 0; i < size; ++i) sum += g[i] = std::exp(-0.5f * std::pow((i - size / 2) / sigma, 2.0f));
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x) w[(size_t)y * size + x] = g[y] * g[x] / (sum * sum);
+    return Kernel(size, size, w);
+}
+
+Case conv_case(const std::string& name, Kernel K, int stride, Padding pad, int channels = 1,
+               ConvAlgo algo = ConvAlgo::Auto) {
+    return Case{name, [=](Size size, int threads) {
+        auto in = std::make_shared<Image>(synthetic_image(size, channels));
+        ConvParams p;
+        p.stride = stride;
+        p.padding = pad;
+        p.algo = algo;
+        p.threads = threads;
+        auto plan = std::make_shared<ConvPlan>(K, size.width, size.height, channels, p);
+        const Size o = plan->output_size();
+        auto out = std::make_shared<Image>(o.width, o.height, channels, Fill::None);
+        return std::function<void()>([=] { plan->execute(*in, *out); });
+    }};
+}
+
+Case u8_case(const std::string& name, Kernel K) {
+    return Case{name, [=](Size size, int threads) {
+        auto in = std::make_shared<Image8>(synthetic_image(size, 1).convert<uint8_t>());
+        ConvParams p;
+        p.threads = threads;
+        auto out = std::make_shared<Image8>(size.width, size.height, 1, Fill::None);
+        return std::function<void()>([=] { Convolver::convolve(*in, *out, K, p); });
+    }};
+}
+
+Case bank_case(const std::string& name, FilterBank bank) {
+    return Case{name, [=](Size size, int threads) {
+        auto in = std::make_shared<Image>(synthetic_image(size, 1));
+        ConvParams p;
+        p.padding = Padding::EDGE;
+        p.threads = threads;
+        auto out = std::make_shared<Image>(size.width, size.height, 1, Fill::None);
+        return std::function<void()>([=] { bank.apply(*in, *out, p); });
+    }};
+}
+
+template <typename Fn>
+Case pre_case(const std::string& name, int channels, Fn fn) {
+    return Case{name, [=](Size size, int threads) {
+        auto in = std::make_shared<Image>(synthetic_image(size, channels));
+        auto out = std::make_shared<Image>(size.width, size.height, 1, Fill::None);
+        return std::function<void()>([=] { fn(*in, *out, threads); });
+    }};
+}
+
+// Operations on the Sauvola bits of the synthetic page.
+template <typename Fn>
+Case binary_case(const std::string& name, Fn fn) {
+    return Case{name, [=](Size size, int threads) {
+        auto in = std::make_shared<BinaryImage>(Preprocessing::sauvola_binary(synthetic_image(size, 1)));
+        return std::function<void()>([=] { fn(*in, threads); });
+    }};
+}
+
+std::vector<Case> all_cases() {
+    std::vector<Case> cases;
+    const char* pad_name[] = {"zero", "edge"};
+    for (const char* b : {"identity", "box3", "box5", "sharpen", "sobel_x", "sobel_y", "gauss5"})
+        for (Padding pad : {Padding::ZERO, Padding::EDGE})
+            cases.push_back(conv_case(std::string("conv/") + b + "/s1/" + pad_name[(int)pad],
+                                      Kernel::from_builtin(b), 1, pad));
+    for (int stride : {2, 3})
+        for (const char* b : {"gauss5", "sobel_x"})
+            cases.push_back(conv_case(std::string("conv/") + b + "/s" + std::to_string(stride) + "/zero",
+                                      Kernel::from_builtin(b), stride, Padding::ZERO));
+    cases.push_back(conv_case("conv/gauss5/s1/zero/rgb", Kernel::from_builtin("gauss5"), 1, Padding::ZERO, 3));
+    for (int k : {7, 15, 31})
+        cases.push_back(conv_case("conv/gauss" + std::to_string(k) + "/s1/edge", gaussian_kernel(k), 1, Padding::EDGE));
+    for (int k : {3, 7, 15, 31})
+        cases.push_back(conv_case("conv/dense" + std::to_string(k) + "/s1/zero", random_kernel(k, 1234u + k), 1,
+                                  Padding::ZERO));
+    // the recursive blurs against the same weights as separable FIR passes
+    for (const char* b : {"gauss:2", "gauss:8", "gauss:30", "box:3", "box:15"})
+        for (ConvAlgo algo : {ConvAlgo::Recursive, ConvAlgo::Separable})
+            cases.push_back(conv_case(std::string("conv/") + b + "/s1/edge/" +
+                                      (algo == ConvAlgo::Recursive ? "recursive" : "separable"),
+                                      Kernel::from_builtin(b), 1, Padding::EDGE, 1, algo));
+    for (const char* b : {"sobel_mag", "sobel_dir", "kirsch_max"})
+        cases.push_back(bank_case(std::string("bank/") + b, FilterBank::from_builtin(b)));
+    cases.push_back(u8_case("u8/box3/s1/zero", Kernel::from_builtin("box3")));
+    cases.push_back(u8_case("u8/gauss5/s1/zero", Kernel::from_builtin("gauss5")));
+
+    cases.push_back(pre_case("pre/grayscale", 3, [](const Image& in, Image& out, int t) {
+        Preprocessing::grayscale(in, out, t);
+    }));
+    for (int r : {1, 2, 4})
+        cases.push_back(pre_case("pre/denoise/r" + std::to_string(r), 1, [r](const Image& in, Image& out, int t) {
+            Preprocessing::denoise(in, out, r, Padding::EDGE, t);
+        }));
+    for (int w : {15, 31})
+        cases.push_back(pre_case("pre/sauvola/w" + std::to_string(w), 1, [w](const Image& in, Image& out, int t) {
+            Preprocessing::sauvola_binarization(in, out, 0.2f, w, t);
+        }));
+    cases.push_back(Case{"pre/sauvola/w15/bits", [](Size size, int threads) {
+        auto in = std::make_shared<Image>(synthetic_image(size, 1));
+        auto out = std::make_shared<BinaryImage>(size.width, size.height, Fill::None);
+        return std::function<void()>([=] { Preprocessing::sauvola_binarization(*in, *out, 0.2f, 15, threads); });
+    }});
+    cases.push_back(pre_case("pre/deskew/estimate", 1, [](const Image& in, Image&, int t) {
+        Preprocessing::estimate_skew(in, 5.0, t);
+    }));
+    for (int deg : {1, 4})
+        cases.push_back(pre_case("pre/rotate/" + std::to_string(deg) + "deg", 1, [deg](const Image& in, Image& out, int t) {
+            Preprocessing::rotate(in, out, deg, 1.0f, t);
+        }));
+    cases.push_back(binary_case("binary/open/r1", [](const BinaryImage& b, int t) { Morphology::open(b, 1, 1, t); }));
+    cases.push_back(binary_case("binary/close/r5", [](const BinaryImage& b, int t) { Morphology::close(b, 5, 5, t); }));
+    cases.push_back(binary_case("binary/row_profile", [](const BinaryImage& b, int t) { b.row_profile(t); }));
+    cases.push_back(binary_case("binary/column_profile", [](const BinaryImage& b, int t) { b.column_profile(t); }));
+    for (Connectivity c : {Connectivity::Four, Connectivity::Eight})
+        cases.push_back(binary_case(std::string("binary/components/") + (c == Connectivity::Four ? "c4" : "c8"),
+                                    [c](const BinaryImage& b, int t) { ConnectedComponents::label(b, c, false, t); }));
+    cases.push_back(Case{"pipeline/gray+denoise+sauvola+gauss5", [](Size size, int threads) {
+        auto in = std::make_shared<Image>(synthetic_image(size, 3));
+        auto p = std::make_shared<Pipeline>();
+        p->grayscale().denoise(1).binarize().convolve(Kernel::from_builtin("gauss5"), ConvParams{});
+        return std::function<void()>([=] { p->run(*in, threads); });
+    }});
+    return cases;
+}
+
+Result measure(const std::string& name, Size size, int threads, const std::function<void()>& body,
+               const Options& o) {
+    using clock = std::chrono::steady_clock;
+    body(); // warm-up: pool buffers, plan caches, page faults
+    std::vector<double> ms;
+    const auto start = clock::now();
+    while ((int)ms.size() < o.reps ||
+           (std::chrono::duration<double>(clock::now() - start).count() < o.min_time && ms.size() < 1000)) {
+        const auto t0 = clock::now();
+        body();
+        ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+    }
+    Result r;
+    r.name = name;
+    r.size = size;
+    r.threads = threads;
+    r.runs = (int)ms.size();
+    double sum = 0;
+    for (double v : ms) sum += v;
+    r.mean_ms = sum / ms.size();
+    double var = 0;
+    for (double v : ms) var += (v - r.mean_ms) * (v - r.mean_ms);
+    r.stddev_ms = ms.size() > 1 ? std::sqrt(var / (ms.size() - 1)) : 0.0;
+    std::sort(ms.begin(), ms.end());
+    r.min_ms = ms.front();
+    r.median_ms = ms.size() % 2 ? ms[ms.size() / 2] : 0.5 * (ms[ms.size() / 2 - 1] + ms[ms.size() / 2]);
+    return r;
+}
+
+std::string full_name(const std::string& name, Size size, int threads) {
+    return name + "/" + std::to_string(size.width) + "x" + std::to_string(size.height) + "/t" + std::to_string(threads);
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// One result object per line, so a baseline can be read back line by line.
+void write_json(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream f(path);
+    if (!f) throw std::runtime_error("Failed to write " + path);
+    f << std::setprecision(6) << "{\n  \"lumine_bench\": 1,\n  \"hardware_threads\": " << ThreadPool::resolve(0)
+      << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        f << "    {\"name\": \"" << json_escape(full_name(r.name, r.size, r.threads)) << "\", \"case\": \""
+          << json_escape(r.name) << "\", \"width\": " << r.size.width << ", \"height\": " << r.size.height
+          << ", \"threads\": " << r.threads << ", \"runs\": " << r.runs << ", \"median_ms\": " << r.median_ms
+          << ", \"mean_ms\": " << r.mean_ms << ", \"min_ms\": " << r.min_ms << ", \"stddev_ms\": " << r.stddev_ms
+          << ", \"variance_ms2\": " << r.stddev_ms * r.stddev_ms << ", \"mpix_per_s\": " << r.mpix_per_s()
+          << ", \"ns_per_pixel\": " << r.ns_per_pixel() << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+    if (!f) throw std::runtime_error("Failed to write " + path);
+}
+
+// name -> ns_per_pixel of a file written by write_json.
+std::map<std::string, double> read_baseline(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) throw std::runtime_error("Baseline not found: " + path);
+    std::map<std::string, double> base;
+    for (std::string line; std::getline(f, line);) {
+        const size_t n = line.find("\"name\": \"");
+        const size_t v = line.find("\"ns_per_pixel\": ");
+        if (n == std::string::npos || v == std::string::npos) continue;
+        std::string name;
+        for (size_t i = n + 9; i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) ++i;
+            name += line[i];
+        }
+        base[name] = std::stod(line.substr(v + 16));
+    }
+    if (base.empty()) throw std::runtime_error("No results in baseline: " + path);
+    return base;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, sep);)
+        if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+void print_usage() {
+    std::cout << "Usage: lumine_bench [--filter SUBSTR[,SUBSTR...]] [--sizes WxH[,WxH...]] [--threads N[,N...]]\n"
+                 "                    [--reps N] [--min-time SECONDS] [--json OUT.json]\n"
+                 "                    [--baseline BASE.json] [--tolerance FRACTION] [--list]\n"
+                 " Defaults: sizes 640x480,1920x1080; threads 1 and all hardware threads; 5 runs and\n"
+                 " at least 0.2 s per case; tolerance 0.10 (10% slower than the baseline).\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+                return argv[++i];
+            };
+            if (a == "--filter") o.filters = split(next(), ',');
+            else if (a == "--sizes") {
+                o.sizes.clear();
+                for (const std::string& s : split(next(), ',')) {
+                    const size_t x = s.find('x');
+                    if (x == std::string::npos) throw std::runtime_error("Bad size: " + s);
+                    o.sizes.push_back(Size{std::stoi(s.substr(0, x)), std::stoi(s.substr(x + 1))});
+                }
+            }
+            else if (a == "--threads") {
+                o.threads.clear();
+                // counts beyond the hardware resolve to the same row; run it once
+                for (const std::string& t : split(next(), ',')) {
+                    const int n = ThreadPool::resolve(std::stoi(t));
+                    if (std::find(o.threads.begin(), o.threads.end(), n) == o.threads.end()) o.threads.push_back(n);
+                }
+            }
+            else if (a == "--reps") o.reps = std::max(1, std::stoi(next()));
+            else if (a == "--min-time") o.min_time = std::max(0.0, std::stod(next()));
+            else if (a == "--json") o.json = next();
+            else if (a == "--baseline") o.baseline = next();
+            else if (a == "--tolerance") o.tolerance = std::max(0.0, std::stod(next()));
+            else if (a == "--list") o.list = true;
+            else if (a == "--help" || a == "-h") { print_usage(); return 0; }
+            else { std::cerr << "Unknown arg: " << a << "\n"; print_usage(); return 1; }
+        }
+        if (o.threads.empty()) {
+            o.threads.push_back(1);
+            if (ThreadPool::resolve(0) > 1) o.threads.push_back(ThreadPool::resolve(0));
+        }
+
+        std::vector<Case> cases;
+        for (Case& c : all_cases()) {
+            bool keep = o.filters.empty();
+            for (const std::string& f : o.filters) keep = keep || c.name.find(f) != std::string::npos;
+            if (keep) cases.push_back(std::move(c));
+        }
+        if (o.list) {
+            for (const Case& c : cases) std::cout << c.name << "\n";
+            return 0;
+        }
+        const std::map<std::string, double> base = o.baseline.empty() ? std::map<std::string, double>{}
+                                                                       : read_baseline(o.baseline);
+
+        std::cout << std::left << std::setw(44) << "case" << std::right << std::setw(11) << "size"
+                  << std::setw(4) << "t" << std::setw(10) << "Mpix/s" << std::setw(10) << "ns/px"
+                  << std::setw(11) << "median ms" << std::setw(8) << "cv %"
+                  << (base.empty() ? "" : "  vs baseline") << "\n";
+        std::vector<Result> results;
+        int regressions = 0;
+        for (Size size : o.sizes)
+            for (int threads : o.threads)
+                for (const Case& c : cases) {
+                    const Result r = measure(c.name, size, threads, c.prepare(size, threads), o);
+                    results.push_back(r);
+                    std::cout << std::left << std::setw(44) << r.name << std::right << std::setw(11)
+                              << (std::to_string(size.width) + "x" + std::to_string(size.height)) << std::setw(4)
+                              << threads << std::fixed << std::setprecision(1) << std::setw(10) << r.mpix_per_s()
+                              << std::setprecision(2) << std::setw(10) << r.ns_per_pixel() << std::setw(11)
+                              << r.median_ms << std::setprecision(1) << std::setw(8) << r.cv_percent();
+                    auto b = base.find(full_name(r.name, size, threads));
+                    if (b != base.end()) {
+                        const double change = r.ns_per_pixel() / b->second - 1.0;
+                        const bool slower = change > o.tolerance;
+                        regressions += slower;
+                        std::cout << "  " << std::showpos << std::setprecision(1) << 100.0 * change << std::noshowpos
+                                  << "%" << (slower ? "  REGRESSION" : "");
+                    } else if (!base.empty()) {
+                        std::cout << "  (new)";
+                    }
+                    std::cout << std::defaultfloat << std::setprecision(6) << "\n" << std::flush;
+                }
+
+        if (!o.json.empty()) {
+            write_json(o.json, results);
+            std::cout << "Wrote: " << o.json << "\n";
+        }
+        if (!base.empty()) {
+            std::cout << regressions << " of " << results.size() << " cases more than "
+                      << 100.0 * o.tolerance << "% slower than " << o.baseline << "\n";
+            return regressions ? 1 : 0;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
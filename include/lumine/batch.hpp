@@ -0,0 +1,63 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "image.hpp"
+
+namespace lumine {
+
+struct BatchJob {
+    std::string input, output;
+};
+
+struct BatchResult {
+    std::string input, output;
+    std::string error; // empty on success
+    double decode_seconds{0}, compute_seconds{0}, encode_seconds{0};
+
+    bool ok() const { return error.empty(); }
+};
+
+struct BatchOptions {
+    int decoders{0};    // decode threads; 0 = half the hardware threads
+    int workers{0};     // images processed at once; 0 = hardware threads
+    int encoders{0};    // encode threads; 0 = half the hardware threads
+    int queue_depth{0}; // images waiting between two stages; 0 = workers
+    bool force_grayscale{false};
+};
+
+// Processing step of a batch: one decoded image in, the image to encode out.
+template <typename T>
+using BatchProcess = std::function<BasicImage<T>(const BasicImage<T>&)>;
+// Called once per job as it finishes (success or failure), one call at a time.
+using BatchReport = std::function<void(const BatchResult&)>;
+
+// Jobs for `source`: every image file in a directory, the files matching a
+// wildcard pattern (`*`, `?` in the last path component), or a manifest
+// file with one `input` or `input<TAB>output` per line (blank lines and
+// lines starting with `#` are skipped). Outputs without an explicit path go
+// to out_dir under the input's name, with `extension` (".png", ...) or, if
+// empty, the input's own extension when it can be written. Throws if the
+// source does not exist or two jobs would write the same file.
+std::vector<BatchJob> list_batch_jobs(const std::string& source, const std::string& out_dir,
+                                      const std::string& extension = "");
+
+// Runs decode -> process -> encode as three overlapping stages on their own
+// threads, joined by bounded queues: a stage that runs ahead blocks until
+// the next one catches up, so at most decoders + workers + encoders +
+// 2*queue_depth images are in memory. A failing job (unreadable input,
+// exception in `process`, unwritable output) is reported and skipped; the
+// rest of the batch carries on. Results come back in job order.
+//
+// `process` runs on several workers at once; give each call few threads
+// (e.g. Pipeline::run(img, 1)) and let `workers` provide the parallelism.
+template <typename T>
+std::vector<BatchResult> run_batch(const std::vector<BatchJob>& jobs, const BatchProcess<T>& process,
+                                   const BatchOptions& options = {}, const BatchReport& report = {});
+
+extern template std::vector<BatchResult> run_batch<float>(const std::vector<BatchJob>&, const BatchProcess<float>&,
+                                                          const BatchOptions&, const BatchReport&);
+extern template std::vector<BatchResult> run_batch<uint8_t>(const std::vector<BatchJob>&, const BatchProcess<uint8_t>&,
+                                                            const BatchOptions&, const BatchReport&);
+
+}
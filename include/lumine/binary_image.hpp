@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "image.hpp"
+
+namespace lumine {
+
+// One bit per pixel, for thresholded images: 1/32 of the memory of a 0/1
+// float Image. Pixel x of row y is bit x % 64 of word x / 64 of row(y); rows
+// start on 64-byte boundaries and are stride() words apart. Bits past
+// width() in the last word of a row are always zero, so whole-word
+// operations (popcount, AND, OR) need no masking. Storage comes from
+// BufferPool::global(). Copies are deep.
+class BinaryImage {
+    public:
+        BinaryImage() = default;
+        BinaryImage(int width, int height, Fill fill = Fill::Zero);
+        BinaryImage(const BinaryImage& other);
+        BinaryImage& operator=(const BinaryImage& other);
+        BinaryImage(BinaryImage&&) noexcept = default;
+        BinaryImage& operator=(BinaryImage&&) noexcept = default;
+
+        // Set where channel 0 of `input` is above `threshold`.
+        static BinaryImage from_image(ConstImageView input, float threshold = 0.5f, int threads = 0);
+        // 1.0 for set pixels, 0.0 elsewhere.
+        Image to_image(int threads = 0) const;
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        // Words holding a row's pixels.
+        int words() const { return (m_width + 63) / 64; }
+        size_t stride() const { return m_stride; }
+        bool empty() const { return m_width <= 0 || m_height <= 0; }
+
+        uint64_t* row(int y) { return m_data + (size_t)y * m_stride; }
+        const uint64_t* row(int y) const { return m_data + (size_t)y * m_stride; }
+        bool get(int x, int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1u; }
+        void set(int x, int y, bool v) {
+            const uint64_t bit = uint64_t(1) << (x & 63);
+            uint64_t& w = row(y)[x >> 6];
+            w = v ? w | bit : w & ~bit;
+        }
+        // Clears the bits past width() in the last word of row y, after
+        // writing whole words.
+        void mask_tail(int y) {
+            if (m_width & 63) row(y)[words() - 1] &= ~uint64_t(0) >> (64 - (m_width & 63));
+        }
+
+        // Set pixels in the image.
+        size_t count() const;
+        // Projection profiles: set pixels in each row (height() values, a
+        // popcount per word) and in each column (width() values, summed 64
+        // columns at a time by bit-sliced counters).
+        std::vector<int> row_profile(int threads = 0) const;
+        std::vector<int> column_profile(int threads = 0) const;
+        // Flips every pixel.
+        void invert();
+
+    private:
+        void allocate(int width, int height);
+
+        int m_width{0}, m_height{0};
+        size_t m_stride{0};
+        std::shared_ptr<void> m_block;
+        uint64_t* m_data{nullptr};
+};
+
+// Binary morphology with a (2*rx+1) x (2*ry+1) rectangle on set pixels,
+// 64 pixels per word operation: each direction combines shifted copies of
+// the rows (or of whole rows) by doubling the span, so the cost grows with
+// log(radius), not the radius. The rectangle is clipped at the image
+// border (pixels outside take no part), so erosion does not eat in from the
+// edges. Output is bit-identical for any thread count.
+class Morphology {
+    public:
+        // Set where the whole rectangle is set.
+        static BinaryImage erode(const BinaryImage& input, int rx, int ry, int threads = 0);
+        // Set where any pixel of the rectangle is set.
+        static BinaryImage dilate(const BinaryImage& input, int rx, int ry, int threads = 0);
+        // dilate(erode()): removes set specks and strokes thinner than the rectangle.
+        static BinaryImage open(const BinaryImage& input, int rx, int ry, int threads = 0);
+        // erode(dilate()): fills clear holes and gaps narrower than the rectangle.
+        static BinaryImage close(const BinaryImage& input, int rx, int ry, int threads = 0);
+};
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lumine {
+
+// Cache of 64-byte aligned blocks behind image storage. Sizes are rounded
+// up to size classes (four per power of two), and a released block goes
+// back on its class's free list, so the intermediates of a batch reuse the
+// same few blocks instead of paying malloc, page faults and zero-fill per
+// image. Blocks come back uninitialized. Thread-safe.
+class BufferPool {
+    public:
+        static constexpr size_t kAlignment = 64;
+
+        // `capacity`: most bytes kept cached; blocks released beyond it are freed.
+        explicit BufferPool(size_t capacity = size_t(1) << 30);
+        ~BufferPool();
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        // Shared by all images; never destroyed, so images with static
+        // storage duration can still return their blocks at exit.
+        static BufferPool& global();
+
+        // Block of at least `bytes`; it returns to the pool when the last
+        // owner drops it, so the pool must outlive its blocks.
+        std::shared_ptr<void> acquire(size_t bytes);
+
+        void set_capacity(size_t bytes);
+        size_t capacity() const;
+        size_t cached_bytes() const;
+        // Frees every cached block.
+        void trim();
+
+    private:
+        static size_t size_class(size_t bytes);
+        void release(void* block, size_t size);
+        void evict_locked(size_t limit);
+
+        mutable std::mutex m_mutex;
+        std::map<size_t, std::vector<void*>> m_free; // size class -> cached blocks
+        size_t m_capacity;
+        size_t m_cached{0};
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "binary_image.hpp"
+#include "image.hpp"
+
+namespace lumine {
+
+enum class Connectivity {
+    Four,  // edge neighbours only
+    Eight, // edge and corner neighbours
+};
+
+// Bounding box, pixel count and centroid of one connected component.
+struct Component {
+    int x{0}, y{0}, width{0}, height{0};
+    int64_t area{0};
+    double cx{0.0}, cy{0.0}; // centroid; pixel (x, y) counts at (x, y)
+};
+
+// Horizontal run [x0, x1) of row y, belonging to component `label`.
+struct LabeledRun {
+    int y{0}, x0{0}, x1{0};
+    int label{0};
+};
+
+// Connected-component labelling on run lengths: each row is split into
+// runs of foreground pixels (found a word at a time), runs that touch a run
+// of the row above are joined in a union-find over provisional labels, and
+// the statistics of each label are accumulated as its runs are found and
+// merged along with the labels. Bands of rows are labelled in parallel and
+// stitched at their boundaries. Components are numbered in raster order of
+// their first pixel, so the result does not depend on the thread count.
+class ConnectedComponents {
+    public:
+        ConnectedComponents() = default;
+
+        // Labels the pixels whose bit equals `foreground`. Sauvola output
+        // marks ink as clear: pass foreground = false to label glyphs.
+        static ConnectedComponents label(const BinaryImage& image, Connectivity connectivity = Connectivity::Eight,
+                                         bool foreground = true, int threads = 0);
+        // The same on a 0/1 float image (e.g. sauvola_binarization's),
+        // foreground meaning above 0.5.
+        static ConnectedComponents label(ConstImageView image, Connectivity connectivity = Connectivity::Eight,
+                                         bool foreground = true, int threads = 0);
+
+        int size() const { return (int)m_components.size(); }
+        const std::vector<Component>& components() const { return m_components; }
+        // Every foreground run in raster order, with its component index:
+        // the label image in run-length form.
+        const std::vector<LabeledRun>& runs() const { return m_runs; }
+
+    private:
+        std::vector<Component> m_components;
+        std::vector<LabeledRun> m_runs;
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "convolver.hpp"
+#include "image.hpp"
+#include "kernel.hpp"
+#include "types.hpp"
+
+namespace lumine {
+
+namespace detail { struct ConvSetup; }
+
+// A convolution strategy built once for a (kernel, input shape, ConvParams)
+// triple, in the spirit of FFTW plans: the separable factors, FFT kernel
+// spectrum, algorithm, band height and FFT block size are resolved at
+// construction, so execute() only touches pixels. A plan is immutable and
+// may be executed from several threads at once.
+//
+// Measured choices are kept as process-wide "wisdom" keyed by kernel,
+// shape and params; save_wisdom()/load_wisdom() carry it across processes
+// so workers start already tuned. Wisdom is specific to the machine (and
+// thread count) it was measured on.
+class ConvPlan {
+    public:
+        enum class Tuning {
+            Estimate, // wisdom if present, else the cost model; cheap
+            Measure,  // wisdom if present, else time every plausible strategy on a
+                      // synthetic input of this shape and remember the fastest
+        };
+
+        ConvPlan(const Kernel& kernel, int width, int height, int channels,
+                 const ConvParams& params, Tuning tuning = Tuning::Estimate);
+
+        // `input` must have the planned width, height and channel count; a
+        // ROI view reads its real neighbours at the border (see ImageView).
+        Image execute(ConstImageView input) const;
+        // Writes into `output`, which must have output_size() and the planned
+        // channel count and must not overlap the input.
+        void execute(ConstImageView input, ImageView output) const;
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        int channels() const { return m_channels; }
+        Size output_size() const;
+        const ConvParams& params() const { return m_params; }
+
+        ConvAlgo algorithm() const; // never Auto
+        int band_rows() const;      // output rows per work item (Direct, Separable)
+        int fft_size() const;       // FFT block edge, 0 unless algorithm() == FFT
+
+        // Text file, one line per measured plan. load_wisdom() merges into
+        // what is already known and returns false when the file does not
+        // exist; malformed files throw.
+        static void save_wisdom(const std::string& path);
+        static bool load_wisdom(const std::string& path);
+        static void forget_wisdom();
+
+    private:
+        friend class Pipeline;
+
+        std::shared_ptr<const detail::ConvSetup> m_setup;
+        ConvParams m_params;
+        int m_width{0}, m_height{0}, m_channels{0};
+};
+
+}
@@ -5,19 +5,52 @@
 
 namespace lumine {
 
+enum class ConvAlgo {
+    Auto,      // cheapest that applies, by a cost model
+    Direct,    // full 2D sum per output pixel
+    Separable, // sum of k separable 1D pass pairs (truncated SVD within rank_tolerance)
+    FFT,       // overlap-save FFT tiles; matches Direct to ~1e-6 relative (see convolver.cpp)
+    // gauss:<sigma> and box:<radius> only (Kernel::blur()), at a cost per
+    // pixel independent of their size: running sums for the box (exact to
+    // float rounding) and Deriche's recursive Gaussian, within ~1e-4 of the
+    // FIR on [0, 1] data (see convolver.cpp). Other kernels run Direct.
+    Recursive,
+};
+
 struct ConvParams {
     int stride{1};
     Padding padding{Padding::ZERO};
     VizMode viz{VizMode::Clamp};
+    int threads{0}; // 0 = all hardware threads, 1 = run on the calling thread
+    ConvAlgo algo{ConvAlgo::Auto};
+    // Error budget of the Separable path, relative to the kernel's Frobenius
+    // norm. The default only admits kernels that are numerically low rank;
+    // larger values trade accuracy for fewer passes.
+    float rank_tolerance{1e-6f};
 };
 
 class Convolver {
     public:
-        static Image convolve(const Image& input, const Kernel& kernel, const ConvParams& params);
-    private:
-        static float sample(const Image& img, int x, int y, int c, Padding pad);
+        // One-shot: builds a ConvPlan (Estimate, so stored wisdom applies)
+        // and executes it. Reuse a ConvPlan when applying one kernel to many
+        // images of the same shape.
+        // Views may be regions of interest: borders read the real pixels
+        // around the ROI where the underlying image has them, and the
+        // `output` overloads write into caller storage of the output size.
+        static Image convolve(ConstImageView input, const Kernel& kernel, const ConvParams& params);
+        static void convolve(ConstImageView input, ImageView output, const Kernel& kernel, const ConvParams& params);
+
+        // 8-bit in, 8-bit out in fixed point (int32 sums, see convolver.cpp):
+        // the float result with Clamp, rounded, within one level for kernels
+        // whose weights are not exact in fixed point. VizMode::None also saturates;
+        // Normalize, Recursive blurs (and kernels too large for int32 sums) go
+        // through float.
+        // Use a float Image to keep signed responses such as Sobel.
+        static Image8 convolve(ConstImageView8 input, const Kernel& kernel, const ConvParams& params);
+        static void convolve(ConstImageView8 input, ImageView8 output, const Kernel& kernel, const ConvParams& params);
 
-        static Image convolve_horizontal(const Image& input, const std::vector<float>& kx, Padding pad, int stride_x);
-        static Image convolve_vertical(const Image& input, const std::vector<float>& ky, Padding pad, int stride_y);
+        // Algorithm params.algo resolves to for this kernel on a width x height
+        // input (never Auto); same rule as ConvPlan.
+        static ConvAlgo choose_algorithm(const Kernel& kernel, int width, int height, const ConvParams& params);
 };
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "convolver.hpp"
+#include "image.hpp"
+#include "kernel.hpp"
+#include "types.hpp"
+
+namespace lumine {
+
+namespace detail { struct BankSetup; }
+
+// How a FilterBank combines the responses r_0..r_{n-1} of its kernels at
+// each pixel.
+enum class BankReduce {
+    None,        // one output per kernel
+    Magnitude,   // sqrt(sum r_k^2), e.g. gradient magnitude from sobel_x and sobel_y
+    Orientation, // atan2(r_1, r_0) in radians, [-pi, pi], to ~5e-7; two kernels only
+    Max,         // max_k r_k, e.g. the strongest of a set of compass kernels
+};
+
+// Several kernels of one size applied in a single pass: every input sample
+// of a neighbourhood is loaded once and feeds all kernels, and the
+// reduction happens on the responses while they are still in registers. A
+// Sobel magnitude reads the image once and writes one image, where two
+// convolutions and a combine step would read it twice and write three.
+//
+// Response k matches Convolver::convolve with kernel k (same padding and
+// stride) to float rounding; params.viz applies to each output.
+class FilterBank {
+    public:
+        FilterBank() = default;
+        // Throws unless the kernels all have the same size (and there are
+        // exactly two for Orientation).
+        explicit FilterBank(std::vector<Kernel> kernels, BankReduce reduce = BankReduce::None);
+
+        // sobel_mag, sobel_dir, scharr_mag, prewitt_mag, kirsch_max
+        static FilterBank from_builtin(const std::string& name);
+        static bool is_builtin(const std::string& name);
+
+        const std::vector<Kernel>& kernels() const { return m_kernels; }
+        BankReduce reduce() const { return m_reduce; }
+        int size() const { return (int)m_kernels.size(); }
+        // Kernel footprint.
+        int width() const { return m_kernels.empty() ? 0 : m_kernels[0].width(); }
+        int height() const { return m_kernels.empty() ? 0 : m_kernels[0].height(); }
+        // Output size for a width x height input (as Convolver's).
+        Size output_size(int width, int height, int stride) const;
+
+        // One image per kernel, whatever reduce() is. params.algo and
+        // rank_tolerance do not apply. ROI views read their real neighbours
+        // at the border, as with Convolver.
+        std::vector<Image> apply_each(ConstImageView input, const ConvParams& params) const;
+        // The reduced response; throws for BankReduce::None.
+        Image apply(ConstImageView input, const ConvParams& params) const;
+        void apply(ConstImageView input, ImageView output, const ConvParams& params) const;
+
+    private:
+        friend class Pipeline;
+
+        std::vector<Kernel> m_kernels;
+        BankReduce m_reduce{BankReduce::None};
+        std::shared_ptr<const detail::BankSetup> m_setup;
+};
+
+}
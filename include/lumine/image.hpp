@@ -1,32 +1,228 @@
 #pragma once
-#include <vector>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <cstdint>
+#include <algorithm>
+#include <type_traits>
 #include "types.hpp"
 
 namespace lumine {
 
-class Image {
+// How a stored sample maps to the [0, 1] intensity range the float
+// pipeline works in: value = sample / scale.
+template <typename T> struct PixelTraits;
+template <> struct PixelTraits<float> { static constexpr float scale = 1.0f; static constexpr bool integer = false; };
+template <> struct PixelTraits<half> { static constexpr float scale = 1.0f; static constexpr bool integer = false; };
+template <> struct PixelTraits<uint8_t> { static constexpr float scale = 255.0f; static constexpr bool integer = true; };
+template <> struct PixelTraits<uint16_t> { static constexpr float scale = 65535.0f; static constexpr bool integer = true; };
+
+// Sample of type U holding the same intensity as `v` (integers round and
+// saturate).
+template <typename U, typename T>
+inline U convert_pixel(T v) {
+    if constexpr (std::is_same_v<T, U>) {
+        return v;
+    } else {
+        float f = (float)v;
+        if constexpr (PixelTraits<T>::scale != 1.0f) f /= PixelTraits<T>::scale;
+        if constexpr (PixelTraits<U>::scale != 1.0f) f *= PixelTraits<U>::scale;
+        if constexpr (PixelTraits<U>::integer)
+            return (U)(std::clamp(f, 0.0f, PixelTraits<U>::scale) + 0.5f);
+        else
+            return (U)f;
+    }
+}
+
+template <typename T> class BasicImage;
+
+// Pixels of the underlying image beyond each edge of a view.
+struct ViewContext { int left{0}, top{0}, right{0}, bottom{0}; };
+
+// Non-owning window onto planar samples: width x height pixels in
+// `channels` planes, rows stride() samples apart and planes plane_stride()
+// apart, so a region of interest or a subset of channels is addressed in
+// place. T is const for read-only views.
+//
+// A view cut from a larger image remembers how far that image extends past
+// each of its edges (context()); neighbourhood operations read those real
+// pixels at the view border and apply padding only where the underlying
+// image ends. The view must not outlive the storage it points into.
+template <typename T>
+class BasicImageView {
+    public:
+        using value_type = std::remove_const_t<T>;
+        using Context = ViewContext;
+
+        BasicImageView() = default;
+        BasicImageView(T* data, int width, int height, size_t stride, int channels = 1,
+                       size_t plane_stride = 0, Context context = {})
+            : m_data(data), m_width(width), m_height(height), m_channels(channels),
+              m_stride(stride), m_plane(plane_stride ? plane_stride : stride * height), m_context(context) {}
+        BasicImageView(BasicImage<value_type>& img);
+        template <typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+        BasicImageView(const BasicImage<value_type>& img);
+        template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+        BasicImageView(const BasicImageView<U>& v)
+            : BasicImageView(v.data(), v.width(), v.height(), v.stride(), v.channels(), v.plane_stride(), v.context()) {}
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        int channels() const { return m_channels; }
+        size_t stride() const { return m_stride; }
+        size_t plane_stride() const { return m_plane; }
+        const Context& context() const { return m_context; }
+        bool empty() const { return m_width <= 0 || m_height <= 0 || m_channels <= 0; }
+
+        T* data() const { return m_data; }
+        T* row(int y, int c = 0) const { return m_data + c*m_plane + (ptrdiff_t)y*(ptrdiff_t)m_stride; }
+        T& at(int x, int y, int c = 0) const { return row(y, c)[x]; }
+
+        // Region [x, x+w) x [y, y+h) of this view; throws if it does not fit.
+        BasicImageView sub(int x, int y, int w, int h) const {
+            if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > m_width || y + h > m_height)
+                throw std::runtime_error("ImageView::sub: region outside the view");
+            return BasicImageView(m_data + (ptrdiff_t)y*(ptrdiff_t)m_stride + x, w, h, m_stride, m_channels, m_plane,
+                                  Context{m_context.left + x, m_context.top + y,
+                                          m_context.right + m_width - x - w, m_context.bottom + m_height - y - h});
+        }
+        // Channels [first, first + count).
+        BasicImageView channels(int first, int count) const {
+            if (first < 0 || count < 0 || first + count > m_channels)
+                throw std::runtime_error("ImageView::channels: channel range outside the view");
+            return BasicImageView(m_data + first*m_plane, m_width, m_height, m_stride, count, m_plane, m_context);
+        }
+        BasicImageView channel(int c) const { return channels(c, 1); }
+        // Grows the view into its context by the given pixels per edge;
+        // throws if the underlying image is not that large.
+        BasicImageView expand(int left, int top, int right, int bottom) const {
+            if (left < 0 || top < 0 || right < 0 || bottom < 0 || left > m_context.left || top > m_context.top ||
+                right > m_context.right || bottom > m_context.bottom)
+                throw std::runtime_error("ImageView::expand: beyond the underlying image");
+            return BasicImageView(m_data - (ptrdiff_t)top*(ptrdiff_t)m_stride - left, m_width + left + right,
+                                  m_height + top + bottom, m_stride, m_channels, m_plane,
+                                  Context{m_context.left - left, m_context.top - top,
+                                          m_context.right - right, m_context.bottom - bottom});
+        }
+
+        template <typename U>
+        BasicImage<U> convert() const;
+
+    private:
+        T* m_data{nullptr};
+        int m_width{0}, m_height{0}, m_channels{0};
+        size_t m_stride{0}, m_plane{0};
+        Context m_context;
+};
+
+// Whether a new image's pixels are zeroed. Fill::None skips the memset for
+// outputs that are overwritten anyway.
+enum class Fill { Zero, None };
+
+// Planar image of samples of type T. The float pipeline uses Image; the
+// narrower types keep large batches in their native depth (Image8 is a
+// quarter of the memory) and convert only where an operation needs float.
+//
+// Rows start on 64-byte boundaries and are stride() samples apart; planes
+// are plane_stride() samples apart. An optional halo of `halo` pixels on
+// every side is allocated around each plane (fill_halo() writes it), so
+// kernels up to 2*halo+1 wide can read past the edges without branches.
+// Storage comes from BufferPool::global(). Copies are deep.
+template <typename T>
+class BasicImage {
     public:
-        Image() = default;
-        Image(int w, int h, int c = 1);
+        using value_type = T;
 
-        static Image load(const std::string& path, bool force_grayscale = false);
+        BasicImage() = default;
+        BasicImage(int w, int h, int c = 1, Fill fill = Fill::Zero, int halo = 0);
+        BasicImage(const BasicImage& other);
+        BasicImage& operator=(const BasicImage& other);
+        BasicImage(BasicImage&&) noexcept = default;
+        BasicImage& operator=(BasicImage&&) noexcept = default;
+        // Deep copy of the pixels a view addresses.
+        explicit BasicImage(BasicImageView<const T> view);
+
+        // 8-bit files load natively into Image8; Image16 keeps the full depth
+        // of 16-bit PNGs. Other types convert on load.
+        static BasicImage load(const std::string& path, bool force_grayscale = false);
+        // Written as 8-bit png/jpg/bmp/pgm/ppm; float values are clamped to [0, 1].
         void save(const std::string& path) const;
 
+        template <typename U>
+        BasicImage<U> convert() const { return view().template convert<U>(); }
+
         int width() const { return m_width; }
         int height() const { return m_height; }
         int channels() const { return m_channels; }
+        int halo() const { return m_halo; }
+        size_t stride() const { return m_stride; }
+        size_t plane_stride() const { return m_plane; }
+        // Rows packed back to back (stride == width, no halo): data() then
+        // addresses width*height*channels consecutive samples.
+        bool contiguous() const { return m_stride == (size_t)m_width && m_halo == 0; }
+
+        // Sample (0, 0) of channel 0.
+        T* data() { return m_origin; }
+        const T* data() const { return m_origin; }
+        T* row(int y, int c = 0) { return m_origin + c*m_plane + (ptrdiff_t)y*(ptrdiff_t)m_stride; }
+        const T* row(int y, int c = 0) const { return m_origin + c*m_plane + (ptrdiff_t)y*(ptrdiff_t)m_stride; }
 
-        float* data() { return m_data.data(); }
-        const float* data() const { return m_data.data(); }
+        T& at(int x, int y, int c = 0) { return row(y, c)[x]; }
+        const T& at(int x, int y, int c = 0) const { return row(y, c)[x]; }
 
-        float& at(int x, int y, int c = 0) { return m_data[(size_t)c*m_width*m_height + (size_t)y*m_width + x]; }
-        const float& at(int x, int y, int c = 0) const { return m_data[(size_t)c*m_width*m_height + (size_t)y*m_width + x]; }
+        // Writes the halo: zeros, or the nearest edge pixel.
+        void fill_halo(Padding padding);
+
+        // The whole image, or the region [x, x+w) x [y, y+h) of it.
+        BasicImageView<T> view() { return BasicImageView<T>(*this); }
+        BasicImageView<const T> view() const { return BasicImageView<const T>(*this); }
+        BasicImageView<T> view(int x, int y, int w, int h) { return view().sub(x, y, w, h); }
+        BasicImageView<const T> view(int x, int y, int w, int h) const { return view().sub(x, y, w, h); }
 
     private:
-        int m_width{0}, m_height{0}, m_channels{1};
-        std::vector<float> m_data;
+        void allocate(int w, int h, int c, int halo);
+
+        int m_width{0}, m_height{0}, m_channels{1}, m_halo{0};
+        size_t m_stride{0}, m_plane{0};
+        std::shared_ptr<void> m_block;
+        T* m_origin{nullptr};
 };
 
-}
\ No newline at end of file
+template <typename T>
+BasicImageView<T>::BasicImageView(BasicImage<value_type>& img)
+    : BasicImageView(img.data(), img.width(), img.height(), img.stride(), img.channels(), img.plane_stride()) {}
+
+template <typename T>
+template <typename U, typename>
+BasicImageView<T>::BasicImageView(const BasicImage<value_type>& img)
+    : BasicImageView(img.data(), img.width(), img.height(), img.stride(), img.channels(), img.plane_stride()) {}
+
+template <typename T>
+template <typename U>
+BasicImage<U> BasicImageView<T>::convert() const {
+    BasicImage<U> out(m_width, m_height, m_channels, Fill::None);
+    for (int c = 0; c < m_channels; ++c)
+        for (int y = 0; y < m_height; ++y) {
+            const T* src = row(y, c);
+            U* dst = out.row(y, c);
+            for (int x = 0; x < m_width; ++x) dst[x] = convert_pixel<U>(src[x]);
+        }
+    return out;
+}
+
+using Image = BasicImage<float>;
+using Image8 = BasicImage<uint8_t>;
+using Image16 = BasicImage<uint16_t>;
+using ImageF16 = BasicImage<half>;
+using ImageView = BasicImageView<float>;
+using ConstImageView = BasicImageView<const float>;
+using ImageView8 = BasicImageView<uint8_t>;
+using ConstImageView8 = BasicImageView<const uint8_t>;
+
+extern template class BasicImage<float>;
+extern template class BasicImage<uint8_t>;
+extern template class BasicImage<uint16_t>;
+extern template class BasicImage<half>;
+
+}
@@ -3,6 +3,23 @@
 #include <string>
 
 namespace lumine {
+
+// One separable term of a kernel: weights(y, x) += ky[y] * kx[x].
+struct SeparableTerm {
+    std::vector<float> ky, kx;
+};
+
+// Closed form of the gauss:<sigma> and box:<radius> builtins. The weights
+// hold the exact FIR; with the closed form ConvAlgo::Recursive can run the
+// blur at a cost per pixel that does not depend on its size (see
+// convolver.cpp for the accuracy of the Gaussian).
+struct BlurShape {
+    enum class Kind { None, Box, Gaussian };
+    Kind kind{Kind::None};
+    int radius{0};     // the kernel is (2*radius+1) square
+    float sigma{0.0f}; // Gaussian standard deviation
+};
+
 class Kernel {
     public:
         Kernel() = default;
@@ -10,15 +27,30 @@ class Kernel {
 
         static Kernel from_builtin(const std::string& name); // filter name
         static Kernel from_string(const std::string& spec); // custom filter
+        // Named kernel, gauss:<sigma> or box:<radius> (case-insensitive).
+        static bool is_builtin(const std::string& name);
+
+        // Limits of the parametric builtins.
+        static constexpr float kMinSigma = 0.5f, kMaxSigma = 100.0f;
+        static constexpr int kMaxBoxRadius = 500;
 
         int width() const { return m_w; }
         int height() const { return m_h; }
         const std::vector<float>& weights() const { return m_wts; }
+        // Kind::None except for gauss:<sigma> and box:<radius>.
+        const BlurShape& blur() const { return m_blur; }
 
         bool try_separable(std::vector<float>& ky, std::vector<float>& kx, float eps = 1e-6f) const;
 
+        // Truncated SVD: the fewest separable terms whose sum is within
+        // `tolerance` * ||K||_F of K (Frobenius norm). Exact rank-1 kernels
+        // return the try_separable factors. `error`, if given, receives the
+        // achieved relative error.
+        std::vector<SeparableTerm> low_rank(float tolerance = 1e-6f, float* error = nullptr) const;
+
     private:
         int m_w{0}, m_h{0};
         std::vector<float> m_wts; // row-major order h x w
+        BlurShape m_blur;
 };
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "convolver.hpp"
+#include "filter_bank.hpp"
+#include "image.hpp"
+#include "kernel.hpp"
+#include "types.hpp"
+
+namespace lumine {
+
+class ImageReader;
+class ImageWriter;
+
+// A chain of operations declared once and executed fused over horizontal
+// strips: each stage produces a few dozen rows and hands them straight to the
+// next one, so intermediates stay in cache and only the final output is
+// materialized. Strips recompute the few halo rows their neighbours also
+// need, which keeps them independent and lets them run in parallel. Output
+// is identical to calling the stages one after another.
+//
+// Convolution plans are built on the first run for each input shape and
+// reused by later runs; run() may be called from several threads at once.
+class Pipeline {
+    public:
+        struct Shape { int width{0}, height{0}, channels{0}; };
+
+        Pipeline& grayscale();
+        Pipeline& denoise(int radius = 1, Padding padding = Padding::EDGE);
+        Pipeline& binarize(float k = 0.2f, int window_size = 15);
+        // params.threads is ignored; run() decides the thread count.
+        Pipeline& convolve(const Kernel& kernel, const ConvParams& params);
+        // A bank with a reduction (one output per channel); params as for
+        // convolve(). With unit_angles, an Orientation bank's radians in
+        // [-pi, pi] are mapped onto [0, 1] for saving instead of going
+        // through params.viz (Clamp would cut every negative angle to 0).
+        Pipeline& filter_bank(const FilterBank& bank, const ConvParams& params, bool unit_angles = false);
+        // v * gain + offset per pixel.
+        Pipeline& levels(float gain, float offset);
+
+        // Opt-in debug tap on the output of the most recently added stage (the
+        // input if there is none yet). The tapped rows are assembled into a
+        // full image that is handed to `fn` when the run finishes, so only
+        // tapped stages cost a full-size buffer.
+        Pipeline& tap(std::function<void(const Image&)> fn);
+        // Tap that writes the stage output with Image::save.
+        Pipeline& tap(const std::string& path);
+
+        // Output rows per strip; 0 (default) sizes strips so that one strip's
+        // intermediates take about 1 MiB.
+        Pipeline& strip_rows(int rows);
+
+        size_t size() const { return m_stages.size(); }
+        bool empty() const { return m_stages.empty(); }
+        // Shape of the output for an input of the given shape.
+        Shape output_shape(Shape input) const;
+
+        // A ROI view reads the pixels around it in its parent image where the
+        // stages reach past its edges, so the result is the ROI's part of the
+        // whole image's; padding applies only at the parent's borders.
+        // Normalize scales by the ROI's own outputs, as Convolver does.
+        Image run(ConstImageView input, int threads = 0) const;
+        // The same into `output`, which must have output_shape() of the input.
+        void run(ConstImageView input, ImageView output, int threads = 0) const;
+
+        // Streams an image too large to hold in memory: input rows are read
+        // as the strips need them and output strips are written as they
+        // finish, so memory is a few strips per thread (plus the whole image
+        // for formats the reader or writer cannot stream). `output` must have
+        // output_shape() of the input; it is finished on return. Output is
+        // identical to run(), except that a gauss: blur Auto would run as
+        // the recursive Gaussian (which reads every row) runs as the
+        // separable FIR. Throws for Normalize, taps and an explicit
+        // recursive Gaussian, which need the whole image.
+        void run(ImageReader& input, ImageWriter& output, int threads = 0) const;
+
+    private:
+        struct Stage;
+        struct Segment;
+        using Tap = std::pair<size_t, std::function<void(const Image&)>>; // (level, fn)
+
+        Shape output_shape_of(Shape input, size_t first, size_t last) const;
+        Segment plan_segment(const Shape& input, size_t first, size_t last, bool streaming) const;
+        void run_segment(ConstImageView input, ImageView output, size_t first, size_t last, int threads) const;
+
+        std::vector<std::shared_ptr<const Stage>> m_stages;
+        std::vector<Tap> m_taps; // level 0 = input, level i = output of stage i-1
+        int m_strip_rows{0};
+};
+
+}
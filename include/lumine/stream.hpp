@@ -0,0 +1,73 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "image.hpp"
+
+namespace lumine {
+
+// Source of image rows, top to bottom, for processing images that do not fit
+// in memory (Pipeline::run(ImageReader&, ImageWriter&)). Samples are the
+// floats Image::load would produce for the same file.
+class ImageReader {
+    public:
+        virtual ~ImageReader() = default;
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        int channels() const { return m_channels; }
+        // Rows already read.
+        int position() const { return m_next; }
+
+        // Fills `rows` with the next rows.height() rows; throws past the end
+        // or if the file is truncated.
+        void read(ImageView rows);
+
+        // 8-bit binary PGM/PPM and uncompressed 24-bit BMP are read a row at
+        // a time. Anything else stb_image can decode (PNG, JPEG, ...) is
+        // decoded whole on open and held as 8-bit samples, a quarter of the
+        // float image.
+        static std::unique_ptr<ImageReader> open(const std::string& path, bool force_grayscale = false);
+
+    protected:
+        ImageReader(int width, int height, int channels) : m_width(width), m_height(height), m_channels(channels) {}
+        // Decodes the next `count` rows as interleaved 8-bit gray or RGB.
+        virtual void read_rows(uint8_t* rows, int count) = 0;
+
+    private:
+        int m_width, m_height, m_channels;
+        int m_next{0};
+};
+
+// Sink for image rows, top to bottom, written as Image::save would write the
+// whole image.
+class ImageWriter {
+    public:
+        virtual ~ImageWriter() = default;
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        int channels() const { return m_channels; }
+
+        // Appends the rows of `rows` (width() wide, channels() planes).
+        void write(ConstImageView rows);
+        // Completes the file; throws unless all height() rows were written.
+        void finish();
+
+        // PGM/PPM and BMP are written row by row. PNG and JPEG are collected
+        // as 8-bit samples and encoded by finish().
+        static std::unique_ptr<ImageWriter> open(const std::string& path, int width, int height, int channels);
+
+    protected:
+        ImageWriter(int width, int height, int channels) : m_width(width), m_height(height), m_channels(channels) {}
+        // Encodes the next `count` rows, given as interleaved 8-bit gray or
+        // RGB (channels() == 1 or not).
+        virtual void write_rows(const uint8_t* rows, int count) = 0;
+        virtual void close() = 0;
+
+    private:
+        int m_width, m_height, m_channels;
+        int m_next{0};
+        bool m_finished{false};
+};
+
+}
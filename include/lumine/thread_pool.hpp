@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lumine {
+
+// Reusable worker pool shared by the convolution and preprocessing engines.
+// parallel_for hands out chunks from an atomic cursor, so a worker that
+// finishes early keeps pulling ranges that would otherwise wait on a slower
+// one. The calling thread always takes part in its own loop.
+class ThreadPool {
+    public:
+        explicit ThreadPool(int threads = 0); // 0 = hardware concurrency
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Number of threads that can work on a loop (workers + caller).
+        int size() const { return (int)m_workers.size() + 1; }
+
+        // Process-wide pool sized to the hardware, created on first use.
+        static ThreadPool& global();
+        // Maps a user thread count (0 = all) onto [1, hardware threads]; larger
+        // requests are clamped, since the pool never has more threads anyway.
+        static int resolve(int threads);
+
+        // Fire-and-forget task; exceptions escaping the task are swallowed.
+        void submit(std::function<void()> task);
+
+        // Calls fn(begin, end) over [first, last) in chunks of `grain` items,
+        // on at most `max_threads` threads (0 = whole pool). Blocks until every
+        // chunk is done and rethrows the first exception raised by fn.
+        // Nested calls from inside a worker run inline.
+        void parallel_for(int first, int last, int grain,
+                          const std::function<void(int, int)>& fn, int max_threads = 0);
+
+    private:
+        void worker_loop();
+
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop{false};
+};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Low-overhead instrumentation: scoped timers, counters and notes recorded
+// into per-thread buffers while a session is active (trace::start()), and
+// exported as a Chrome trace (chrome://tracing, ui.perfetto.dev) or a
+// summary table.
+//
+// The LUMINE_TRACE_* macros are what the library uses. Built with
+// LUMINE_TRACE=0 (CMake option LUMINE_ENABLE_TRACE=OFF) they expand to
+// nothing; built in but with no session active, each costs one relaxed
+// atomic load.
+#ifndef LUMINE_TRACE
+#define LUMINE_TRACE 1
+#endif
+
+namespace lumine::trace {
+
+// Whether the instrumentation points were compiled in.
+constexpr bool compiled_in() { return LUMINE_TRACE != 0; }
+
+// Starts a recording session, dropping whatever an earlier one recorded.
+void start();
+// Stops recording; the events stay available to the writers below.
+void stop();
+namespace detail { extern std::atomic<bool> g_active; }
+inline bool active() { return detail::g_active.load(std::memory_order_relaxed); }
+
+// Chrome trace-event JSON: one "X" event per scope (tid = small per-thread
+// id, args.tile = chunk index for work split by ThreadPool::parallel_for),
+// "C" events for counters and "i" events for notes.
+void write_chrome_trace(const std::string& path);
+// Per scope name: calls, total/mean/max time and the threads involved;
+// then counter totals and notes. Nested scopes are each counted in full.
+std::string summary();
+
+// Adds `value` to a named counter (pixels, bytes allocated, ...).
+void count(const char* name, double value);
+// Records a decision, e.g. note("conv.algo", "separable").
+void note(const char* key, const std::string& value);
+
+// Index of a work item within a parallel operation.
+struct Tile { int id; };
+
+// Times its own lifetime. `name` (and arg keys) must be string literals.
+// Up to two numeric args are recorded with the event.
+class Scope {
+    public:
+        explicit Scope(const char* name, const char* key1 = nullptr, double value1 = 0,
+                       const char* key2 = nullptr, double value2 = 0)
+            : Scope(name, Tile{-1}, key1, value1, key2, value2) {}
+        Scope(const char* name, Tile tile, const char* key1 = nullptr, double value1 = 0,
+              const char* key2 = nullptr, double value2 = 0);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Name of the innermost active scope on this thread (nullptr if none).
+        static const char* current();
+
+    private:
+        const char* m_name;
+        const char* m_key[2];
+        double m_value[2];
+        int m_tile;
+        int64_t m_start{-1}; // -1: not recording
+        const char* m_outer{nullptr};
+};
+
+}
+
+#define LUMINE_TRACE_JOIN2(a, b) a##b
+#define LUMINE_TRACE_JOIN(a, b) LUMINE_TRACE_JOIN2(a, b)
+#if LUMINE_TRACE
+#define LUMINE_TRACE_SCOPE(...) ::lumine::trace::Scope LUMINE_TRACE_JOIN(lumine_trace_scope_, __LINE__)(__VA_ARGS__)
+#define LUMINE_TRACE_COUNT(name, value) do { if (::lumine::trace::active()) ::lumine::trace::count(name, value); } while (0)
+#define LUMINE_TRACE_NOTE(key, value) do { if (::lumine::trace::active()) ::lumine::trace::note(key, value); } while (0)
+#else
+#define LUMINE_TRACE_SCOPE(...) ((void)0)
+#define LUMINE_TRACE_COUNT(name, value) ((void)0)
+#define LUMINE_TRACE_NOTE(key, value) ((void)0)
+#endif
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 
 namespace lumine {
@@ -12,8 +14,55 @@ namespace lumine {
         Normalize,
         None
     };
+    // pi in the precision of T: kPi<float>, kPi<double>.
+    template <typename T> constexpr T kPi = T(3.14159265358979323846L);
     struct Size { int width{0}; int height{0}; };
     // 8 bit RGB pixel
     struct RGB8 {size_t r, g, b;};
 
+    // IEEE 754 binary16 storage type. Arithmetic happens in float; the
+    // conversions round to nearest even and keep inf/NaN.
+    struct half {
+        uint16_t bits{0};
+
+        half() = default;
+        half(float f) : bits(from_float(f)) {}
+        operator float() const { return to_float(bits); }
+
+        static uint16_t from_float(float f) {
+            uint32_t x; std::memcpy(&x, &f, 4);
+            const uint32_t sign = (x >> 16) & 0x8000u;
+            x &= 0x7fffffffu;
+            if (x >= 0x7f800000u) return (uint16_t)(sign | 0x7c00u | (x > 0x7f800000u ? 0x200u : 0u));
+            if (x >= 0x477ff000u) return (uint16_t)(sign | 0x7c00u); // rounds past 65504
+            if (x < 0x38800000u) { // subnormal or zero
+                if (x < 0x33000000u) return (uint16_t)sign;
+                const uint32_t m = (x & 0x7fffffu) | 0x800000u;
+                const int shift = 126 - (int)(x >> 23);
+                uint32_t h = m >> shift;
+                const uint32_t rest = m & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+                if (rest > halfway || (rest == halfway && (h & 1u))) ++h;
+                return (uint16_t)(sign | h);
+            }
+            uint32_t h = ((x - 0x38000000u) >> 13);
+            const uint32_t rest = x & 0x1fffu;
+            if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) ++h;
+            return (uint16_t)(sign | h);
+        }
+        static float to_float(uint16_t h) {
+            const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+            uint32_t e = (h >> 10) & 0x1fu, m = h & 0x3ffu, x;
+            if (e == 0x1fu) x = sign | 0x7f800000u | (m << 13);
+            else if (e != 0) x = sign | ((e + 112u) << 23) | (m << 13);
+            else if (m == 0) x = sign;
+            else { // subnormal: normalize
+                e = 113;
+                while (!(m & 0x400u)) { m <<= 1; --e; }
+                x = sign | (e << 23) | ((m & 0x3ffu) << 13);
+            }
+            float f; std::memcpy(&f, &x, 4);
+            return f;
+        }
+    };
+
 }
\ No newline at end of file
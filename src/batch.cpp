@@ -0,0 +1,178 @@
+#include "lumine/batch.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "bounded_queue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace lumine {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return s;
+}
+
+// Formats stb_image reads / Image::save writes.
+bool readable(const fs::path& p) {
+    static const std::set<std::string> exts{".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif",
+                                            ".psd", ".hdr", ".pic", ".pgm", ".ppm", ".pnm"};
+    return exts.count(lower(p.extension().string())) > 0;
+}
+
+bool writable(const std::string& ext) {
+    const std::string e = lower(ext);
+    return e == ".png" || e == ".jpg" || e == ".jpeg" || e == ".bmp" || e == ".pgm" || e == ".ppm" || e == ".pnm";
+}
+
+// `*` and `?` wildcards, no character classes.
+bool wildcard_match(const char* pattern, const char* name) {
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*')
+        return wildcard_match(pattern + 1, name) || (*name != '\0' && wildcard_match(pattern, name + 1));
+    return *name != '\0' && (*pattern == '?' || *pattern == *name) && wildcard_match(pattern + 1, name + 1);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+}
+
+std::vector<BatchJob> list_batch_jobs(const std::string& source, const std::string& out_dir,
+                                      const std::string& extension) {
+    auto output_for = [&](const fs::path& input) {
+        std::string ext = lower(extension.empty() ? input.extension().string() : extension);
+        if (!writable(ext)) ext = ".png";
+        return (fs::path(out_dir) / input.stem()).string() + ext;
+    };
+
+    std::vector<BatchJob> jobs;
+    const fs::path src(source);
+    const std::string name = src.filename().string();
+    if (name.find_first_of("*?") != std::string::npos) {
+        const fs::path dir = src.has_parent_path() ? src.parent_path() : fs::path(".");
+        if (!fs::is_directory(dir)) throw std::runtime_error("Batch source directory not found: " + dir.string());
+        for (const auto& entry : fs::directory_iterator(dir))
+            if (entry.is_regular_file() && wildcard_match(name.c_str(), entry.path().filename().string().c_str()))
+                jobs.push_back(BatchJob{entry.path().string(), output_for(entry.path())});
+    } else if (fs::is_directory(src)) {
+        for (const auto& entry : fs::directory_iterator(src))
+            if (entry.is_regular_file() && readable(entry.path()))
+                jobs.push_back(BatchJob{entry.path().string(), output_for(entry.path())});
+    } else {
+        std::ifstream f(source);
+        if (!f) throw std::runtime_error("Batch source not found: " + source);
+        for (std::string line; std::getline(f, line);) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            const size_t tab = line.find('\t');
+            if (tab == std::string::npos) jobs.push_back(BatchJob{line, output_for(line)});
+            else jobs.push_back(BatchJob{line.substr(0, tab), line.substr(tab + 1)});
+        }
+    }
+    // directory order is unspecified; a manifest keeps its own
+    if (name.find_first_of("*?") != std::string::npos || fs::is_directory(src))
+        std::sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) { return a.input < b.input; });
+
+    std::set<std::string> outputs;
+    for (const BatchJob& job : jobs)
+        if (!outputs.insert(job.output).second)
+            throw std::runtime_error("Two batch inputs map to the same output: " + job.output);
+    return jobs;
+}
+
+template <typename T>
+std::vector<BatchResult> run_batch(const std::vector<BatchJob>& jobs, const BatchProcess<T>& process,
+                                   const BatchOptions& options, const BatchReport& report) {
+    struct Slot { size_t index{0}; BasicImage<T> image; };
+
+    const int hw = ThreadPool::resolve(0);
+    const int decoders = options.decoders > 0 ? options.decoders : std::max(1, hw / 2);
+    const int workers = options.workers > 0 ? options.workers : hw;
+    const int encoders = options.encoders > 0 ? options.encoders : std::max(1, hw / 2);
+    const size_t depth = options.queue_depth > 0 ? (size_t)options.queue_depth : (size_t)workers;
+
+    std::vector<BatchResult> results(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        results[i].input = jobs[i].input;
+        results[i].output = jobs[i].output;
+    }
+    std::mutex report_mutex;
+    auto finish = [&](size_t i, std::string error) {
+        results[i].error = std::move(error);
+        if (!report) return;
+        std::lock_guard<std::mutex> lock(report_mutex);
+        report(results[i]);
+    };
+
+    detail::BoundedQueue<Slot> decoded(depth, decoders), processed(depth, workers);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < decoders; ++t)
+        threads.emplace_back([&] {
+            for (size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+                const auto t0 = std::chrono::steady_clock::now();
+                try {
+                    LUMINE_TRACE_SCOPE("batch.decode", "job", (double)i);
+                    Slot s{i, BasicImage<T>::load(jobs[i].input, options.force_grayscale)};
+                    results[i].decode_seconds = seconds_since(t0);
+                    decoded.push(std::move(s));
+                } catch (const std::exception& e) {
+                    finish(i, e.what());
+                }
+            }
+            decoded.producer_done();
+        });
+    for (int t = 0; t < workers; ++t)
+        threads.emplace_back([&] {
+            for (Slot s; decoded.pop(s);) {
+                const auto t0 = std::chrono::steady_clock::now();
+                try {
+                    LUMINE_TRACE_SCOPE("batch.compute", "job", (double)s.index);
+                    s.image = process(s.image);
+                    results[s.index].compute_seconds = seconds_since(t0);
+                    processed.push(std::move(s));
+                } catch (const std::exception& e) {
+                    finish(s.index, e.what());
+                }
+            }
+            processed.producer_done();
+        });
+    for (int t = 0; t < encoders; ++t)
+        threads.emplace_back([&] {
+            for (Slot s; processed.pop(s);) {
+                const auto t0 = std::chrono::steady_clock::now();
+                std::string error;
+                try {
+                    LUMINE_TRACE_SCOPE("batch.encode", "job", (double)s.index);
+                    s.image.save(jobs[s.index].output);
+                } catch (const std::exception& e) {
+                    error = e.what();
+                }
+                s.image = BasicImage<T>(); // back to the pool before the next pop
+                results[s.index].encode_seconds = seconds_since(t0);
+                finish(s.index, std::move(error));
+            }
+        });
+    for (auto& t : threads) t.join();
+    return results;
+}
+
+template std::vector<BatchResult> run_batch<float>(const std::vector<BatchJob>&, const BatchProcess<float>&,
+                                                   const BatchOptions&, const BatchReport&);
+template std::vector<BatchResult> run_batch<uint8_t>(const std::vector<BatchJob>&, const BatchProcess<uint8_t>&,
+                                                     const BatchOptions&, const BatchReport&);
+
+}
@@ -0,0 +1,247 @@
+#include "lumine/binary_image.hpp"
+#include "lumine/buffer_pool.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "conv_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lumine {
+
+BinaryImage::BinaryImage(int width, int height, Fill fill) {
+    allocate(width, height);
+    if (fill == Fill::Zero && m_block) std::memset(m_block.get(), 0, sizeof(uint64_t) * m_stride * m_height);
+}
+
+BinaryImage::BinaryImage(const BinaryImage& other) {
+    allocate(other.m_width, other.m_height);
+    if (m_block) std::memcpy(m_block.get(), other.m_block.get(), sizeof(uint64_t) * m_stride * m_height);
+}
+
+BinaryImage& BinaryImage::operator=(const BinaryImage& other) {
+    if (this != &other) *this = BinaryImage(other);
+    return *this;
+}
+
+void BinaryImage::allocate(int width, int height) {
+    if (width < 0 || height < 0) throw std::runtime_error("Invalid image dimensions");
+    constexpr size_t align = BufferPool::kAlignment / sizeof(uint64_t);
+    m_width = width; m_height = height;
+    m_stride = ((size_t)words() + align - 1) / align * align;
+    m_block.reset();
+    m_data = nullptr;
+    if ((size_t)width * height == 0) return;
+    m_block = BufferPool::global().acquire(sizeof(uint64_t) * m_stride * height);
+    m_data = static_cast<uint64_t*>(m_block.get());
+}
+
+BinaryImage BinaryImage::from_image(ConstImageView input, float threshold, int threads) {
+    BinaryImage out(input.width(), input.height(), Fill::None);
+    const detail::ConvKernels& kern = detail::conv_kernels();
+    ThreadPool::global().parallel_for(0, input.height(), 16, [&](int first, int last) {
+        for (int y = first; y < last; ++y) kern.threshold_bits(input.row(y, 0), input.width(), threshold, out.row(y));
+    }, ThreadPool::resolve(threads));
+    return out;
+}
+
+Image BinaryImage::to_image(int threads) const {
+    Image out(m_width, m_height, 1, Fill::None);
+    ThreadPool::global().parallel_for(0, m_height, 16, [&](int first, int last) {
+        for (int y = first; y < last; ++y) {
+            const uint64_t* bits = row(y);
+            float* o = out.row(y);
+            for (int x = 0; x < m_width; ++x) o[x] = (float)((bits[x >> 6] >> (x & 63)) & 1u);
+        }
+    }, ThreadPool::resolve(threads));
+    return out;
+}
+
+size_t BinaryImage::count() const {
+    const detail::ConvKernels& kern = detail::conv_kernels();
+    size_t total = 0;
+    for (int y = 0; y < m_height; ++y) total += (size_t)kern.popcount(row(y), words());
+    return total;
+}
+
+std::vector<int> BinaryImage::row_profile(int threads) const {
+    LUMINE_TRACE_SCOPE("row_profile", "width", m_width, "height", m_height);
+    const detail::ConvKernels& kern = detail::conv_kernels();
+    std::vector<int> profile(m_height);
+    ThreadPool::global().parallel_for(0, m_height, 64, [&](int first, int last) {
+        for (int y = first; y < last; ++y) profile[y] = (int)kern.popcount(row(y), words());
+    }, ThreadPool::resolve(threads));
+    return profile;
+}
+
+// Column sums 64 columns per word: a row is added into kPlanes bit planes
+// (plane k holds bit k of every column's running count) with a ripple of
+// AND/XOR, and the planes are flushed into the integer counts before they
+// can overflow.
+std::vector<int> BinaryImage::column_profile(int threads) const {
+    LUMINE_TRACE_SCOPE("column_profile", "width", m_width, "height", m_height);
+    constexpr int kPlanes = 8;
+    constexpr int kFlushRows = (1 << kPlanes) - 1;
+    constexpr int kBlockWords = 8;
+    std::vector<int> profile(m_width, 0);
+    const int n = words();
+    ThreadPool::global().parallel_for(0, (n + kBlockWords - 1) / kBlockWords, 1, [&](int first, int last) {
+        for (int blk = first; blk < last; ++blk) {
+            const int w0 = blk * kBlockWords, nw = std::min(kBlockWords, n - w0);
+            uint64_t planes[kPlanes][kBlockWords];
+            for (int y0 = 0; y0 < m_height; y0 += kFlushRows) {
+                std::memset(planes, 0, sizeof planes);
+                for (int y = y0; y < std::min(m_height, y0 + kFlushRows); ++y) {
+                    const uint64_t* bits = row(y) + w0;
+                    for (int j = 0; j < nw; ++j) {
+                        uint64_t carry = bits[j];
+                        for (int k = 0; k < kPlanes; ++k) {
+                            const uint64_t next = planes[k][j] & carry;
+                            planes[k][j] ^= carry;
+                            carry = next;
+                        }
+                    }
+                }
+                for (int j = 0; j < nw; ++j) {
+                    const int x0 = (w0 + j) * 64;
+                    for (int i = 0; i < std::min(64, m_width - x0); ++i) {
+                        int c = 0;
+                        for (int k = 0; k < kPlanes; ++k) c |= (int)((planes[k][j] >> i) & 1u) << k;
+                        profile[x0 + i] += c;
+                    }
+                }
+            }
+        }
+    }, ThreadPool::resolve(threads));
+    return profile;
+}
+
+void BinaryImage::invert() {
+    for (int y = 0; y < m_height; ++y) {
+        uint64_t* bits = row(y);
+        for (int i = 0; i < words(); ++i) bits[i] = ~bits[i];
+        mask_tail(y);
+    }
+}
+
+namespace {
+
+// Erosion ANDs, dilation ORs; pixels outside the image read as the
+// operation's identity, so they never change the result.
+template <bool Erode>
+struct MorphOp {
+    static constexpr uint64_t identity = Erode ? ~uint64_t(0) : 0;
+    uint64_t operator()(uint64_t a, uint64_t b) const { return Erode ? a & b : a | b; }
+};
+
+// s[x] = op(s[x], s[x + k]) for every bit x of s[0, n) words, with bits past
+// the end reading as the identity. In place: word i reads only words >= i.
+template <typename Op>
+void combine_shifted(uint64_t* s, int n, int k, Op op) {
+    const int q = k >> 6, b = k & 63;
+    const uint64_t id = Op::identity;
+    auto at = [&](int i) { return i < n ? s[i] : id; };
+    int i = 0;
+    for (; i + q + 1 < n; ++i)
+        s[i] = op(s[i], b ? (s[i + q] >> b) | (s[i + q + 1] << (64 - b)) : s[i + q]);
+    for (; i < n; ++i) s[i] = op(s[i], b ? (at(i + q) >> b) | (at(i + q + 1) << (64 - b)) : at(i + q));
+}
+
+// The same down rows: row y of `rows` (each `cols` words, `pitch` apart)
+// combines with row y + k; rows past the end are the identity.
+template <typename Op>
+void combine_rows(uint64_t* rows, size_t pitch, int n, int cols, int k, Op op) {
+    for (int y = 0; y + k < n; ++y) {
+        uint64_t* r = rows + (size_t)y * pitch;
+        const uint64_t* s = r + (size_t)k * pitch;
+        for (int j = 0; j < cols; ++j) r[j] = op(r[j], s[j]);
+    }
+}
+
+// Doubling: after the steps for spans 1, 2, 4, ... each position holds the
+// op over [x, x + span); one more shifted combine covers [x, x + len).
+template <typename Combine>
+void span_reduce(int len, Combine&& combine) {
+    int span = 1;
+    while (2 * span <= len) { combine(span); span *= 2; }
+    if (span < len) combine(len - span);
+}
+
+// Rows of `out` = the op over rows [y - r, y + r] of `in` (clipped).
+template <typename Op>
+void vertical_pass(const BinaryImage& in, BinaryImage& out, int r, Op op, int threads) {
+    constexpr int kBlockWords = 8;
+    const int n = in.words(), height = in.height(), padded = height + 2 * r;
+    ThreadPool::global().parallel_for(0, (n + kBlockWords - 1) / kBlockWords, 1, [&](int first, int last) {
+        std::vector<uint64_t> buf((size_t)padded * kBlockWords);
+        for (int blk = first; blk < last; ++blk) {
+            const int w0 = blk * kBlockWords, nw = std::min(kBlockWords, n - w0);
+            for (int p = 0; p < padded; ++p) {
+                uint64_t* b = buf.data() + (size_t)p * kBlockWords;
+                const int y = p - r;
+                if (y < 0 || y >= height) std::fill_n(b, nw, Op::identity);
+                else std::copy_n(in.row(y) + w0, nw, b);
+            }
+            span_reduce(2 * r + 1, [&](int k) { combine_rows(buf.data(), kBlockWords, padded, nw, k, op); });
+            for (int y = 0; y < height; ++y) std::copy_n(buf.data() + (size_t)y * kBlockWords, nw, out.row(y) + w0);
+        }
+    }, ThreadPool::resolve(threads));
+}
+
+// Each row of `img` in place = the op over columns [x - r, x + r] (clipped).
+template <typename Op>
+void horizontal_pass(BinaryImage& img, int r, Op op, int threads) {
+    const int n = img.words(), width = img.width();
+    const int pad = (r + 63) / 64, total = pad + n;
+    const int offset = pad * 64 - r, q = offset >> 6, b = offset & 63;
+    const uint64_t id = Op::identity;
+    ThreadPool::global().parallel_for(0, img.height(), 16, [&](int first, int last) {
+        std::vector<uint64_t> buf(total);
+        for (int y = first; y < last; ++y) {
+            uint64_t* bits = img.row(y);
+            std::fill_n(buf.begin(), pad, id);
+            std::copy_n(bits, n, buf.begin() + pad);
+            if (width & 63) buf[total - 1] |= id & (~uint64_t(0) << (width & 63));
+            span_reduce(2 * r + 1, [&](int k) { combine_shifted(buf.data(), total, k, op); });
+            // bit x of the row is bit offset + x of buf
+            for (int i = 0; i < n; ++i) {
+                const uint64_t lo = buf[i + q];
+                const uint64_t hi = i + q + 1 < total ? buf[i + q + 1] : id;
+                bits[i] = b ? (lo >> b) | (hi << (64 - b)) : lo;
+            }
+            img.mask_tail(y);
+        }
+    }, ThreadPool::resolve(threads));
+}
+
+template <typename Op>
+BinaryImage morph(const BinaryImage& input, int rx, int ry, Op op, int threads) {
+    if (rx < 0 || ry < 0) throw std::runtime_error("Morphology: radius must not be negative");
+    BinaryImage out(input.width(), input.height(), Fill::None);
+    if (out.empty()) return out;
+    vertical_pass(input, out, ry, op, threads);
+    if (rx > 0) horizontal_pass(out, rx, op, threads);
+    return out;
+}
+
+}
+
+BinaryImage Morphology::erode(const BinaryImage& input, int rx, int ry, int threads) {
+    LUMINE_TRACE_SCOPE("erode", "width", input.width(), "height", input.height());
+    return morph(input, rx, ry, MorphOp<true>{}, threads);
+}
+
+BinaryImage Morphology::dilate(const BinaryImage& input, int rx, int ry, int threads) {
+    LUMINE_TRACE_SCOPE("dilate", "width", input.width(), "height", input.height());
+    return morph(input, rx, ry, MorphOp<false>{}, threads);
+}
+
+BinaryImage Morphology::open(const BinaryImage& input, int rx, int ry, int threads) {
+    return dilate(erode(input, rx, ry, threads), rx, ry, threads);
+}
+
+BinaryImage Morphology::close(const BinaryImage& input, int rx, int ry, int threads) {
+    return erode(dilate(input, rx, ry, threads), rx, ry, threads);
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace lumine::detail {
+
+// Waiting items between two stages. push() blocks while the queue is full;
+// pop() blocks while it is empty and returns false once every producer has
+// finished and the queue is drained.
+template <typename Item>
+class BoundedQueue {
+    public:
+        BoundedQueue(size_t capacity, int producers) : m_capacity(std::max<size_t>(1, capacity)), m_producers(producers) {}
+
+        void push(Item item) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [&] { return m_items.size() < m_capacity; });
+            m_items.push_back(std::move(item));
+            m_not_empty.notify_one();
+        }
+
+        bool pop(Item& out) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock, [&] { return !m_items.empty() || m_producers == 0; });
+            if (m_items.empty()) return false;
+            out = std::move(m_items.front());
+            m_items.pop_front();
+            m_not_full.notify_one();
+            return true;
+        }
+
+        void producer_done() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_producers == 0) m_not_empty.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_not_full, m_not_empty;
+        std::deque<Item> m_items;
+        size_t m_capacity;
+        int m_producers;
+};
+
+}
@@ -0,0 +1,99 @@
+#include "lumine/buffer_pool.hpp"
+#include "lumine/trace.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace lumine {
+
+BufferPool::BufferPool(size_t capacity) : m_capacity(capacity) {}
+
+BufferPool::~BufferPool() { trim(); }
+
+BufferPool& BufferPool::global() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+// Four classes per power of two (at most ~19% slack); small blocks round up
+// to a power of two.
+size_t BufferPool::size_class(size_t bytes) {
+    constexpr size_t kSmall = 4096;
+    if (bytes <= kAlignment) return kAlignment;
+    if (bytes <= kSmall) {
+        size_t c = kAlignment;
+        while (c < bytes) c <<= 1;
+        return c;
+    }
+    size_t top = kSmall;
+    while (top * 2 <= bytes) top <<= 1;
+    const size_t step = top / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+std::shared_ptr<void> BufferPool::acquire(size_t bytes) {
+    const size_t size = size_class(bytes);
+    void* block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find(size);
+        if (it != m_free.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+            m_cached -= size;
+        }
+    }
+    if (!block) {
+        block = std::aligned_alloc(kAlignment, size);
+        if (!block) throw std::bad_alloc();
+        LUMINE_TRACE_COUNT("bytes.allocated", (double)size);
+    } else {
+        LUMINE_TRACE_COUNT("bytes.reused", (double)size);
+    }
+    return std::shared_ptr<void>(block, [this, size](void* p) { release(p, size); });
+}
+
+void BufferPool::release(void* block, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cached + size <= m_capacity) {
+            m_free[size].push_back(block);
+            m_cached += size;
+            return;
+        }
+    }
+    std::free(block);
+}
+
+void BufferPool::evict_locked(size_t limit) {
+    // largest classes first: they hold the most memory per block
+    for (auto it = m_free.rbegin(); it != m_free.rend() && m_cached > limit; ++it) {
+        while (!it->second.empty() && m_cached > limit) {
+            std::free(it->second.back());
+            it->second.pop_back();
+            m_cached -= it->first;
+        }
+    }
+}
+
+void BufferPool::set_capacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = bytes;
+    evict_locked(bytes);
+}
+
+size_t BufferPool::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+size_t BufferPool::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cached;
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    evict_locked(0);
+}
+
+}
@@ -0,0 +1,242 @@
+#include "lumine/components.hpp"
+#include "lumine/buffer_pool.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace lumine {
+
+namespace {
+
+// Statistics of a provisional label; sums are exact integers, so merging
+// them in any order gives the same result.
+struct Stats {
+    int x0, y0, x1, y1; // inclusive bounds
+    int64_t area, sum_x, sum_y;
+
+    void add_run(int y, int a, int b) {
+        const int64_t n = b - a;
+        x0 = std::min(x0, a); x1 = std::max(x1, b - 1);
+        y0 = std::min(y0, y); y1 = std::max(y1, y);
+        area += n;
+        sum_x += (int64_t)(a + b - 1) * n / 2;
+        sum_y += (int64_t)y * n;
+    }
+    void merge(const Stats& o) {
+        x0 = std::min(x0, o.x0); x1 = std::max(x1, o.x1);
+        y0 = std::min(y0, o.y0); y1 = std::max(y1, o.y1);
+        area += o.area; sum_x += o.sum_x; sum_y += o.sum_y;
+    }
+};
+
+// Union-find over labels whose roots are the smallest label of their set
+// (the earliest in raster order), so every parent is below its child; the
+// absorbed root's stats move to the survivor. The arrays are shared by all
+// bands: a band creates at most one label per run, so the labels of a band
+// starting at run k are numbered from k and never collide with another's.
+struct Labels {
+    int* parent;
+    Stats* stats;
+    int next; // the label create() hands out
+
+    int create(int y, int a, int b) {
+        const int l = next++;
+        parent[l] = l;
+        stats[l] = Stats{a, y, b - 1, y, 0, 0, 0};
+        stats[l].add_run(y, a, b);
+        return l;
+    }
+    int find(int l) {
+        while (parent[l] != l) l = parent[l] = parent[parent[l]];
+        return l;
+    }
+    // Roots in, root out.
+    int unite(int a, int b) {
+        if (a == b) return a;
+        if (b < a) std::swap(a, b);
+        parent[b] = a;
+        stats[a].merge(stats[b]);
+        return a;
+    }
+};
+
+// Where runs of set bits start and end in word i of a row (words ^ flip,
+// `width` bits): bit b of w ^ (w << 1 | carry) is set where pixel b differs
+// from its left neighbour. `carry` holds the last pixel of the previous word.
+inline uint64_t transitions(const uint64_t* words, int i, int n, int width, uint64_t flip, uint64_t& carry) {
+    uint64_t w = words[i] ^ flip;
+    if (i == n - 1 && (width & 63)) w &= ~uint64_t(0) >> (64 - (width & 63));
+    const uint64_t t = w ^ ((w << 1) | carry);
+    carry = w >> 63;
+    return t;
+}
+
+int count_runs(const uint64_t* words, int width, uint64_t flip) {
+    const int n = (width + 63) / 64;
+    uint64_t carry = 0;
+    int edges = 0;
+    for (int i = 0; i < n; ++i) edges += __builtin_popcountll(transitions(words, i, n, width, flip, carry));
+    return (edges + (int)carry) / 2;
+}
+
+// Writes the runs of row y to `out`, taking the transitions in pairs with
+// ctz, so a run costs the same whatever its length.
+void extract_runs(const uint64_t* words, int width, uint64_t flip, int y, LabeledRun* out) {
+    const int n = (width + 63) / 64;
+    uint64_t carry = 0;
+    int start = -1; // a run still open at a word boundary
+    for (int i = 0; i < n; ++i) {
+        uint64_t t = transitions(words, i, n, width, flip, carry);
+        const int base = i * 64;
+        if (start >= 0 && t) {
+            *out++ = LabeledRun{y, start, base + __builtin_ctzll(t), -1};
+            t &= t - 1;
+            start = -1;
+        }
+        while (t) {
+            const int a = base + __builtin_ctzll(t);
+            t &= t - 1;
+            if (!t) { start = a; break; }
+            *out++ = LabeledRun{y, a, base + __builtin_ctzll(t), -1};
+            t &= t - 1;
+        }
+    }
+    if (start >= 0) *out = LabeledRun{y, start, width, -1};
+}
+
+// Gives each run of `cur` the label of the runs of `prev` it touches (gap
+// < reach columns, 1 for 8-connectivity), uniting them, or a new label.
+void connect_rows(const LabeledRun* prev, const LabeledRun* prev_end, LabeledRun* cur, LabeledRun* cur_end,
+                  int reach, Labels& labels) {
+    for (; cur != cur_end; ++cur) {
+        while (prev != prev_end && prev->x1 + reach <= cur->x0) ++prev;
+        int label = -1;
+        for (const LabeledRun* p = prev; p != prev_end && p->x0 < cur->x1 + reach; ++p) {
+            if (p->label == label) continue; // the common case: one run above
+            const int root = labels.find(p->label);
+            label = label < 0 ? root : labels.unite(label, root);
+        }
+        if (label < 0) label = labels.create(cur->y, cur->x0, cur->x1);
+        else labels.stats[label].add_run(cur->y, cur->x0, cur->x1);
+        cur->label = label;
+    }
+}
+
+// The same across a band boundary, where both rows are labelled already:
+// only unites.
+void stitch_rows(const LabeledRun* prev, const LabeledRun* prev_end, const LabeledRun* cur, const LabeledRun* cur_end,
+                 int reach, Labels& labels) {
+    for (; cur != cur_end; ++cur) {
+        while (prev != prev_end && prev->x1 + reach <= cur->x0) ++prev;
+        int label = labels.find(cur->label);
+        for (const LabeledRun* p = prev; p != prev_end && p->x0 < cur->x1 + reach; ++p)
+            label = labels.unite(label, labels.find(p->label));
+    }
+}
+
+// Rows [y0, y1); runs[k] for k in [row_start[y], row_start[y + 1]) are the
+// runs of row y, and the band's labels are [row_start[y0], labels.next).
+struct Band {
+    int y0{0}, y1{0};
+    Labels labels{};
+};
+
+void label_band(const BinaryImage& image, uint64_t flip, int reach, const std::vector<size_t>& row_start,
+                LabeledRun* runs, Band& band) {
+    for (int y = band.y0; y < band.y1; ++y) {
+        LabeledRun* cur = runs + row_start[y];
+        LabeledRun* cur_end = runs + row_start[y + 1];
+        extract_runs(image.row(y), image.width(), flip, y, cur);
+        if (y == band.y0) {
+            for (LabeledRun* r = cur; r != cur_end; ++r) r->label = band.labels.create(y, r->x0, r->x1);
+            continue;
+        }
+        connect_rows(runs + row_start[y - 1], cur, cur, cur_end, reach, band.labels);
+    }
+}
+
+}
+
+ConnectedComponents ConnectedComponents::label(const BinaryImage& image, Connectivity connectivity, bool foreground,
+                                               int threads) {
+    LUMINE_TRACE_SCOPE("components", "width", image.width(), "height", image.height());
+    ConnectedComponents cc;
+    if (image.empty()) return cc;
+    const uint64_t flip = foreground ? 0 : ~uint64_t(0);
+    const int reach = connectivity == Connectivity::Eight ? 1 : 0;
+    const int nthreads = ThreadPool::resolve(threads);
+    const int height = image.height();
+
+    // Count the runs of each row first, so every band writes its runs
+    // straight into place in m_runs.
+    std::vector<size_t> row_start(height + 1, 0);
+    ThreadPool::global().parallel_for(0, height, 64, [&](int first, int last) {
+        for (int y = first; y < last; ++y) row_start[y + 1] = (size_t)count_runs(image.row(y), image.width(), flip);
+    }, nthreads);
+    for (int y = 0; y < height; ++y) row_start[y + 1] += row_start[y];
+    const size_t total = row_start[height];
+    if (total > (size_t)std::numeric_limits<int>::max()) throw std::runtime_error("ConnectedComponents: too many runs");
+    if (total == 0) return cc;
+    cc.m_runs.resize(total);
+    LabeledRun* runs = cc.m_runs.data();
+    // Room for one label per run; pooled and uninitialized, so only the
+    // labels actually created are touched.
+    std::shared_ptr<void> parent_block = BufferPool::global().acquire(sizeof(int) * total);
+    std::shared_ptr<void> stats_block = BufferPool::global().acquire(sizeof(Stats) * total);
+    Labels all{static_cast<int*>(parent_block.get()), static_cast<Stats*>(stats_block.get()), 0};
+
+    // Bands of at least 64 rows, a few per thread for balance.
+    constexpr int kMinBandRows = 64;
+    const int count = std::max(1, std::min(4 * nthreads, height / kMinBandRows));
+    std::vector<Band> bands(count);
+    for (int s = 0; s < count; ++s) {
+        bands[s].y0 = (int)((int64_t)height * s / count);
+        bands[s].y1 = (int)((int64_t)height * (s + 1) / count);
+        bands[s].labels = Labels{all.parent, all.stats, (int)row_start[bands[s].y0]};
+    }
+    ThreadPool::global().parallel_for(0, count, 1, [&](int first, int last) {
+        for (int s = first; s < last; ++s) label_band(image, flip, reach, row_start, runs, bands[s]);
+    }, nthreads);
+    for (int s = 1; s < count; ++s) {
+        const int y = bands[s].y0;
+        stitch_rows(runs + row_start[y - 1], runs + row_start[y], runs + row_start[y], runs + row_start[y + 1], reach,
+                    all);
+    }
+
+    // Roots in label order are components in raster order of their first
+    // pixel. Parents are below their children, so one ascending pass can
+    // replace each entry by ~component: a child reads its parent's, done.
+    size_t created = 0;
+    for (const Band& b : bands) created += (size_t)b.labels.next - row_start[b.y0];
+    cc.m_components.reserve(created);
+    for (const Band& b : bands)
+        for (int l = (int)row_start[b.y0]; l < b.labels.next; ++l) {
+            const int p = all.parent[l];
+            if (p != l) { all.parent[l] = all.parent[p]; continue; }
+            all.parent[l] = ~(int)cc.m_components.size();
+            const Stats& st = all.stats[l];
+            Component c;
+            c.x = st.x0; c.y = st.y0;
+            c.width = st.x1 - st.x0 + 1; c.height = st.y1 - st.y0 + 1;
+            c.area = st.area;
+            c.cx = (double)st.sum_x / (double)st.area;
+            c.cy = (double)st.sum_y / (double)st.area;
+            cc.m_components.push_back(c);
+        }
+    ThreadPool::global().parallel_for(0, count, 1, [&](int first, int last) {
+        for (int s = first; s < last; ++s)
+            for (size_t k = row_start[bands[s].y0]; k < row_start[bands[s].y1]; ++k)
+                runs[k].label = ~all.parent[runs[k].label];
+    }, nthreads);
+    LUMINE_TRACE_COUNT("components.found", (double)cc.m_components.size());
+    return cc;
+}
+
+ConnectedComponents ConnectedComponents::label(ConstImageView image, Connectivity connectivity, bool foreground,
+                                               int threads) {
+    return label(BinaryImage::from_image(image, 0.5f, threads), connectivity, foreground, threads);
+}
+
+}
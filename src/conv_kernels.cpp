@@ -0,0 +1,990 @@
+#include "conv_kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define LUMINE_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(LUMINE_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define LUMINE_HAS_AVX2 1
+#include <immintrin.h>
+#define LUMINE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace lumine::detail {
+
+// ---------------------------------------------------------------- scalar
+
+static void fir_row_scalar(const float* src, int step, const float* w, int kw, float* dst, int n, bool accumulate) {
+    for (int i = 0; i < n; ++i) {
+        const float* s = src + (size_t)i*step;
+        float acc = accumulate ? dst[i] : 0.0f;
+        for (int k = 0; k < kw; ++k) acc += s[k] * w[k];
+        dst[i] = acc;
+    }
+}
+
+static void fir_cols_scalar(const float* const* rows, const float* w, int kh, float* dst, int n) {
+    for (int i = 0; i < n; ++i) {
+        float acc = 0.0f;
+        for (int k = 0; k < kh; ++k) acc += rows[k][i] * w[k];
+        dst[i] = acc;
+    }
+}
+
+static void fir_row_q_scalar(const uint8_t* src, int step, const int32_t* w, int kw, int32_t* dst, int n) {
+    for (int i = 0; i < n; ++i) {
+        const uint8_t* s = src + (size_t)i*step;
+        int32_t acc = dst[i];
+        for (int k = 0; k < kw; ++k) acc += s[k] * w[k];
+        dst[i] = acc;
+    }
+}
+
+static void fir_cols_q_scalar(const int32_t* const* rows, const int32_t* w, int kh, int32_t* dst, int n) {
+    for (int i = 0; i < n; ++i) {
+        int32_t acc = 0;
+        for (int k = 0; k < kh; ++k) acc += rows[k][i] * w[k];
+        dst[i] = acc;
+    }
+}
+
+// atan2 without libm: the ratio of the smaller to the larger |component|
+// is folded below tan(pi/8) and fed to the Cephes atanf polynomial, then
+// the octant is restored. Within ~5e-7 rad of std::atan2, signed zeros
+// included; bank_row_avx2 runs the same steps on vectors.
+constexpr float kAtanP[4] = {8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f};
+constexpr float kTanPi8 = 0.414213562373f;
+
+static inline float bank_atan2(float y, float x) {
+    const float ax = std::fabs(x), ay = std::fabs(y);
+    const float mx = std::max(ax, ay), mn = std::min(ax, ay);
+    const float a = mx > 0.0f ? mn / mx : 0.0f;
+    const bool fold = a > kTanPi8;
+    const float t = fold ? (a - 1.0f) / (a + 1.0f) : a;
+    const float z = t*t;
+    float r = (((kAtanP[0]*z + kAtanP[1])*z + kAtanP[2])*z + kAtanP[3])*z*t + t;
+    if (fold) r += 0.25f*kPi<float>;
+    if (ay > ax) r = 0.5f*kPi<float> - r;
+    if (std::signbit(x)) r = kPi<float> - r;
+    return std::signbit(y) ? -r : r;
+}
+
+static inline void bank_store(const float* r, int nk, BankOut out, float* const* dst, int i) {
+    switch (out) {
+        case BankOut::Each:
+            for (int k = 0; k < nk; ++k) dst[k][i] = r[k];
+            break;
+        case BankOut::Magnitude: {
+            float s = 0.0f;
+            for (int k = 0; k < nk; ++k) s += r[k] * r[k];
+            dst[0][i] = std::sqrt(s);
+            break;
+        }
+        case BankOut::Orientation:
+            dst[0][i] = bank_atan2(r[1], r[0]);
+            break;
+        case BankOut::Max: {
+            float m = r[0];
+            for (int k = 1; k < nk; ++k) m = std::max(m, r[k]);
+            dst[0][i] = m;
+            break;
+        }
+    }
+}
+
+static void bank_row_scalar(const float* const* taps, int ntaps, int step, const float* w, int nk,
+                            BankOut out, float* const* dst, int n) {
+    for (int i = 0; i < n; ++i) {
+        float r[kMaxBankKernels] = {};
+        for (int t = 0; t < ntaps; ++t) {
+            const float v = taps[t][(size_t)i*step];
+            for (int k = 0; k < nk; ++k) r[k] += v * w[(size_t)t*nk + k];
+        }
+        bank_store(r, nk, out, dst, i);
+    }
+}
+
+// ------------------------------------------------------------------ SSE2
+
+#ifdef LUMINE_HAS_SSE2
+static void fir_row_sse2(const float* src, int step, const float* w, int kw, float* dst, int n, bool accumulate) {
+    int i = 0;
+    if (step == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m128 a0 = accumulate ? _mm_loadu_ps(dst + i) : _mm_setzero_ps();
+            __m128 a1 = accumulate ? _mm_loadu_ps(dst + i + 4) : _mm_setzero_ps();
+            for (int k = 0; k < kw; ++k) {
+                __m128 wk = _mm_set1_ps(w[k]);
+                a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(src + i + k), wk));
+                a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(src + i + 4 + k), wk));
+            }
+            _mm_storeu_ps(dst + i, a0);
+            _mm_storeu_ps(dst + i + 4, a1);
+        }
+    }
+    fir_row_scalar(src + (size_t)i*step, step, w, kw, dst + i, n - i, accumulate);
+}
+
+static void fir_cols_sse2(const float* const* rows, const float* w, int kh, float* dst, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+        for (int k = 0; k < kh; ++k) {
+            __m128 wk = _mm_set1_ps(w[k]);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), wk));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(rows[k] + i + 4), wk));
+        }
+        _mm_storeu_ps(dst + i, a0);
+        _mm_storeu_ps(dst + i + 4, a1);
+    }
+    for (; i < n; ++i) {
+        float acc = 0.0f;
+        for (int k = 0; k < kh; ++k) acc += rows[k][i] * w[k];
+        dst[i] = acc;
+    }
+}
+#endif
+
+// ------------------------------------------------------------- AVX2/FMA
+
+#ifdef LUMINE_HAS_AVX2
+LUMINE_TARGET_AVX2
+static void fir_row_avx2(const float* src, int step, const float* w, int kw, float* dst, int n, bool accumulate) {
+    int i = 0;
+    if (step == 1) {
+        // four independent accumulators hide the FMA latency for short kernels
+        for (; i + 32 <= n; i += 32) {
+            __m256 a0, a1, a2, a3;
+            if (accumulate) {
+                a0 = _mm256_loadu_ps(dst + i);      a1 = _mm256_loadu_ps(dst + i + 8);
+                a2 = _mm256_loadu_ps(dst + i + 16); a3 = _mm256_loadu_ps(dst + i + 24);
+            } else {
+                a0 = a1 = a2 = a3 = _mm256_setzero_ps();
+            }
+            for (int k = 0; k < kw; ++k) {
+                const __m256 wk = _mm256_set1_ps(w[k]);
+                const float* s = src + i + k;
+                a0 = _mm256_fmadd_ps(_mm256_loadu_ps(s), wk, a0);
+                a1 = _mm256_fmadd_ps(_mm256_loadu_ps(s + 8), wk, a1);
+                a2 = _mm256_fmadd_ps(_mm256_loadu_ps(s + 16), wk, a2);
+                a3 = _mm256_fmadd_ps(_mm256_loadu_ps(s + 24), wk, a3);
+            }
+            _mm256_storeu_ps(dst + i, a0);      _mm256_storeu_ps(dst + i + 8, a1);
+            _mm256_storeu_ps(dst + i + 16, a2); _mm256_storeu_ps(dst + i + 24, a3);
+        }
+        for (; i + 8 <= n; i += 8) {
+            __m256 a = accumulate ? _mm256_loadu_ps(dst + i) : _mm256_setzero_ps();
+            for (int k = 0; k < kw; ++k)
+                a = _mm256_fmadd_ps(_mm256_loadu_ps(src + i + k), _mm256_set1_ps(w[k]), a);
+            _mm256_storeu_ps(dst + i, a);
+        }
+    } else {
+        const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+        for (; i + 8 <= n; i += 8) {
+            const float* s = src + (size_t)i*step;
+            __m256 a = accumulate ? _mm256_loadu_ps(dst + i) : _mm256_setzero_ps();
+            for (int k = 0; k < kw; ++k)
+                a = _mm256_fmadd_ps(_mm256_i32gather_ps(s + k, lanes, 4), _mm256_set1_ps(w[k]), a);
+            _mm256_storeu_ps(dst + i, a);
+        }
+    }
+    for (; i < n; ++i) {
+        const float* s = src + (size_t)i*step;
+        float acc = accumulate ? dst[i] : 0.0f;
+        for (int k = 0; k < kw; ++k) acc = std::fma(s[k], w[k], acc);
+        dst[i] = acc;
+    }
+}
+
+LUMINE_TARGET_AVX2
+static void fir_cols_avx2(const float* const* rows, const float* w, int kh, float* dst, int n) {
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+        __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+        for (int k = 0; k < kh; ++k) {
+            const __m256 wk = _mm256_set1_ps(w[k]);
+            const float* r = rows[k] + i;
+            a0 = _mm256_fmadd_ps(_mm256_loadu_ps(r), wk, a0);
+            a1 = _mm256_fmadd_ps(_mm256_loadu_ps(r + 8), wk, a1);
+            a2 = _mm256_fmadd_ps(_mm256_loadu_ps(r + 16), wk, a2);
+            a3 = _mm256_fmadd_ps(_mm256_loadu_ps(r + 24), wk, a3);
+        }
+        _mm256_storeu_ps(dst + i, a0);      _mm256_storeu_ps(dst + i + 8, a1);
+        _mm256_storeu_ps(dst + i + 16, a2); _mm256_storeu_ps(dst + i + 24, a3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_setzero_ps();
+        for (int k = 0; k < kh; ++k)
+            a = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(w[k]), a);
+        _mm256_storeu_ps(dst + i, a);
+    }
+    for (; i < n; ++i) {
+        float acc = 0.0f;
+        for (int k = 0; k < kh; ++k) acc = std::fma(rows[k][i], w[k], acc);
+        dst[i] = acc;
+    }
+}
+#endif
+
+#ifdef LUMINE_HAS_AVX2
+LUMINE_TARGET_AVX2
+static void fir_row_q_avx2(const uint8_t* src, int step, const int32_t* w, int kw, int32_t* dst, int n) {
+    int i = 0;
+    if (step == 1) {
+        for (; i + 16 <= n; i += 16) {
+            __m256i a0 = _mm256_loadu_si256((const __m256i*)(dst + i));
+            __m256i a1 = _mm256_loadu_si256((const __m256i*)(dst + i + 8));
+            for (int k = 0; k < kw; ++k) {
+                const __m256i wk = _mm256_set1_epi32(w[k]);
+                const __m128i px = _mm_loadu_si128((const __m128i*)(src + i + k));
+                a0 = _mm256_add_epi32(a0, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(px), wk));
+                a1 = _mm256_add_epi32(a1, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(px, 8)), wk));
+            }
+            _mm256_storeu_si256((__m256i*)(dst + i), a0);
+            _mm256_storeu_si256((__m256i*)(dst + i + 8), a1);
+        }
+    }
+    fir_row_q_scalar(src + (size_t)i*step, step, w, kw, dst + i, n - i);
+}
+
+LUMINE_TARGET_AVX2
+static void fir_cols_q_avx2(const int32_t* const* rows, const int32_t* w, int kh, int32_t* dst, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+        for (int k = 0; k < kh; ++k) {
+            const __m256i wk = _mm256_set1_epi32(w[k]);
+            a0 = _mm256_add_epi32(a0, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(rows[k] + i)), wk));
+            a1 = _mm256_add_epi32(a1, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(rows[k] + i + 8)), wk));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), a0);
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), a1);
+    }
+    for (; i < n; ++i) {
+        int32_t acc = 0;
+        for (int k = 0; k < kh; ++k) acc += rows[k][i] * w[k];
+        dst[i] = acc;
+    }
+}
+#endif
+
+#ifdef LUMINE_HAS_AVX2
+// bank_atan2 on 8 lanes; blendv selects on the sign bit, so x and y
+// themselves pick the half-planes.
+LUMINE_TARGET_AVX2 static inline __m256 atan2_avx2(__m256 y, __m256 x) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 ax = _mm256_andnot_ps(sign, x), ay = _mm256_andnot_ps(sign, y);
+    const __m256 mx = _mm256_max_ps(ax, ay), mn = _mm256_min_ps(ax, ay);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 a = _mm256_and_ps(_mm256_div_ps(mn, mx), _mm256_cmp_ps(mx, _mm256_setzero_ps(), _CMP_GT_OQ));
+    const __m256 fold = _mm256_cmp_ps(a, _mm256_set1_ps(kTanPi8), _CMP_GT_OQ);
+    const __m256 t = _mm256_blendv_ps(a, _mm256_div_ps(_mm256_sub_ps(a, one), _mm256_add_ps(a, one)), fold);
+    const __m256 z = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(kAtanP[0]), z, _mm256_set1_ps(kAtanP[1]));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kAtanP[2]));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kAtanP[3]));
+    __m256 r = _mm256_fmadd_ps(_mm256_mul_ps(p, z), t, t);
+    r = _mm256_blendv_ps(r, _mm256_add_ps(r, _mm256_set1_ps(0.25f*kPi<float>)), fold);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(0.5f*kPi<float>), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi<float>), r), x);
+    return _mm256_xor_ps(r, _mm256_and_ps(y, sign));
+}
+
+// One vector of 8 outputs keeps all NK accumulators in registers; every tap
+// is one load (a gather when strided) shared by the NK multiply-adds.
+template <int NK>
+LUMINE_TARGET_AVX2 static int bank_row_avx2_n(const float* const* taps, int ntaps, int step, const float* w,
+                                              BankOut out, float* const* dst, int n) {
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 r[NK];
+        for (int k = 0; k < NK; ++k) r[k] = _mm256_setzero_ps();
+        for (int t = 0; t < ntaps; ++t) {
+            const float* s = taps[t] + (size_t)i*step;
+            const __m256 v = step == 1 ? _mm256_loadu_ps(s) : _mm256_i32gather_ps(s, lanes, 4);
+            const float* wt = w + (size_t)t*NK;
+            for (int k = 0; k < NK; ++k) r[k] = _mm256_fmadd_ps(v, _mm256_set1_ps(wt[k]), r[k]);
+        }
+        if (out == BankOut::Each) {
+            for (int k = 0; k < NK; ++k) _mm256_storeu_ps(dst[k] + i, r[k]);
+        } else if (out == BankOut::Magnitude) {
+            __m256 s = _mm256_mul_ps(r[0], r[0]);
+            for (int k = 1; k < NK; ++k) s = _mm256_fmadd_ps(r[k], r[k], s);
+            _mm256_storeu_ps(dst[0] + i, _mm256_sqrt_ps(s));
+        } else if (out == BankOut::Orientation) {
+            if constexpr (NK == 2) _mm256_storeu_ps(dst[0] + i, atan2_avx2(r[1], r[0]));
+        } else {
+            __m256 m = r[0];
+            for (int k = 1; k < NK; ++k) m = _mm256_max_ps(m, r[k]);
+            _mm256_storeu_ps(dst[0] + i, m);
+        }
+    }
+    return i;
+}
+
+LUMINE_TARGET_AVX2
+static void bank_row_avx2(const float* const* taps, int ntaps, int step, const float* w, int nk,
+                          BankOut out, float* const* dst, int n) {
+    int i = 0;
+    switch (nk) {
+        case 1: i = bank_row_avx2_n<1>(taps, ntaps, step, w, out, dst, n); break;
+        case 2: i = bank_row_avx2_n<2>(taps, ntaps, step, w, out, dst, n); break;
+        case 3: i = bank_row_avx2_n<3>(taps, ntaps, step, w, out, dst, n); break;
+        case 4: i = bank_row_avx2_n<4>(taps, ntaps, step, w, out, dst, n); break;
+        case 5: i = bank_row_avx2_n<5>(taps, ntaps, step, w, out, dst, n); break;
+        case 6: i = bank_row_avx2_n<6>(taps, ntaps, step, w, out, dst, n); break;
+        case 7: i = bank_row_avx2_n<7>(taps, ntaps, step, w, out, dst, n); break;
+        default: i = bank_row_avx2_n<8>(taps, ntaps, step, w, out, dst, n); break;
+    }
+    for (; i < n; ++i) {
+        float r[kMaxBankKernels] = {};
+        for (int t = 0; t < ntaps; ++t) {
+            const float v = taps[t][(size_t)i*step];
+            for (int k = 0; k < nk; ++k) r[k] = std::fma(v, w[(size_t)t*nk + k], r[k]);
+        }
+        bank_store(r, nk, out, dst, i);
+    }
+}
+#endif
+
+// ------------------------------------------------------------- recursive
+
+// Deriche (1993) approximates the Gaussian by sum_k a_k exp(-l_k |x| / sigma)
+// with two conjugate pairs (a_k, l_k); each pair is one real second-order
+// section per direction.
+DericheGauss deriche_gauss(double sigma) {
+    using cplx = std::complex<double>;
+    const cplx alpha[2] = {{0.84, 1.8675}, {-0.34015, -0.1299}};
+    const cplx lambda[2] = {{1.783, 0.6318}, {1.723, 1.997}};
+    double total = 0; // sum of the response over all taps
+    for (int k = 0; k < 2; ++k) {
+        const cplx r = std::exp(-lambda[k] / sigma);
+        total += 2.0 * (alpha[k] * (1.0 + r) / (1.0 - r)).real();
+    }
+    DericheGauss g;
+    for (int k = 0; k < 2; ++k) {
+        const cplx a = alpha[k], r = std::exp(-lambda[k] / sigma);
+        g.n0[k] = (float)(2.0 * a.real() / total);
+        g.n1[k] = (float)(-2.0 * (a * std::conj(r)).real() / total);
+        g.m1[k] = (float)(2.0 * (a * r).real() / total);
+        g.m2[k] = (float)(-2.0 * std::norm(r) * a.real() / total);
+        g.d1[k] = (float)(-2.0 * r.real());
+        g.d2[k] = (float)std::norm(r);
+    }
+    return g;
+}
+
+// The lane loops have a constant trip count, so the compiler keeps the
+// per-lane state in vector registers. These serve the baseline tables; AVX2
+// has hand-scheduled versions below.
+template <int L>
+static inline __attribute__((always_inline)) void iir_lanes_body(const DericheGauss& g, const float* src, size_t pitch,
+                                                               int n, Padding pad, float* dst) {
+    const float n0a = g.n0[0], n1a = g.n1[0], m1a = g.m1[0], m2a = g.m2[0], d1a = g.d1[0], d2a = g.d2[0];
+    const float n0b = g.n0[1], n1b = g.n1[1], m1b = g.m1[1], m2b = g.m2[1], d1b = g.d1[1], d2b = g.d2[1];
+    // a constant signal u gives the steady states u * gain
+    const float ca = (n0a + n1a) / (1.0f + d1a + d2a), cb = (n0b + n1b) / (1.0f + d1b + d2b);
+    const float aa = (m1a + m2a) / (1.0f + d1a + d2a), ab = (m1b + m2b) / (1.0f + d1b + d2b);
+    const bool zero = pad == Padding::ZERO;
+    float x1[L], x2[L], ya1[L], ya2[L], yb1[L], yb2[L];
+
+    for (int l = 0; l < L; ++l) {
+        const float u = zero ? 0.0f : src[l];
+        x1[l] = u;
+        ya1[l] = ya2[l] = u * ca;
+        yb1[l] = yb2[l] = u * cb;
+    }
+    for (int j = 0; j < n; ++j) {
+        const float* x = src + (size_t)j*pitch;
+        float* y = dst + (size_t)j*L;
+        for (int l = 0; l < L; ++l) {
+            const float a = n0a*x[l] + n1a*x1[l] - d1a*ya1[l] - d2a*ya2[l];
+            const float b = n0b*x[l] + n1b*x1[l] - d1b*yb1[l] - d2b*yb2[l];
+            ya2[l] = ya1[l]; ya1[l] = a;
+            yb2[l] = yb1[l]; yb1[l] = b;
+            x1[l] = x[l];
+            y[l] = a + b;
+        }
+    }
+
+    const float* last = src + (size_t)(n - 1)*pitch;
+    for (int l = 0; l < L; ++l) {
+        const float u = zero ? 0.0f : last[l];
+        x1[l] = x2[l] = u;
+        ya1[l] = ya2[l] = u * aa;
+        yb1[l] = yb2[l] = u * ab;
+    }
+    for (int j = n - 1; j >= 0; --j) {
+        const float* x = src + (size_t)j*pitch;
+        float* y = dst + (size_t)j*L;
+        for (int l = 0; l < L; ++l) {
+            const float a = m1a*x1[l] + m2a*x2[l] - d1a*ya1[l] - d2a*ya2[l];
+            const float b = m1b*x1[l] + m2b*x2[l] - d1b*yb1[l] - d2b*yb2[l];
+            ya2[l] = ya1[l]; ya1[l] = a;
+            yb2[l] = yb1[l]; yb1[l] = b;
+            x2[l] = x1[l]; x1[l] = x[l];
+            y[l] += a + b;
+        }
+    }
+}
+
+// The same recursions down `cols` columns of rows at src_pitch, a row at a
+// time: every row is read and written as a contiguous span, and the state
+// lives in small arrays that stay in L1.
+static inline __attribute__((always_inline)) void iir_columns_body(const DericheGauss& g, const float* src,
+                                                                 size_t src_pitch, int n, int cols, Padding pad,
+                                                                 float* dst, size_t dst_pitch) {
+    const float n0a = g.n0[0], n1a = g.n1[0], m1a = g.m1[0], m2a = g.m2[0], d1a = g.d1[0], d2a = g.d2[0];
+    const float n0b = g.n0[1], n1b = g.n1[1], m1b = g.m1[1], m2b = g.m2[1], d1b = g.d1[1], d2b = g.d2[1];
+    const float ca = (n0a + n1a) / (1.0f + d1a + d2a), cb = (n0b + n1b) / (1.0f + d1b + d2b);
+    const float aa = (m1a + m2a) / (1.0f + d1a + d2a), ab = (m1b + m2b) / (1.0f + d1b + d2b);
+    const bool zero = pad == Padding::ZERO;
+    alignas(64) float x1[kIirColumns], x2[kIirColumns];
+    alignas(64) float ya1[kIirColumns], ya2[kIirColumns], yb1[kIirColumns], yb2[kIirColumns];
+
+    for (int l = 0; l < cols; ++l) {
+        const float u = zero ? 0.0f : src[l];
+        x1[l] = u;
+        ya1[l] = ya2[l] = u * ca;
+        yb1[l] = yb2[l] = u * cb;
+    }
+    for (int j = 0; j < n; ++j) {
+        const float* x = src + (size_t)j*src_pitch;
+        float* y = dst + (size_t)j*dst_pitch;
+        for (int l = 0; l < cols; ++l) {
+            const float a = n0a*x[l] + n1a*x1[l] - d1a*ya1[l] - d2a*ya2[l];
+            const float b = n0b*x[l] + n1b*x1[l] - d1b*yb1[l] - d2b*yb2[l];
+            ya2[l] = ya1[l]; ya1[l] = a;
+            yb2[l] = yb1[l]; yb1[l] = b;
+            x1[l] = x[l];
+            y[l] = a + b;
+        }
+    }
+
+    const float* last = src + (size_t)(n - 1)*src_pitch;
+    for (int l = 0; l < cols; ++l) {
+        const float u = zero ? 0.0f : last[l];
+        x1[l] = x2[l] = u;
+        ya1[l] = ya2[l] = u * aa;
+        yb1[l] = yb2[l] = u * ab;
+    }
+    for (int j = n - 1; j >= 0; --j) {
+        const float* x = src + (size_t)j*src_pitch;
+        float* y = dst + (size_t)j*dst_pitch;
+        for (int l = 0; l < cols; ++l) {
+            const float a = m1a*x1[l] + m2a*x2[l] - d1a*ya1[l] - d2a*ya2[l];
+            const float b = m1b*x1[l] + m2b*x2[l] - d1b*yb1[l] - d2b*yb2[l];
+            ya2[l] = ya1[l]; ya1[l] = a;
+            yb2[l] = yb1[l]; yb1[l] = b;
+            x2[l] = x1[l]; x1[l] = x[l];
+            y[l] += a + b;
+        }
+    }
+}
+
+// Running sums: one add and one subtract per output, in double, which holds
+// sums of image samples exactly, so the result does not depend on where a
+// sweep started.
+template <int L>
+static inline __attribute__((always_inline)) void box_lanes_body(const float* src, int n, int r, int step,
+                                                               double scale, float* dst) {
+    double s[L] = {};
+    for (int k = 0; k <= 2*r; ++k)
+        for (int l = 0; l < L; ++l) s[l] += src[(size_t)k*L + l];
+    for (int i = 0; i < n; ++i) {
+        for (int l = 0; l < L; ++l) dst[(size_t)i*L + l] = (float)(s[l] * scale);
+        if (i + 1 == n) break;
+        for (int t = 0; t < step; ++t) {
+            const float* out = src + (size_t)(i*step + t)*L;
+            const float* in = out + (size_t)(2*r + 1)*L;
+            for (int l = 0; l < L; ++l) s[l] += (double)in[l] - (double)out[l];
+        }
+    }
+}
+
+static void iir_lanes_scalar(const DericheGauss& g, const float* src, size_t pitch, int n, Padding pad, float* dst) {
+    iir_lanes_body<kIirLanes>(g, src, pitch, n, pad, dst);
+}
+
+static void iir_columns_scalar(const DericheGauss& g, const float* src, size_t src_pitch, int n, int cols,
+                               Padding pad, float* dst, size_t dst_pitch) {
+    iir_columns_body(g, src, src_pitch, n, cols, pad, dst, dst_pitch);
+}
+
+static void box_lanes_scalar(const float* src, int n, int r, int step, double scale, float* dst) {
+    box_lanes_body<kIirLanes>(src, n, r, step, scale, dst);
+}
+
+#ifdef LUMINE_HAS_AVX2
+// The same recursions on two vectors of 8 lanes, interleaved so that four
+// independent chains hide the FMA latency. The feedback term of the
+// previous sample is added last: each step's chain is one FMA per section.
+LUMINE_TARGET_AVX2
+static void iir_lanes_avx2(const DericheGauss& g, const float* src, size_t pitch, int n, Padding pad, float* dst) {
+    static_assert(kIirLanes == 16, "two AVX vectors per step");
+    const __m256 n0a = _mm256_set1_ps(g.n0[0]), n1a = _mm256_set1_ps(g.n1[0]);
+    const __m256 n0b = _mm256_set1_ps(g.n0[1]), n1b = _mm256_set1_ps(g.n1[1]);
+    const __m256 m1a = _mm256_set1_ps(g.m1[0]), m2a = _mm256_set1_ps(g.m2[0]);
+    const __m256 m1b = _mm256_set1_ps(g.m1[1]), m2b = _mm256_set1_ps(g.m2[1]);
+    const __m256 d1a = _mm256_set1_ps(g.d1[0]), d2a = _mm256_set1_ps(g.d2[0]);
+    const __m256 d1b = _mm256_set1_ps(g.d1[1]), d2b = _mm256_set1_ps(g.d2[1]);
+    const __m256 ca = _mm256_set1_ps((g.n0[0] + g.n1[0]) / (1.0f + g.d1[0] + g.d2[0]));
+    const __m256 cb = _mm256_set1_ps((g.n0[1] + g.n1[1]) / (1.0f + g.d1[1] + g.d2[1]));
+    const __m256 aa = _mm256_set1_ps((g.m1[0] + g.m2[0]) / (1.0f + g.d1[0] + g.d2[0]));
+    const __m256 ab = _mm256_set1_ps((g.m1[1] + g.m2[1]) / (1.0f + g.d1[1] + g.d2[1]));
+    const bool zero = pad == Padding::ZERO;
+    __m256 x1[2], x2[2], ya1[2], ya2[2], yb1[2], yb2[2];
+
+    for (int h = 0; h < 2; ++h) {
+        const __m256 u = zero ? _mm256_setzero_ps() : _mm256_loadu_ps(src + 8*h);
+        x1[h] = u;
+        ya1[h] = ya2[h] = _mm256_mul_ps(u, ca);
+        yb1[h] = yb2[h] = _mm256_mul_ps(u, cb);
+    }
+    for (int j = 0; j < n; ++j) {
+        for (int h = 0; h < 2; ++h) {
+            const __m256 x = _mm256_loadu_ps(src + (size_t)j*pitch + 8*h);
+            __m256 a = _mm256_fmadd_ps(n1a, x1[h], _mm256_mul_ps(n0a, x));
+            __m256 b = _mm256_fmadd_ps(n1b, x1[h], _mm256_mul_ps(n0b, x));
+            a = _mm256_fnmadd_ps(d1a, ya1[h], _mm256_fnmadd_ps(d2a, ya2[h], a));
+            b = _mm256_fnmadd_ps(d1b, yb1[h], _mm256_fnmadd_ps(d2b, yb2[h], b));
+            ya2[h] = ya1[h]; ya1[h] = a;
+            yb2[h] = yb1[h]; yb1[h] = b;
+            x1[h] = x;
+            _mm256_storeu_ps(dst + (size_t)j*kIirLanes + 8*h, _mm256_add_ps(a, b));
+        }
+    }
+
+    for (int h = 0; h < 2; ++h) {
+        const __m256 u = zero ? _mm256_setzero_ps() : _mm256_loadu_ps(src + (size_t)(n - 1)*pitch + 8*h);
+        x1[h] = x2[h] = u;
+        ya1[h] = ya2[h] = _mm256_mul_ps(u, aa);
+        yb1[h] = yb2[h] = _mm256_mul_ps(u, ab);
+    }
+    for (int j = n - 1; j >= 0; --j) {
+        for (int h = 0; h < 2; ++h) {
+            __m256 a = _mm256_fmadd_ps(m2a, x2[h], _mm256_mul_ps(m1a, x1[h]));
+            __m256 b = _mm256_fmadd_ps(m2b, x2[h], _mm256_mul_ps(m1b, x1[h]));
+            a = _mm256_fnmadd_ps(d1a, ya1[h], _mm256_fnmadd_ps(d2a, ya2[h], a));
+            b = _mm256_fnmadd_ps(d1b, yb1[h], _mm256_fnmadd_ps(d2b, yb2[h], b));
+            ya2[h] = ya1[h]; ya1[h] = a;
+            yb2[h] = yb1[h]; yb1[h] = b;
+            x2[h] = x1[h];
+            x1[h] = _mm256_loadu_ps(src + (size_t)j*pitch + 8*h);
+            float* y = dst + (size_t)j*kIirLanes + 8*h;
+            _mm256_storeu_ps(y, _mm256_add_ps(_mm256_loadu_ps(y), _mm256_add_ps(a, b)));
+        }
+    }
+}
+
+LUMINE_TARGET_AVX2
+static void iir_columns_avx2(const DericheGauss& g, const float* src, size_t src_pitch, int n, int cols,
+                             Padding pad, float* dst, size_t dst_pitch) {
+    iir_columns_body(g, src, src_pitch, n, cols, pad, dst, dst_pitch);
+}
+
+// 16 floats as four vectors of doubles
+LUMINE_TARGET_AVX2 static inline void widen16(const float* p, __m256d* v) {
+    v[0] = _mm256_cvtps_pd(_mm_loadu_ps(p));
+    v[1] = _mm256_cvtps_pd(_mm_loadu_ps(p + 4));
+    v[2] = _mm256_cvtps_pd(_mm_loadu_ps(p + 8));
+    v[3] = _mm256_cvtps_pd(_mm_loadu_ps(p + 12));
+}
+
+LUMINE_TARGET_AVX2
+static void box_lanes_avx2(const float* src, int n, int r, int step, double scale, float* dst) {
+    static_assert(kIirLanes == 16, "four double vectors per step");
+    const __m256d sc = _mm256_set1_pd(scale);
+    __m256d s[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d v[4], w[4];
+    for (int k = 0; k <= 2*r; ++k) {
+        widen16(src + (size_t)k*kIirLanes, v);
+        for (int q = 0; q < 4; ++q) s[q] = _mm256_add_pd(s[q], v[q]);
+    }
+    for (int i = 0; i < n; ++i) {
+        float* d = dst + (size_t)i*kIirLanes;
+        for (int q = 0; q < 4; ++q) _mm_storeu_ps(d + 4*q, _mm256_cvtpd_ps(_mm256_mul_pd(s[q], sc)));
+        if (i + 1 == n) break;
+        for (int t = 0; t < step; ++t) {
+            const float* out = src + (size_t)(i*step + t)*kIirLanes;
+            widen16(out + (size_t)(2*r + 1)*kIirLanes, v);
+            widen16(out, w);
+            for (int q = 0; q < 4; ++q) s[q] = _mm256_add_pd(s[q], _mm256_sub_pd(v[q], w[q]));
+        }
+    }
+}
+#endif
+
+// ------------------------------------------------------------------ bits
+
+static int64_t popcount_scalar(const uint64_t* w, int n) {
+    int64_t total = 0;
+    for (int i = 0; i < n; ++i) total += __builtin_popcountll(w[i]);
+    return total;
+}
+
+static void threshold_bits_scalar(const float* src, int n, float threshold, uint64_t* bits) {
+    for (int x0 = 0; x0 < n; x0 += 64) {
+        const int m = std::min(64, n - x0);
+        uint64_t w = 0;
+        for (int i = 0; i < m; ++i) w |= (uint64_t)(src[x0 + i] > threshold) << i;
+        bits[x0 >> 6] = w;
+    }
+}
+
+#ifdef LUMINE_HAS_AVX2
+// Eight compares per movemask.
+LUMINE_TARGET_AVX2
+static void threshold_bits_avx2(const float* src, int n, float threshold, uint64_t* bits) {
+    const __m256 t = _mm256_set1_ps(threshold);
+    int x0 = 0;
+    for (; x0 + 64 <= n; x0 += 64) {
+        uint64_t w = 0;
+        for (int k = 0; k < 8; ++k)
+            w |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(src + x0 + 8*k), t, _CMP_GT_OQ))
+                 << (8*k);
+        bits[x0 >> 6] = w;
+    }
+    if (x0 < n) threshold_bits_scalar(src + x0, n - x0, threshold, bits + (x0 >> 6));
+}
+
+// Every AVX2 CPU has POPCNT; without the target the builtin is a libgcc call.
+__attribute__((target("avx2,fma,popcnt")))
+static int64_t popcount_avx2(const uint64_t* w, int n) {
+    int64_t total = 0;
+    for (int i = 0; i < n; ++i) total += __builtin_popcountll(w[i]);
+    return total;
+}
+#endif
+
+// ------------------------------------------------------------- resample
+
+// Coordinates are never negative here, so truncation is floor.
+static void bilinear_row_scalar(const float* src, size_t stride, float x, float y, float dx, float dy, float* dst,
+                                int n) {
+    for (int i = 0; i < n; ++i) {
+        const float sx = x + dx * (float)i, sy = y + dy * (float)i;
+        const int ix = (int)sx, iy = (int)sy;
+        const float fx = sx - (float)ix, fy = sy - (float)iy;
+        const float* p = src + (size_t)iy * stride + ix;
+        const float top = p[0] + fx * (p[1] - p[0]);
+        const float bottom = p[stride] + fx * (p[stride + 1] - p[stride]);
+        dst[i] = top + fy * (bottom - top);
+    }
+}
+
+#ifdef LUMINE_HAS_AVX2
+// Eight samples per step. Where the eight step one column apart and span
+// at most one row crossing (all but a few at deskew angles) the taps are
+// unaligned loads of the input rows involved, blended per lane; elsewhere
+// four gathers. Offsets are 32-bit: the caller
+// keeps every tap within 2^31 floats of `src`.
+LUMINE_TARGET_AVX2
+static void bilinear_row_avx2(const float* src, size_t stride, float x, float y, float dx, float dy, float* dst,
+                              int n) {
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy);
+    const __m256i vstride = _mm256_set1_epi32((int)stride), one = _mm256_set1_epi32(1);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 fi = _mm256_add_ps(_mm256_set1_ps((float)i), lane);
+        const __m256 sx = _mm256_fmadd_ps(vdx, fi, _mm256_set1_ps(x));
+        const __m256 sy = _mm256_fmadd_ps(vdy, fi, _mm256_set1_ps(y));
+        const __m256i ix = _mm256_cvttps_epi32(sx), iy = _mm256_cvttps_epi32(sy);
+        const __m256 fx = _mm256_sub_ps(sx, _mm256_cvtepi32_ps(ix));
+        const __m256 fy = _mm256_sub_ps(sy, _mm256_cvtepi32_ps(iy));
+        __m256 p00, p01, p10, p11;
+        const int ix0 = _mm256_cvtsi256_si32(ix), iy0 = _mm256_cvtsi256_si32(iy);
+        const int iy7 = _mm256_extract_epi32(iy, 7);
+        if (_mm256_extract_epi32(ix, 7) == ix0 + 7 && iy7 - iy0 <= 1 && iy0 - iy7 <= 1) {
+            // the lanes read rows lo, lo + 1 and, past a row crossing,
+            // lo + 2 (selected without a branch: crossings are irregular)
+            const int lo = std::min(iy0, iy7);
+            const float* p = src + (size_t)lo * stride + ix0;
+            const float* q = p + (iy7 != iy0 ? 2 : 1) * stride;
+            const __m256 upper = _mm256_castsi256_ps(_mm256_cmpeq_epi32(iy, _mm256_set1_epi32(lo)));
+            const __m256 r1 = _mm256_loadu_ps(p + stride), r1n = _mm256_loadu_ps(p + stride + 1);
+            p00 = _mm256_blendv_ps(r1, _mm256_loadu_ps(p), upper);
+            p01 = _mm256_blendv_ps(r1n, _mm256_loadu_ps(p + 1), upper);
+            p10 = _mm256_blendv_ps(_mm256_loadu_ps(q), r1, upper);
+            p11 = _mm256_blendv_ps(_mm256_loadu_ps(q + 1), r1n, upper);
+        } else {
+            const __m256i at = _mm256_add_epi32(_mm256_mullo_epi32(iy, vstride), ix);
+            const __m256i below = _mm256_add_epi32(at, vstride);
+            p00 = _mm256_i32gather_ps(src, at, 4);
+            p01 = _mm256_i32gather_ps(src, _mm256_add_epi32(at, one), 4);
+            p10 = _mm256_i32gather_ps(src, below, 4);
+            p11 = _mm256_i32gather_ps(src, _mm256_add_epi32(below, one), 4);
+        }
+        const __m256 top = _mm256_fmadd_ps(fx, _mm256_sub_ps(p01, p00), p00);
+        const __m256 bottom = _mm256_fmadd_ps(fx, _mm256_sub_ps(p11, p10), p10);
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(fy, _mm256_sub_ps(bottom, top), top));
+    }
+    bilinear_row_scalar(src, stride, x + dx * (float)i, y + dy * (float)i, dx, dy, dst + i, n - i);
+}
+#endif
+
+// -------------------------------------------------------------- dispatch
+
+static bool cpu_has_avx2() {
+#ifdef LUMINE_HAS_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("popcnt");
+#else
+    return false;
+#endif
+}
+
+const ConvKernels& conv_kernels(Isa isa) {
+    static const ConvKernels scalar{Isa::Scalar, fir_row_scalar, fir_cols_scalar, fir_row_q_scalar, fir_cols_q_scalar,
+                                    bank_row_scalar, iir_lanes_scalar, iir_columns_scalar, box_lanes_scalar,
+                                    popcount_scalar, threshold_bits_scalar, bilinear_row_scalar};
+#ifdef LUMINE_HAS_SSE2
+    static const ConvKernels sse2{Isa::SSE2, fir_row_sse2, fir_cols_sse2, fir_row_q_scalar, fir_cols_q_scalar,
+                                  bank_row_scalar, iir_lanes_scalar, iir_columns_scalar, box_lanes_scalar,
+                                  popcount_scalar, threshold_bits_scalar, bilinear_row_scalar};
+#endif
+#ifdef LUMINE_HAS_AVX2
+    static const ConvKernels avx2{Isa::AVX2, fir_row_avx2, fir_cols_avx2, fir_row_q_avx2, fir_cols_q_avx2,
+                                  bank_row_avx2, iir_lanes_avx2, iir_columns_avx2, box_lanes_avx2,
+                                  popcount_avx2, threshold_bits_avx2, bilinear_row_avx2};
+    static const bool has_avx2 = cpu_has_avx2();
+    if (isa == Isa::AVX2 && has_avx2) return avx2;
+#endif
+#ifdef LUMINE_HAS_SSE2
+    if (isa != Isa::Scalar) return sse2;
+#endif
+    return scalar;
+}
+
+const ConvKernels& conv_kernels() {
+    static const ConvKernels& best = conv_kernels(Isa::AVX2);
+    return best;
+}
+
+// ---------------------------------------------------------------- border
+
+static inline float tap(const float* src, int width, int x, Padding pad) {
+    if (x < 0) return pad == Padding::ZERO ? 0.0f : src[0];
+    if (x >= width) return pad == Padding::ZERO ? 0.0f : src[width - 1];
+    return src[x];
+}
+
+void fir_row_padded(const ConvKernels& kern, const float* src, int width, int step, int pad_x,
+                    const float* w, int kw, Padding pad, float* dst, int out_w, bool accumulate) {
+    // interior: every tap of outputs [lo, hi) lands inside [0, width)
+    const int last = width - kw + pad_x; // largest valid ox*step
+    int lo = std::min(out_w, (pad_x + step - 1) / step);
+    int hi = last < 0 ? lo : std::clamp(last / step + 1, lo, out_w);
+
+    auto border = [&](int ox) {
+        const int ix = ox*step - pad_x;
+        float acc = accumulate ? dst[ox] : 0.0f;
+        for (int k = 0; k < kw; ++k) acc += tap(src, width, ix + k, pad) * w[k];
+        dst[ox] = acc;
+    };
+    for (int ox = 0; ox < lo; ++ox) border(ox);
+    if (hi > lo)
+        kern.fir_row(src + (size_t)lo*step - pad_x, step, w, kw, dst + lo, hi - lo, accumulate);
+    for (int ox = hi; ox < out_w; ++ox) border(ox);
+}
+
+void fir_row_q_padded(const ConvKernels& kern, const uint8_t* src, int width, int step, int pad_x,
+                      const int32_t* w, int kw, Padding pad, int32_t* dst, int out_w) {
+    const int last = width - kw + pad_x;
+    int lo = std::min(out_w, (pad_x + step - 1) / step);
+    int hi = last < 0 ? lo : std::clamp(last / step + 1, lo, out_w);
+
+    auto border = [&](int ox) {
+        const int ix = ox*step - pad_x;
+        int32_t acc = dst[ox];
+        for (int k = 0; k < kw; ++k) {
+            const int x = ix + k;
+            if (x >= 0 && x < width) acc += src[x] * w[k];
+            else if (pad == Padding::EDGE) acc += src[x < 0 ? 0 : width - 1] * w[k];
+        }
+        dst[ox] = acc;
+    };
+    for (int ox = 0; ox < lo; ++ox) border(ox);
+    if (hi > lo)
+        kern.fir_row_q(src + (size_t)lo*step - pad_x, step, w, kw, dst + lo, hi - lo);
+    for (int ox = hi; ox < out_w; ++ox) border(ox);
+}
+
+// --------------------------------------------------------- fixed kernels
+
+// Builtins as compile-time data: integer weights w and one final scale.
+// Separable ones also carry their 1D factors (w = ky (x) kx) and run as a
+// vertical pass followed by a horizontal one, KW + KH taps per pixel.
+template <int KW, int KH>
+struct FixedKernel {
+    static constexpr int kw = KW, kh = KH;
+    float w[KH][KW]{};
+    float scale{1.0f};
+    bool separable{false};
+    float kx[KW]{}, ky[KH]{};
+};
+
+template <int KW, int KH>
+static constexpr FixedKernel<KW, KH> fixed_separable(const float (&kx)[KW], const float (&ky)[KH], float scale) {
+    FixedKernel<KW, KH> k;
+    for (int j = 0; j < KH; ++j)
+        for (int i = 0; i < KW; ++i) k.w[j][i] = ky[j] * kx[i];
+    for (int i = 0; i < KW; ++i) k.kx[i] = kx[i];
+    for (int j = 0; j < KH; ++j) k.ky[j] = ky[j];
+    k.scale = scale;
+    k.separable = true;
+    return k;
+}
+
+static constexpr float kOnes3[] = {1, 1, 1};
+static constexpr float kOnes5[] = {1, 1, 1, 1, 1};
+static constexpr float kBinomial5[] = {1, 4, 6, 4, 1};
+static constexpr float kSmooth3[] = {1, 2, 1};
+static constexpr float kDiff3[] = {-1, 0, 1};
+static constexpr float kUnit3[] = {0, 1, 0};
+
+static constexpr auto kFixedIdentity = fixed_separable(kUnit3, kUnit3, 1.0f);
+static constexpr auto kFixedBox3 = fixed_separable(kOnes3, kOnes3, 1.0f / 9.0f);
+static constexpr auto kFixedBox5 = fixed_separable(kOnes5, kOnes5, 1.0f / 25.0f);
+static constexpr auto kFixedGauss5 = fixed_separable(kBinomial5, kBinomial5, 1.0f / 256.0f);
+static constexpr auto kFixedSobelX = fixed_separable(kDiff3, kSmooth3, 1.0f);
+static constexpr auto kFixedSobelY = fixed_separable(kSmooth3, kDiff3, 1.0f);
+static constexpr FixedKernel<3, 3> kFixedSharpen{{{0, -1, 0}, {-1, 5, -1}, {0, -1, 0}}, 1.0f, false, {}, {}};
+
+// Nonzero taps of a weight table, as compile-time (index, weight) lists.
+struct Tap1 { int i; float w; };
+struct Tap2 { int j, i; float w; };
+
+template <const auto& FK>
+struct FixedTaps {
+    static constexpr int KW = std::decay_t<decltype(FK)>::kw;
+    static constexpr int KH = std::decay_t<decltype(FK)>::kh;
+
+    static constexpr int count(const float* w, int n) {
+        int c = 0;
+        for (int i = 0; i < n; ++i) c += w[i] != 0.0f;
+        return c;
+    }
+    template <int N>
+    static constexpr std::array<Tap1, N> taps1(const float* w, int n) {
+        std::array<Tap1, N> t{};
+        for (int i = 0, c = 0; i < n; ++i) if (w[i] != 0.0f) t[c++] = Tap1{i, w[i]};
+        return t;
+    }
+    static constexpr int count2() {
+        int c = 0;
+        for (int j = 0; j < KH; ++j) c += count(FK.w[j], KW);
+        return c;
+    }
+    static constexpr std::array<Tap2, count2()> taps2() {
+        std::array<Tap2, count2()> t{};
+        int c = 0;
+        for (int j = 0; j < KH; ++j)
+            for (int i = 0; i < KW; ++i) if (FK.w[j][i] != 0.0f) t[c++] = Tap2{j, i, FK.w[j][i]};
+        return t;
+    }
+
+    static constexpr auto x = taps1<count(FK.kx, KW)>(FK.kx, KW);
+    static constexpr auto y = taps1<count(FK.ky, KH)>(FK.ky, KH);
+    static constexpr auto xy = taps2();
+};
+
+// Sum over compile-time taps, one term per nonzero weight. The weights are
+// constants, so +-1 taps cost no multiply.
+template <const auto& T, typename F, size_t... I>
+static inline __attribute__((always_inline)) float tap_sum(F&& term, std::index_sequence<I...>) {
+    return (term(T[I]) + ...);
+}
+
+template <const auto& FK>
+static inline __attribute__((always_inline)) void fixed_row_body(const float* const* rows, int width, Padding pad,
+                                                                 float* dst, float* scratch) {
+    using Taps = FixedTaps<FK>;
+    constexpr int KW = Taps::KW, KH = Taps::KH;
+    constexpr int pad_x = KW/2;
+    constexpr float scale = FK.scale;
+    const float* r[KH];
+    for (int j = 0; j < KH; ++j) r[j] = rows[j];
+
+    if constexpr (FK.separable) {
+        // vertical pass into a padded line, then horizontal over it
+        float* t = scratch + pad_x;
+        for (int x = 0; x < width; ++x)
+            t[x] = tap_sum<Taps::y>([&](Tap1 k) { return k.w * r[k.i][x]; }, std::make_index_sequence<Taps::y.size()>{});
+        for (int i = 1; i <= pad_x; ++i) {
+            t[-i] = pad == Padding::EDGE ? t[0] : 0.0f;
+            t[width - 1 + i] = pad == Padding::EDGE ? t[width - 1] : 0.0f;
+        }
+        for (int x = 0; x < width; ++x)
+            dst[x] = scale * tap_sum<Taps::x>([&](Tap1 k) { return k.w * scratch[x + k.i]; },
+                                             std::make_index_sequence<Taps::x.size()>{});
+    } else {
+        const int lo = std::min(pad_x, width), hi = std::max(lo, width - (KW - 1 - pad_x));
+        auto border = [&](int x) {
+            float acc = 0.0f;
+            for (const Tap2& k : Taps::xy) acc += k.w * tap(r[k.j], width, x - pad_x + k.i, pad);
+            dst[x] = scale * acc;
+        };
+        for (int x = 0; x < lo; ++x) border(x);
+        for (int x = lo; x < hi; ++x)
+            dst[x] = scale * tap_sum<Taps::xy>([&](Tap2 k) { return k.w * r[k.j][x - pad_x + k.i]; },
+                                              std::make_index_sequence<Taps::xy.size()>{});
+        for (int x = hi; x < width; ++x) border(x);
+    }
+}
+
+template <const auto& FK>
+static void fixed_row(const float* const* rows, int width, Padding pad, float* dst, float* scratch) {
+    fixed_row_body<FK>(rows, width, pad, dst, scratch);
+}
+
+#ifdef LUMINE_HAS_AVX2
+template <const auto& FK>
+LUMINE_TARGET_AVX2 static void fixed_row_avx2(const float* const* rows, int width, Padding pad, float* dst, float* scratch) {
+    fixed_row_body<FK>(rows, width, pad, dst, scratch);
+}
+#endif
+
+template <const auto& FK>
+static bool weights_match(const float* weights, int kw, int kh) {
+    if (kw != FK.kw || kh != FK.kh) return false;
+    for (int j = 0; j < kh; ++j)
+        for (int i = 0; i < kw; ++i)
+            if (weights[(size_t)j*kw + i] != FK.w[j][i] * FK.scale) return false;
+    return true;
+}
+
+const FixedConv* match_fixed(const float* weights, int kw, int kh) {
+    struct Entry { bool (*match)(const float*, int, int); FixedConv plain, avx2; };
+#ifdef LUMINE_HAS_AVX2
+#define LUMINE_FIXED(name, FK) Entry{weights_match<FK>, {name, FK.kw, FK.kh, fixed_row<FK>}, {name, FK.kw, FK.kh, fixed_row_avx2<FK>}}
+#else
+#define LUMINE_FIXED(name, FK) Entry{weights_match<FK>, {name, FK.kw, FK.kh, fixed_row<FK>}, {name, FK.kw, FK.kh, fixed_row<FK>}}
+#endif
+    static const Entry table[] = {
+        LUMINE_FIXED("identity", kFixedIdentity),
+        LUMINE_FIXED("box3", kFixedBox3),
+        LUMINE_FIXED("box5", kFixedBox5),
+        LUMINE_FIXED("gauss5", kFixedGauss5),
+        LUMINE_FIXED("sobel_x", kFixedSobelX),
+        LUMINE_FIXED("sobel_y", kFixedSobelY),
+        LUMINE_FIXED("sharpen", kFixedSharpen),
+    };
+#undef LUMINE_FIXED
+    const bool avx2 = conv_kernels().isa == Isa::AVX2;
+    for (const Entry& e : table)
+        if (e.match(weights, kw, kh)) return avx2 ? &e.avx2 : &e.plain;
+    return nullptr;
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include "lumine/types.hpp"
+
+// Internal row kernels behind Convolver. The hot loops only ever see plain
+// row pointers that are known to be in bounds; padding is resolved by the
+// callers (scalar border columns, clamped or zero row pointers), so the
+// bodies here are branch-free and vectorize.
+namespace lumine::detail {
+
+enum class Isa { Scalar, SSE2, AVX2 };
+
+// What bank_row writes for the responses r_0..r_{nk-1} of one pixel.
+enum class BankOut { Each, Magnitude, Orientation, Max };
+// Most kernels one bank_row call evaluates; larger banks run in groups.
+constexpr int kMaxBankKernels = 8;
+
+// Signals the recursive-filter kernels run side by side: sample j of lane l
+// is at [j*pitch + l], so a sweep along j is a SIMD loop over the lanes.
+constexpr int kIirLanes = 16;
+// Most columns one iir_columns call filters.
+constexpr int kIirColumns = 1024;
+
+// Deriche's 4th-order recursive Gaussian, split into two second-order
+// sections k. Each has a causal part
+//   y[j] = n0 x[j] + n1 x[j-1] - d1 y[j-1] - d2 y[j-2]
+// and an anticausal part
+//   y[j] = m1 x[j+1] + m2 x[j+2] - d1 y[j+1] - d2 y[j+2];
+// the filter output is the sum of all four. Sections keep float rounding
+// small where a direct 4th-order form loses digits at large sigma.
+struct DericheGauss {
+    float n0[2], n1[2], m1[2], m2[2], d1[2], d2[2];
+};
+// Coefficients for `sigma`, normalized to unit DC gain.
+DericheGauss deriche_gauss(double sigma);
+
+struct ConvKernels {
+    Isa isa;
+    // dst[i] (+)= sum_k src[i*step + k] * w[k],  i in [0, n)
+    void (*fir_row)(const float* src, int step, const float* w, int kw, float* dst, int n, bool accumulate);
+    // dst[i] = sum_k rows[k][i] * w[k],  i in [0, n)
+    void (*fir_cols)(const float* const* rows, const float* w, int kh, float* dst, int n);
+    // Fixed point for 8-bit images: dst[i] += sum_k src[i*step + k] * w[k]
+    void (*fir_row_q)(const uint8_t* src, int step, const int32_t* w, int kw, int32_t* dst, int n);
+    // dst[i] = sum_k rows[k][i] * w[k] on fixed-point intermediates
+    void (*fir_cols_q)(const int32_t* const* rows, const int32_t* w, int kh, int32_t* dst, int n);
+    // Filter bank: r_k[i] = sum_t taps[t][i*step] * w[t*nk + k], k < nk <= kMaxBankKernels;
+    // each sample is loaded once for all kernels. Each: dst[k][i] = r_k[i];
+    // Magnitude: dst[0][i] = sqrt(sum_k r_k^2); Orientation (nk == 2):
+    // dst[0][i] = atan2(r_1, r_0) to ~5e-7 rad; Max: dst[0][i] = max_k r_k.
+    void (*bank_row)(const float* const* taps, int ntaps, int step, const float* w, int nk,
+                     BankOut out, float* const* dst, int n);
+    // Recursive Gaussian along n samples of kIirLanes signals src[j*pitch + l];
+    // the signals continue past both ends as `pad` says (constant or zero).
+    // dst receives n x kIirLanes samples, contiguous.
+    void (*iir_lanes)(const DericheGauss& g, const float* src, size_t pitch, int n, Padding pad, float* dst);
+    // The same down cols <= kIirColumns columns: sample j of column l is
+    // src[j*src_pitch + l] and dst[j*dst_pitch + l].
+    void (*iir_columns)(const DericheGauss& g, const float* src, size_t src_pitch, int n, int cols, Padding pad,
+                        float* dst, size_t dst_pitch);
+    // Box sums over kIirLanes contiguous signals whose padding is already in
+    // place: dst[i*L + l] = scale * sum_{k <= 2r} src[(i*step + k)*L + l],
+    // i in [0, n), summed in double.
+    void (*box_lanes)(const float* src, int n, int r, int step, double scale, float* dst);
+    // Set bits in w[0, n) (BinaryImage rows).
+    int64_t (*popcount)(const uint64_t* w, int n);
+    // Bit i of bits[] = src[i] > threshold, i in [0, n); (n + 63) / 64 words,
+    // bits past n clear.
+    void (*threshold_bits)(const float* src, int n, float threshold, uint64_t* bits);
+    // Bilinear samples along a line: dst[i] = src sampled at (x + dx*i,
+    // y + dy*i), i in [0, n), src rows `stride` floats apart. Every tap must
+    // be inside: 0 <= x, y and floor(x) + 1, floor(y) + 1 within the image,
+    // and (floor(y) + 1) * stride + floor(x) + 1 below 2^31.
+    void (*bilinear_row)(const float* src, size_t stride, float x, float y, float dx, float dy, float* dst, int n);
+};
+
+// Best implementation for the running CPU, detected once.
+const ConvKernels& conv_kernels();
+// A specific implementation; falls back to the best supported one below it.
+const ConvKernels& conv_kernels(Isa isa);
+
+// Horizontal FIR over one row of `width` samples with padding: output ox
+// reads src[ox*step - pad_x + k]. Interior outputs go through fir_row, the
+// few border outputs through a scalar loop.
+void fir_row_padded(const ConvKernels& kern, const float* src, int width, int step, int pad_x,
+                    const float* w, int kw, Padding pad, float* dst, int out_w, bool accumulate);
+
+// fir_row_padded for 8-bit rows and fixed-point weights; always accumulates.
+void fir_row_q_padded(const ConvKernels& kern, const uint8_t* src, int width, int step, int pad_x,
+                      const int32_t* w, int kw, Padding pad, int32_t* dst, int out_w);
+
+// A builtin kernel specialized at compile time (stride 1): weights, zero
+// taps and the final scale are constants, so the row body fully unrolls.
+struct FixedConv {
+    const char* name;
+    int kw, kh;
+    // One output row of `width` pixels. rows[j] is input row oy - kh/2 + j
+    // with vertical padding already resolved; scratch holds width + kw floats.
+    void (*row)(const float* const* rows, int width, Padding pad, float* dst, float* scratch);
+};
+
+// Specialization whose weights equal `weights` (kh x kw, row-major)
+// exactly, for the running CPU; nullptr if there is none.
+const FixedConv* match_fixed(const float* weights, int kw, int kh);
+
+}
@@ -0,0 +1,237 @@
+#include "lumine/conv_plan.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "row_ops.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace lumine {
+
+namespace {
+
+constexpr const char* kWisdomHeader = "lumine-wisdom 1";
+
+struct Choice { ConvAlgo algo{ConvAlgo::Direct}; int band{0}; int fft_size{0}; };
+
+// Wisdom key: kernel fingerprint plus everything else the choice depends on.
+std::string wisdom_key(const Kernel& K, int width, int height, int channels, const ConvParams& params) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a over the weight bits
+    for (float w : K.weights()) {
+        uint32_t bits;
+        std::memcpy(&bits, &w, sizeof bits);
+        for (int i = 0; i < 4; ++i) { h ^= (bits >> (8*i)) & 0xff; h *= 1099511628211ull; }
+    }
+    // gauss:/box: can also run Recursive, unlike the same weights as a custom kernel
+    if (K.blur().kind != BlurShape::Kind::None) { h ^= (uint64_t)K.blur().kind; h *= 1099511628211ull; }
+    std::ostringstream os;
+    os << std::hex << h << std::dec << ' ' << K.width() << ' ' << K.height() << ' '
+       << width << ' ' << height << ' ' << channels << ' ' << std::max(1, params.stride) << ' '
+       << (int)params.padding << ' ' << (int)params.algo << ' ' << params.rank_tolerance << ' '
+       << ThreadPool::resolve(params.threads);
+    return os.str();
+}
+
+constexpr int kKeyFields = 11;
+
+std::mutex& wisdom_mutex() { static std::mutex m; return m; }
+std::map<std::string, Choice>& wisdom() { static std::map<std::string, Choice> w; return w; }
+
+bool find_wisdom(const std::string& key, Choice& out) {
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    auto it = wisdom().find(key);
+    if (it == wisdom().end()) return false;
+    out = it->second;
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Times the strategies the cost model does not rule out (within 4x of the
+// cheapest estimate) on a synthetic input, best of two runs each.
+Choice measure(const Kernel& K, int width, int height, int channels, const ConvParams& params) {
+    LUMINE_TRACE_SCOPE("conv.measure", "width", width, "height", height);
+    constexpr double kPrune = 4.0;
+    const int stride = std::max(1, params.stride);
+    const Size out = detail::conv_output_size(width, height, K, stride);
+
+    std::vector<Choice> candidates;
+    for (ConvAlgo algo : {ConvAlgo::Direct, ConvAlgo::Separable, ConvAlgo::FFT, ConvAlgo::Recursive}) {
+        if (params.algo != ConvAlgo::Auto && params.algo != algo) continue;
+        if (algo == ConvAlgo::Recursive) {
+            if (detail::conv_cost(K, width, height, stride, algo, params.rank_tolerance) < std::numeric_limits<double>::infinity())
+                candidates.push_back(Choice{algo, 0, 0});
+        } else if (algo == ConvAlgo::FFT) {
+            for (int n = 16; n <= 512; n <<= 1)
+                if (detail::conv_cost(K, width, height, stride, algo, params.rank_tolerance, n) < std::numeric_limits<double>::infinity())
+                    candidates.push_back(Choice{algo, 0, n});
+        } else {
+            const int band = detail::make_conv_setup(K, width, height, params.padding, stride, algo, params.rank_tolerance).band;
+            for (int b : {band / 2, band, band * 2})
+                if (b >= 1 && b <= std::max(1, out.height)) candidates.push_back(Choice{algo, b, 0});
+        }
+    }
+    double cheapest = std::numeric_limits<double>::infinity();
+    for (const Choice& c : candidates)
+        cheapest = std::min(cheapest, detail::conv_cost(K, width, height, stride, c.algo, params.rank_tolerance, c.fft_size));
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const Choice& c) {
+        return detail::conv_cost(K, width, height, stride, c.algo, params.rank_tolerance, c.fft_size) > kPrune * cheapest;
+    }), candidates.end());
+    if (candidates.empty()) return Choice{};
+
+    Image input(width, height, channels, Fill::None);
+    uint32_t state = 12345u;
+    for (int c = 0; c < channels; ++c)
+        for (int y = 0; y < height; ++y) {
+            float* px = input.row(y, c);
+            for (int x = 0; x < width; ++x) {
+                state = state * 1664525u + 1013904223u;
+                px[x] = (float)(state >> 8) * (1.0f / 16777216.0f);
+            }
+        }
+    Image output(out.width, out.height, channels, Fill::None);
+
+    Choice best = candidates.front();
+    double best_time = std::numeric_limits<double>::infinity();
+    for (const Choice& c : candidates) {
+        const detail::ConvSetup S = detail::make_conv_setup(K, width, height, params.padding, stride,
+                                                            c.algo, params.rank_tolerance, c.band, c.fft_size);
+        double t = std::numeric_limits<double>::infinity();
+        for (int rep = 0; rep < 2; ++rep) {
+            const auto t0 = std::chrono::steady_clock::now();
+            detail::convolve_rows(S, detail::Strip::whole(input), detail::RowSink{output, 0}, 0, out.height, params.threads);
+            t = std::min(t, seconds_since(t0));
+        }
+        if (t < best_time) { best_time = t; best = Choice{S.algo, S.band, S.fft_size}; }
+    }
+    return best;
+}
+
+}
+
+ConvPlan::ConvPlan(const Kernel& kernel, int width, int height, int channels,
+                   const ConvParams& params, Tuning tuning)
+    : m_params(params), m_width(width), m_height(height), m_channels(channels) {
+    LUMINE_TRACE_SCOPE("conv.plan", "kernel_width", kernel.width(), "kernel_height", kernel.height());
+    if (width <= 0 || height <= 0 || channels <= 0)
+        throw std::runtime_error("ConvPlan needs a non-empty input shape");
+    m_params.stride = std::max(1, params.stride);
+
+    const std::string key = wisdom_key(kernel, width, height, channels, m_params);
+    Choice choice{m_params.algo, 0, 0};
+    if (!find_wisdom(key, choice) && tuning == Tuning::Measure) {
+        choice = measure(kernel, width, height, channels, m_params);
+        std::lock_guard<std::mutex> lock(wisdom_mutex());
+        wisdom()[key] = choice;
+    }
+    m_setup = std::make_shared<const detail::ConvSetup>(detail::make_conv_setup(
+        kernel, width, height, m_params.padding, m_params.stride, choice.algo, m_params.rank_tolerance,
+        choice.band, choice.fft_size));
+#if LUMINE_TRACE
+    if (trace::active()) {
+        const detail::ConvSetup& S = *m_setup;
+        std::string algo = S.algo == ConvAlgo::FFT ? "fft " + std::to_string(S.fft_size)
+                         : S.algo == ConvAlgo::Separable ? "separable x" + std::to_string(S.terms.size())
+                         : S.algo == ConvAlgo::Recursive ? (S.whole_columns ? "recursive gaussian" : "recursive box")
+                         : "direct";
+        if (S.fixed) algo += " (builtin)";
+        trace::note("conv.algo", algo);
+    }
+#endif
+}
+
+Image ConvPlan::execute(ConstImageView input) const {
+    const Size size = output_size();
+    Image out(size.width, size.height, m_channels, Fill::None);
+    execute(input, out);
+    return out;
+}
+
+void ConvPlan::execute(ConstImageView input, ImageView output) const {
+    if (input.width() != m_width || input.height() != m_height || input.channels() != m_channels)
+        throw std::runtime_error("ConvPlan::execute: input shape does not match the plan");
+    const Size size = output_size();
+    if (output.width() != size.width || output.height() != size.height || output.channels() != m_channels)
+        throw std::runtime_error("ConvPlan::execute: output view has the wrong shape");
+    LUMINE_TRACE_SCOPE("convolve", "width", m_width, "height", m_height);
+    LUMINE_TRACE_COUNT("pixels.convolved", (double)m_width * m_height * m_channels);
+    const Kernel& K = m_setup->kernel;
+    detail::run_roi(input, output, detail::conv_reach(K, m_params.stride), m_params.padding,
+                    [&](int w) { return detail::conv_output_size(w, 1, K, m_params.stride).width; },
+                    [&](ConstImageView src, ImageView dst, int a, int b) {
+        detail::convolve_rows(*m_setup, detail::Strip::whole(src), detail::RowSink{dst, a}, a, b, m_params.threads);
+    });
+
+    // Visualization post-processing
+    detail::apply_viz(output, m_params.viz, m_params.threads);
+}
+
+Size ConvPlan::output_size() const {
+    return detail::conv_output_size(m_width, m_height, m_setup->kernel, m_params.stride);
+}
+
+ConvAlgo ConvPlan::algorithm() const { return m_setup->algo; }
+int ConvPlan::band_rows() const { return m_setup->algo == ConvAlgo::FFT ? 0 : m_setup->band; }
+int ConvPlan::fft_size() const { return m_setup->fft_size; }
+
+void ConvPlan::save_wisdom(const std::string& path) {
+    std::ofstream f(path);
+    if (!f) throw std::runtime_error("Failed to write wisdom: " + path);
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    f << kWisdomHeader << "\n";
+    for (const auto& [key, c] : wisdom())
+        f << key << ' ' << (int)c.algo << ' ' << c.band << ' ' << c.fft_size << "\n";
+    if (!f) throw std::runtime_error("Failed to write wisdom: " + path);
+}
+
+bool ConvPlan::load_wisdom(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::string line;
+    if (!std::getline(f, line) || line != kWisdomHeader)
+        throw std::runtime_error("Not a wisdom file: " + path);
+
+    std::map<std::string, Choice> loaded;
+    while (std::getline(f, line)) {
+        if (line.empty()) continue;
+        std::istringstream is(line);
+        std::vector<std::string> fields;
+        for (std::string tok; is >> tok;) fields.push_back(tok);
+        if ((int)fields.size() != kKeyFields + 3) throw std::runtime_error("Malformed wisdom line: " + line);
+        std::string key = fields[0];
+        for (int i = 1; i < kKeyFields; ++i) key += ' ' + fields[i];
+        Choice c;
+        int algo = 0;
+        try {
+            algo = std::stoi(fields[kKeyFields]);
+            c.band = std::stoi(fields[kKeyFields + 1]);
+            c.fft_size = std::stoi(fields[kKeyFields + 2]);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Malformed wisdom line: " + line);
+        }
+        if (algo < (int)ConvAlgo::Direct || algo > (int)ConvAlgo::Recursive || c.band < 0 || c.fft_size < 0)
+            throw std::runtime_error("Malformed wisdom line: " + line);
+        c.algo = (ConvAlgo)algo;
+        loaded[key] = c;
+    }
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    for (auto& [key, c] : loaded) wisdom()[key] = c;
+    return true;
+}
+
+void ConvPlan::forget_wisdom() {
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    wisdom().clear();
+}
+
+}
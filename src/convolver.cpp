@@ -1,140 +1,883 @@
 #include "lumine/convolver.hpp"
+#include "lumine/conv_plan.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "conv_kernels.hpp"
+#include "fft.hpp"
+#include "row_ops.hpp"
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <limits>
+#include <stdexcept>
 
 namespace lumine {
 
+namespace detail {
+
     static int div_up(int a, int b) { return (a + b - 1) / b; }
 
-    float Convolver::sample(const Image& img, int x, int y, int c, Padding pad) {
-        if (x >= 0 && x < img.width() && y >= 0 && y < img.height())
-            return img.at(x, y, c);
-        if (pad == Padding::ZERO)
-            return 0.0f;
-        x = std::min(std::max(x, 0), img.width() - 1);
-        y = std::min(std::max(y, 0), img.height() - 1);
-        return img.at(x, y, c);
+    // Rows per work item: enough output rows to fill ~64 KiB, so a band and
+    // the input rows it reads stay resident in L2 while one thread owns it.
+    static int band_rows(int out_w) {
+        constexpr int kBandFloats = 64 * 1024 / (int)sizeof(float);
+        return std::max(1, kBandFloats / std::max(1, out_w));
     }
 
-    Image Convolver::convolve_horizontal(const Image& input, const std::vector<float>& kx, Padding pad, int stride_x) {
-        const int kw = (int)kx.size();
+    // Runs fn(c, y0, y1) over rows [a, b) of every channel, split into row
+    // bands that never straddle a channel. Each output pixel is produced by
+    // exactly one band with the same accumulation order as a serial loop, so
+    // results do not depend on the thread count.
+    template <typename Fn>
+    static void for_each_band(int channels, int a, int b, int band, int threads, Fn&& fn) {
+        if (b <= a) return;
+        const int bands = div_up(b - a, band);
+        ThreadPool::global().parallel_for(0, channels * bands, 1, [&](int first, int last) {
+            for (int i = first; i < last; ++i) {
+                const int y0 = a + (i % bands) * band;
+                fn(i / bands, y0, std::min(b, y0 + band));
+            }
+        }, ThreadPool::resolve(threads));
+    }
+
+    Size conv_output_size(int width, int height, int kw, int kh, int stride) {
+        stride = std::max(1, stride);
+        return Size{div_up(width + 2*(kw/2) - kw + 1, stride), div_up(height + 2*(kh/2) - kh + 1, stride)};
+    }
+
+    Size conv_output_size(int width, int height, const Kernel& K, int stride) {
+        return conv_output_size(width, height, K.width(), K.height(), stride);
+    }
+
+    // Even kernels have one output more than input pixels (conv_output_size),
+    // and that output reads one pixel further right/down.
+    Reach conv_reach(const Kernel& K, int stride) {
+        const int kw = K.width(), kh = K.height();
+        return Reach{kw/2, kh/2, kw - 1 - kw/2 + (kw % 2 == 0), kh - 1 - kh/2 + (kh % 2 == 0), std::max(1, stride)};
+    }
+
+    RowRange conv_input_rows(int a, int b, int in_height, const Kernel& K, int stride) {
+        if (b <= a) return RowRange{0, 0};
+        const int kh = K.height();
+        stride = std::max(1, stride);
+        const int first = a*stride - kh/2;
+        const int last = (b - 1)*stride - kh/2 + kh;
+        const int begin = std::min(std::max(first, 0), in_height);
+        return RowRange{begin, std::min(std::max(last, begin), in_height)};
+    }
+
+    // Separable engine: the horizontal pass writes into a ring of kh rows and
+    // each output row is one vertical FIR over the ring, so no full-frame
+    // intermediate exists and both passes stream contiguous rows. Input row r
+    // lives in slot r % kh; a window spans at most kh distinct rows, so its
+    // rows never collide. Bands restart the ring, which costs kh - stride
+    // extra horizontal rows per band. A rank-k kernel keeps k filtered rows
+    // per slot and sums the k vertical passes.
+    static void convolve_separable(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        const std::vector<SeparableTerm>& terms = S.terms;
+        const int rank = (int)terms.size();
+        const int kw = S.kernel.width();
+        const int kh = S.kernel.height();
         const int pad_x = kw/2;
-        const int out_w = div_up(input.width() + 2*pad_x - kw + 1, std::max(1, stride_x));
-        Image out(out_w, input.height(), input.channels());
-
-        for(int c = 0; c<input.channels(); ++c) {
-            for(int y = 0; y < input.height(); ++y) {
-                for (int ox=0, ix=-pad_x; ox<out_w; ++ox, ix+=stride_x) {
-                    float acc = 0.0f;
-                    for (int kx_i=0; kx_i<kw; ++kx_i) {
-                        int sx = ix + kx_i;
-                        float v = sample(input, sx, y, c, pad);
-                        acc += v * kx[kx_i];
+        const int pad_y = kh/2;
+        const int stride = S.stride;
+        const Padding pad = S.pad;
+        const int out_w = conv_output_size(src.width(), src.height, S.kernel, stride).width;
+        const ConvKernels& kern = conv_kernels();
+        const std::vector<float> zeros(out_w, 0.0f);
+
+        for_each_band(src.channels(), a, b, S.band, threads, [&](int c, int y0, int y1) {
+            std::vector<float> ring((size_t)kh * rank * out_w);
+            std::vector<float> partial(rank > 1 ? out_w : 0);
+            std::vector<int> held(kh, -1); // input row held by each slot
+            std::vector<const float*> rows((size_t)rank * kh);
+            for (int oy = y0; oy < y1; ++oy) {
+                const int iy = oy*stride - pad_y;
+                for (int k = 0; k < kh; ++k) {
+                    int sy = iy + k;
+                    if (sy < 0 || sy >= src.height) {
+                        if (pad == Padding::ZERO) {
+                            for (int t = 0; t < rank; ++t) rows[(size_t)t*kh + k] = zeros.data();
+                            continue;
+                        }
+                        sy = std::min(std::max(sy, 0), src.height - 1);
+                    }
+                    const int slot = sy % kh;
+                    float* r = ring.data() + (size_t)slot*rank*out_w;
+                    if (held[slot] != sy) {
+                        for (int t = 0; t < rank; ++t)
+                            fir_row_padded(kern, src.row(sy, c), src.width(), stride, pad_x,
+                                           terms[t].kx.data(), kw, pad, r + (size_t)t*out_w, out_w, false);
+                        held[slot] = sy;
                     }
-                    out.at(ox, y, c) = acc;
+                    for (int t = 0; t < rank; ++t) rows[(size_t)t*kh + k] = r + (size_t)t*out_w;
+                }
+                float* out = dst.row(oy, c);
+                kern.fir_cols(rows.data(), terms[0].ky.data(), kh, out, out_w);
+                for (int t = 1; t < rank; ++t) {
+                    kern.fir_cols(rows.data() + (size_t)t*kh, terms[t].ky.data(), kh, partial.data(), out_w);
+                    for (int x = 0; x < out_w; ++x) out[x] += partial[x];
                 }
             }
-            return out;
-        }
+        });
     }
 
-    Image Convolver::convolve_vertical(const Image& input, const std::vector<float>& ky, Padding pad, int stride_y) {
-        const int kh = (int)ky.size();
+    static void convolve_2d(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        const Kernel& K = S.kernel;
+        const int kw = K.width();
+        const int kh = K.height();
+        const int pad_x = kw/2; // symmetric
         const int pad_y = kh/2;
-        const int out_h = div_up(input.height() + 2*pad_y - kh + 1, std::max(1, stride_y));
-        Image out(input.width(), out_h, input.channels());
-
-        for(int c=0; c<input.channels(); ++c) {
-            for(int x = 0; x < input.width(); ++x) {
-                for(int oy = 0, iy=-pad_y; oy<out_h; ++oy, iy+=stride_y) {
-                    float acc = 0.0f;
-                    for (int ky_i=0; ky_i<kh;++ky_i) {
-                        int sy = iy + ky_i;
-                        float v = sample(input, x, sy, c, pad);
-                        acc += v * ky[ky_i];
+        const int stride = S.stride;
+        const Padding pad = S.pad;
+        const int out_w = conv_output_size(src.width(), src.height, K, stride).width;
+        const ConvKernels& kern = conv_kernels();
+
+        // Each output row accumulates one horizontal FIR per kernel row.
+        for_each_band(src.channels(), a, b, S.band, threads, [&](int c, int y0, int y1) {
+            for (int oy = y0; oy < y1; ++oy) {
+                const int iy = oy*stride - pad_y;
+                float* out = dst.row(oy, c);
+                std::fill(out, out + out_w, 0.0f);
+                for (int ky_i : S.live_rows) {
+                    int sy = iy + ky_i;
+                    if (sy < 0 || sy >= src.height) {
+                        if (pad == Padding::ZERO) continue;
+                        sy = std::min(std::max(sy, 0), src.height - 1);
+                    }
+                    fir_row_padded(kern, src.row(sy, c), src.width(), stride, pad_x,
+                                   K.weights().data() + (size_t)ky_i*kw, kw, pad, out, out_w, true);
+                }
+            }
+        });
+    }
+
+    // Builtins matched at plan time run a compile-time specialized row body
+    // (stride 1 only); rows are stateless, so bands need no overlap.
+    static void convolve_fixed(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        const FixedConv& F = *S.fixed;
+        const int width = src.width();
+        const int pad_y = F.kh/2;
+        const std::vector<float> zeros(width, 0.0f);
+
+        for_each_band(src.channels(), a, b, S.band, threads, [&](int c, int y0, int y1) {
+            std::vector<float> scratch((size_t)width + F.kw);
+            std::vector<const float*> rows(F.kh);
+            for (int oy = y0; oy < y1; ++oy) {
+                for (int k = 0; k < F.kh; ++k) {
+                    int sy = oy - pad_y + k;
+                    if (sy < 0 || sy >= src.height) {
+                        if (S.pad == Padding::ZERO) { rows[k] = zeros.data(); continue; }
+                        sy = std::min(std::max(sy, 0), src.height - 1);
+                    }
+                    rows[k] = src.row(sy, c);
+                }
+                F.row(rows.data(), width, S.pad, dst.row(oy, c), scratch.data());
+            }
+        });
+    }
+
+    // Overlap-save FFT engine. Output tiles of tw x th pixels read an n x n
+    // input block (tile footprint plus kernel halo, padding resolved while
+    // gathering), whose spectrum times conj(FFT(kernel)) gives the
+    // correlation the direct path computes; only the wrap-free part of each
+    // block is kept. Two tiles share one complex transform (real and
+    // imaginary part), and all arithmetic is in double, so results match the
+    // direct float sum to ~1e-6 relative to sum|w| * max|input|.
+    static void convolve_fft(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        const int kw = S.kernel.width(), kh = S.kernel.height();
+        const int pad_x = kw/2, pad_y = kh/2;
+        const int stride = S.stride;
+        const Padding pad = S.pad;
+        const int n = S.fft_size;
+        const int out_w = conv_output_size(src.width(), src.height, S.kernel, stride).width;
+        const int tw = (n - kw) / stride + 1; // output columns per tile
+        const int th = (n - kh) / stride + 1; // output rows per tile
+        const int tiles_x = div_up(out_w, tw);
+        const int tiles_y = div_up(b - a, th);
+        const int tiles = src.channels() * tiles_x * tiles_y;
+        const FFT fft(n);
+        const std::vector<cplx>& spec = S.spectrum;
+
+        struct Tile { int c, ox0, oy0, cols, rows; };
+        auto tile = [&](int t) {
+            const int c = t / (tiles_x * tiles_y);
+            const int ty = t / tiles_x % tiles_y, tx = t % tiles_x;
+            const int ox0 = tx*tw, oy0 = a + ty*th;
+            return Tile{c, ox0, oy0, std::min(tw, out_w - ox0), std::min(th, b - oy0)};
+        };
+
+        ThreadPool::global().parallel_for(0, div_up(tiles, 2), 1, [&](int p0, int p1) {
+            std::vector<cplx> block((size_t)n*n), tmp(n);
+            std::vector<float> row(n);
+            for (int p = p0; p < p1; ++p) {
+                std::fill(block.begin(), block.end(), cplx(0.0, 0.0));
+                for (int half = 0; half < 2 && 2*p + half < tiles; ++half) {
+                    const Tile t = tile(2*p + half);
+                    const int ix0 = t.ox0*stride - pad_x, iy0 = t.oy0*stride - pad_y;
+                    const int cols = (t.cols - 1)*stride + kw; // only rows/cols the tile reads
+                    const int rows = (t.rows - 1)*stride + kh;
+                    for (int j = 0; j < rows; ++j) {
+                        int sy = iy0 + j;
+                        if (sy < 0 || sy >= src.height) {
+                            if (pad == Padding::ZERO) continue;
+                            sy = std::min(std::max(sy, 0), src.height - 1);
+                        }
+                        const float* in = src.row(sy, t.c);
+                        for (int i = 0; i < cols; ++i) {
+                            const int sx = ix0 + i;
+                            if (sx >= 0 && sx < src.width()) row[i] = in[sx];
+                            else if (pad == Padding::ZERO) row[i] = 0.0f;
+                            else row[i] = in[std::min(std::max(sx, 0), src.width() - 1)];
+                        }
+                        cplx* dst_row = block.data() + (size_t)j*n;
+                        if (half == 0) for (int i = 0; i < cols; ++i) dst_row[i].real(row[i]);
+                        else for (int i = 0; i < cols; ++i) dst_row[i].imag(row[i]);
+                    }
+                }
+
+                fft.forward_2d(block.data(), tmp.data());
+                for (size_t i = 0; i < block.size(); ++i) {
+                    const cplx u = block[i], w = spec[i];
+                    block[i] = cplx(u.real()*w.real() - u.imag()*w.imag(), u.real()*w.imag() + u.imag()*w.real());
+                }
+                fft.inverse_2d(block.data(), tmp.data());
+
+                for (int half = 0; half < 2 && 2*p + half < tiles; ++half) {
+                    const Tile t = tile(2*p + half);
+                    for (int jj = 0; jj < t.rows; ++jj) {
+                        const cplx* res = block.data() + (size_t)jj*stride*n;
+                        float* out = dst.row(t.oy0 + jj, t.c) + t.ox0;
+                        for (int ii = 0; ii < t.cols; ++ii) {
+                            const cplx v = res[(size_t)ii*stride];
+                            out[ii] = (float)(half == 0 ? v.real() : v.imag());
+                        }
                     }
-                    out.at(x, oy, c) = acc;
                 }
             }
+        }, ThreadPool::resolve(threads));
+    }
+
+    // Recursive engines (ConvAlgo::Recursive) for the gauss:/box: builtins.
+    // Both are separable. Horizontal sweeps run kIirLanes rows at a time,
+    // interleaved (sample x of row l at [x*L + l]); vertical sweeps walk
+    // down a span of columns a whole row at a time. Every row and column is
+    // filtered on its own, so results do not depend on how they are grouped
+    // or on the thread count.
+    //
+    // Accuracy of the Gaussian: Deriche's 4th-order approximation, with the
+    // recursions started in the steady state of the padded signal, against
+    // the sampled FIR (gauss:<sigma>'s weights) on [0, 1] data: a unit step
+    // is within 8e-5 for sigma 1 to 20, 2e-4 at 50 and 3e-4 at 100 (float
+    // rounding in the recursion); noise within 2e-4 from sigma 1 up; the
+    // response to a single bright pixel within ~1e-3 of its peak. Below
+    // sigma 1 errors reach ~7e-4, where the FIR is cheap anyway. The 8-bit
+    // quantization step is 4e-3.
+
+    // Interleaves rows[0..L) of `width` samples into dst, with `pad` samples
+    // of padding on each side (x from -pad to width + pad - 1).
+    static void interleave_rows(const float* const* rows, int width, int pad, Padding padding, float* dst) {
+        constexpr int L = kIirLanes;
+        for (int x = -pad; x < width + pad; ++x) {
+            float* d = dst + (size_t)(x + pad)*L;
+            if (x < 0 || x >= width) {
+                if (padding == Padding::ZERO) { std::fill_n(d, L, 0.0f); continue; }
+                const int cx = x < 0 ? 0 : width - 1;
+                for (int l = 0; l < L; ++l) d[l] = rows[l][cx];
+            } else {
+                for (int l = 0; l < L; ++l) d[l] = rows[l][x];
+            }
         }
-        return out;
     }
 
-    Image Convolver::convolve(const Image& input, const Kernel& K, const ConvParams& params){
-// Try separable fast path
-std::vector<float> ky, kx;
-if(K.try_separable(ky, kx)){
-// Horizontal (stride on X), then vertical (stride on Y)
-Image tmp = convolve_horizontal(input, kx, params.padding, params.stride);
-Image out = convolve_vertical(tmp, ky, params.padding, params.stride);
-
-
-// Visualization post-processing
-float global_min = std::numeric_limits<float>::infinity();
-float global_max = -std::numeric_limits<float>::infinity();
-for(int c=0;c<out.channels();++c)
-for(int y=0;y<out.height();++y)
-for(int x=0;x<out.width();++x){
-float v = out.at(x,y,c);
-global_min = std::min(global_min, v);
-global_max = std::max(global_max, v);
-}
+    // Gaussian: a horizontal sweep of every input row into a full-height
+    // intermediate of the output's columns, then vertical sweeps down it.
+    static void convolve_gauss_iir(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        constexpr int L = kIirLanes;
+        if (src.y0 != 0 || src.view.height() != src.height)
+            throw std::logic_error("convolve_rows: the recursive Gaussian needs the whole input");
+        const DericheGauss g = deriche_gauss(S.kernel.blur().sigma);
+        const int width = src.width(), height = src.height;
+        const int stride = S.stride;
+        const int out_w = conv_output_size(width, height, S.kernel, stride).width;
+        const ConvKernels& kern = conv_kernels();
+        const int nthreads = ThreadPool::resolve(threads);
+        Image tmp(out_w, height, 1, Fill::None);
+        // vertical sweeps take whole rows of wide spans, one span per thread
+        const int span_w = std::min(kIirColumns, std::max(4*L, div_up(div_up(out_w, nthreads), L) * L));
 
+        for (int c = 0; c < src.channels(); ++c) {
+            ThreadPool::global().parallel_for(0, div_up(height, L), 1, [&](int g0, int g1) {
+                std::vector<float> lanes((size_t)width * L), out((size_t)width * L);
+                std::vector<const float*> rows(L);
+                for (int grp = g0; grp < g1; ++grp) {
+                    const int y0 = grp*L, n = std::min(L, height - y0);
+                    for (int l = 0; l < L; ++l) rows[l] = src.row(y0 + std::min(l, n - 1), c);
+                    interleave_rows(rows.data(), width, 0, S.pad, lanes.data());
+                    kern.iir_lanes(g, lanes.data(), L, width, S.pad, out.data());
+                    for (int l = 0; l < n; ++l) {
+                        float* t = tmp.row(y0 + l);
+                        for (int ox = 0; ox < out_w; ++ox) t[ox] = out[(size_t)ox*stride*L + l];
+                    }
+                }
+            }, nthreads);
+            // every output row at stride 1: straight into dst
+            const bool in_place = stride == 1 && a == 0 && b == height;
+            ThreadPool::global().parallel_for(0, div_up(out_w, span_w), 1, [&](int s0, int s1) {
+                std::vector<float> cols(in_place ? 0 : (size_t)height * span_w);
+                for (int span = s0; span < s1; ++span) {
+                    const int x0 = span*span_w, n = std::min(span_w, out_w - x0);
+                    if (in_place) {
+                        kern.iir_columns(g, tmp.row(0) + x0, tmp.stride(), height, n, S.pad, dst.row(0, c) + x0,
+                                         dst.view.stride());
+                        continue;
+                    }
+                    kern.iir_columns(g, tmp.row(0) + x0, tmp.stride(), height, n, S.pad, cols.data(), n);
+                    for (int oy = a; oy < b; ++oy) std::copy_n(cols.data() + (size_t)oy*stride*n, n, dst.row(oy, c) + x0);
+                }
+            }, nthreads);
+        }
+    }
 
-for(int c=0;c<out.channels();++c)
-for(int y=0;y<out.height();++y)
-for(int x=0;x<out.width();++x){
-float v = out.at(x,y,c);
-switch(params.viz){
-case VizMode::Clamp: v = std::clamp(v, 0.0f, 1.0f); break;
-case VizMode::Normalize:
-if(global_max!=global_min) v = (v-global_min)/(global_max-global_min); else v=0.5f; break;
-case VizMode::None: break;
-}
-out.at(x,y,c)=v;
-}
-return out;
-}
+    // Box: vertical running sums of each output row's 2r+1 input rows at
+    // every input column, then horizontal running sums over interleaved
+    // rows. Only the rows within the radius are read, so strips work.
+    static void convolve_box(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        constexpr int L = kIirLanes;
+        constexpr int kColumnBlock = 512;
+        const int r = S.kernel.blur().radius;
+        const int width = src.width(), channels = src.channels();
+        const int stride = S.stride;
+        const int out_w = conv_output_size(width, src.height, S.kernel, stride).width;
+        const int rows = b - a;
+        const int bands = div_up(rows, S.band), col_blocks = div_up(width, kColumnBlock);
+        const ConvKernels& kern = conv_kernels();
+        const int nthreads = ThreadPool::resolve(threads);
+        Image vsum(width, rows, channels, Fill::None);
 
+        auto input_row = [&](int y, int c) -> const float* {
+            if (y < 0 || y >= src.height) {
+                if (S.pad == Padding::ZERO) return nullptr;
+                y = std::min(std::max(y, 0), src.height - 1);
+            }
+            return src.row(y, c);
+        };
+        ThreadPool::global().parallel_for(0, channels * bands * col_blocks, 1, [&](int first, int last) {
+            std::vector<double> acc(kColumnBlock);
+            for (int item = first; item < last; ++item) {
+                const int c = item / (bands * col_blocks), band = item / col_blocks % bands;
+                const int x0 = item % col_blocks * kColumnBlock, n = std::min(kColumnBlock, width - x0);
+                const int y0 = a + band*S.band, y1 = std::min(b, y0 + S.band);
+                auto add = [&](int y, double sign) {
+                    if (const float* p = input_row(y, c))
+                        for (int x = 0; x < n; ++x) acc[x] += sign * p[x0 + x];
+                };
+                std::fill_n(acc.begin(), n, 0.0);
+                for (int k = -r; k <= r; ++k) add(y0*stride + k, 1.0);
+                for (int oy = y0; oy < y1; ++oy) {
+                    if (oy > y0)
+                        for (int iy = (oy - 1)*stride + 1; iy <= oy*stride; ++iy) {
+                            add(iy + r, 1.0);
+                            add(iy - r - 1, -1.0);
+                        }
+                    float* v = vsum.row(oy - a, c) + x0;
+                    for (int x = 0; x < n; ++x) v[x] = (float)acc[x];
+                }
+            }
+        }, nthreads);
 
-// Fallback: full 2D convolution
-const int kw = K.width();
-const int kh = K.height();
-const int pad_x = kw/2; // symmetric
-const int pad_y = kh/2;
-const int stride = std::max(1, params.stride);
+        const double scale = 1.0 / ((double)(2*r + 1) * (2*r + 1));
+        const int groups = div_up(rows, L);
+        ThreadPool::global().parallel_for(0, channels * groups, 1, [&](int first, int last) {
+            std::vector<float> lanes((size_t)(width + 2*r) * L), out((size_t)out_w * L);
+            std::vector<const float*> rows_l(L);
+            for (int item = first; item < last; ++item) {
+                const int c = item / groups, y0 = item % groups * L, n = std::min(L, rows - y0);
+                for (int l = 0; l < L; ++l) rows_l[l] = vsum.row(y0 + std::min(l, n - 1), c);
+                interleave_rows(rows_l.data(), width, r, S.pad, lanes.data());
+                kern.box_lanes(lanes.data(), out_w, r, stride, scale, out.data());
+                for (int l = 0; l < n; ++l) {
+                    float* o = dst.row(a + y0 + l, c);
+                    for (int ox = 0; ox < out_w; ++ox) o[ox] = out[(size_t)ox*L + l];
+                }
+            }
+        }, nthreads);
+    }
 
+    // Cost model, in units of one vectorized multiply-add. The weights were
+    // calibrated against the direct path on AVX2: strided taps gather and
+    // run ~4x slower per tap, an FFT butterfly stage in double costs about
+    // 40 multiply-adds per point, and the recursive filters cost a fixed
+    // amount per input pixel, mostly memory traffic (the separable Gaussian
+    // overtakes them near sigma 4, the box near radius 10).
+    static double cost(const Kernel& K, int width, int height, int stride, ConvAlgo algo,
+                       int rank, int& fft_size) {
+        constexpr double kFftPointStage = 40.0;
+        constexpr double kFftPoint = 80.0;
+        constexpr double kStridedTap = 4.0;
+        constexpr double kGaussPixel = 64.0;
+        constexpr double kBoxPixel = 40.0;
+        constexpr double kNever = std::numeric_limits<double>::infinity();
+        stride = std::max(1, stride);
+        const int kw = K.width(), kh = K.height();
+        const Size out = conv_output_size(width, height, K, stride);
+        const double out_px = (double)out.width * out.height;
+        const double tap = stride > 1 ? kStridedTap : 1.0;
 
-const int out_w = div_up(input.width() + 2*pad_x - kw + 1, stride);
-const int out_h = div_up(input.height() + 2*pad_y - kh + 1, stride);
-Image out(out_w, out_h, input.channels());
+        switch (algo) {
+            case ConvAlgo::Direct:
+                return out_px * kw * kh * tap;
+            case ConvAlgo::Separable:
+                if (rank < 1) return kNever;
+                return rank * ((double)out.width * std::min(height, out.height*stride) * kw + out_px * kh) * tap;
+            case ConvAlgo::FFT: {
+                double best = kNever;
+                int best_n = 0;
+                for (int n = 16; n <= 512; n <<= 1) {
+                    if (n < kw || n < kh || (fft_size && n != fft_size)) continue;
+                    const int tw = (n - kw) / stride + 1, th = (n - kh) / stride + 1;
+                    const double tiles = (double)div_up(out.width, tw) * div_up(out.height, th);
+                    const double log_n2 = 2.0 * std::log2((double)n);
+                    const double c = tiles / 2.0 * (double)n*n * (2.0*log_n2*kFftPointStage + kFftPoint);
+                    if (c < best) { best = c; best_n = n; }
+                }
+                fft_size = best_n;
+                return best;
+            }
+            case ConvAlgo::Recursive:
+                switch (K.blur().kind) {
+                    case BlurShape::Kind::Gaussian: return (double)width * height * kGaussPixel;
+                    case BlurShape::Kind::Box: return (double)width * height * kBoxPixel;
+                    default: return kNever;
+                }
+            default:
+                return kNever;
+        }
+    }
 
+    // Auto takes the sum of separable passes only where it does less work
+    // per pixel than the 2D sum: rank*(kw + kh) < kw*kh (exact rank-1
+    // kernels always qualify).
+    static bool worth_separating(const Kernel& K, int rank) {
+        return rank == 1 || (rank > 1 && rank * (K.width() + K.height()) < K.width() * K.height());
+    }
 
-float global_min = std::numeric_limits<float>::infinity();
-float global_max = -std::numeric_limits<float>::infinity();
+    double conv_cost(const Kernel& K, int width, int height, int stride, ConvAlgo algo,
+                     float rank_tolerance, int fft_size) {
+        const int rank = algo == ConvAlgo::Separable ? (int)K.low_rank(rank_tolerance).size() : 0;
+        return cost(K, width, height, stride, algo, rank, fft_size);
+    }
 
+    ConvSetup make_conv_setup(const Kernel& K, int width, int height, Padding pad, int stride,
+                              ConvAlgo algo, float rank_tolerance, int band, int fft_size) {
+        if (fft_size && (fft_size < 16 || fft_size > 512 || (fft_size & (fft_size - 1)) != 0))
+            throw std::runtime_error("FFT size must be a power of two in [16, 512]");
+        ConvSetup S;
+        S.kernel = K;
+        S.width = width;
+        S.height = height;
+        S.pad = pad;
+        S.stride = std::max(1, stride);
+        if (algo == ConvAlgo::Auto || algo == ConvAlgo::Separable) S.terms = K.low_rank(rank_tolerance);
+        const int rank = (int)S.terms.size();
+
+        int n = fft_size;
+        const double fft = cost(K, width, height, S.stride, ConvAlgo::FFT, rank, n);
+        const double recursive = cost(K, width, height, S.stride, ConvAlgo::Recursive, rank, n);
+        if (algo == ConvAlgo::Auto) {
+            const bool separable = worth_separating(K, rank);
+            const double direct = cost(K, width, height, S.stride, ConvAlgo::Direct, rank, n);
+            const double sep = separable ? cost(K, width, height, S.stride, ConvAlgo::Separable, rank, n) : direct;
+            algo = fft < direct && fft < sep ? ConvAlgo::FFT : separable ? ConvAlgo::Separable : ConvAlgo::Direct;
+            if (recursive < std::min({fft, direct, sep})) algo = ConvAlgo::Recursive;
+        }
+        // Forced choices the kernel cannot take fall back to Direct.
+        if ((algo == ConvAlgo::FFT && !n) || (algo == ConvAlgo::Separable && rank < 1) ||
+            (algo == ConvAlgo::Recursive && recursive == std::numeric_limits<double>::infinity()))
+            algo = ConvAlgo::Direct;
+        S.algo = algo;
+        if (algo != ConvAlgo::Separable) S.terms.clear();
+        if ((algo == ConvAlgo::Direct || algo == ConvAlgo::Separable) && S.stride == 1)
+            S.fixed = match_fixed(K.weights().data(), K.width(), K.height());
+        const int out_w = conv_output_size(width, height, K, S.stride).width;
+        const int kw = K.width(), kh = K.height();
+        switch (algo) {
+            case ConvAlgo::Separable:
+                // Bands restart the ring, so keep them well above kh rows.
+                S.band = band > 0 ? band : std::max(band_rows(out_w), 8*kh);
+                break;
+            case ConvAlgo::FFT: {
+                S.fft_size = n;
+                const FFT f(n);
+                std::vector<cplx> scratch(n);
+                S.spectrum.assign((size_t)n*n, cplx(0.0, 0.0));
+                for (int j = 0; j < kh; ++j)
+                    for (int i = 0; i < kw; ++i) S.spectrum[(size_t)j*n + i] = K.weights()[(size_t)j*kw + i];
+                f.forward_2d(S.spectrum.data(), scratch.data());
+                for (cplx& v : S.spectrum) v = std::conj(v);
+                break;
+            }
+            case ConvAlgo::Recursive:
+                // box: bands restart the running sums (2r+1 rows each)
+                S.whole_columns = K.blur().kind == BlurShape::Kind::Gaussian;
+                S.band = band > 0 ? band : std::max(band_rows(out_w), 4*kh);
+                break;
+            default:
+                // Kernel rows that are entirely zero (e.g. the middle row of
+                // sobel_y) contribute nothing and are skipped.
+                for (int ky_i = 0; ky_i < kh; ++ky_i) {
+                    const float* w = K.weights().data() + (size_t)ky_i*kw;
+                    if (std::any_of(w, w + kw, [](float v){ return v != 0.0f; })) S.live_rows.push_back(ky_i);
+                }
+                S.band = band > 0 ? band : band_rows(out_w);
+                break;
+        }
+        return S;
+    }
+
+    void convolve_rows(const ConvSetup& S, const Strip& src, const RowSink& dst, int a, int b, int threads) {
+        if (b <= a) return;
+        if (S.fixed) { convolve_fixed(S, src, dst, a, b, threads); return; }
+        switch (S.algo) {
+            case ConvAlgo::Separable: convolve_separable(S, src, dst, a, b, threads); break;
+            case ConvAlgo::FFT: convolve_fft(S, src, dst, a, b, threads); break;
+            case ConvAlgo::Recursive:
+                if (S.whole_columns) convolve_gauss_iir(S, src, dst, a, b, threads);
+                else convolve_box(S, src, dst, a, b, threads);
+                break;
+            default: convolve_2d(S, src, dst, a, b, threads); break;
+        }
+    }
+
+    BankSetup make_bank_setup(const std::vector<Kernel>& kernels) {
+        BankSetup S;
+        S.kw = kernels[0].width();
+        S.kh = kernels[0].height();
+        S.n = (int)kernels.size();
+        for (int j = 0; j < S.kh; ++j)
+            for (int i = 0; i < S.kw; ++i)
+                if (std::any_of(kernels.begin(), kernels.end(),
+                                [&](const Kernel& K) { return K.weights()[(size_t)j*S.kw + i] != 0.0f; })) {
+                    S.tap_y.push_back(j);
+                    S.tap_x.push_back(i);
+                }
+        const size_t taps = S.tap_y.size();
+        for (int g = 0; g < S.n; g += kMaxBankKernels) {
+            const int nk = std::min(kMaxBankKernels, S.n - g);
+            std::vector<float> w(taps * nk);
+            for (size_t t = 0; t < taps; ++t)
+                for (int k = 0; k < nk; ++k)
+                    w[t*nk + k] = kernels[g + k].weights()[(size_t)S.tap_y[t]*S.kw + S.tap_x[t]];
+            S.weights.push_back(std::move(w));
+        }
+        return S;
+    }
+
+    // Filter bank engine. Input rows are padded horizontally once into a
+    // ring of kh lines (slot r % kh, as in convolve_separable), so every tap
+    // is a plain pointer into a line and bank_row sees no borders; all
+    // kernels then share each load. Banks too large for one bank_row call
+    // reduce from per-kernel scratch rows instead.
+    void filter_bank_rows(const BankSetup& S, BankReduce reduce, Padding pad, int stride, const Strip& src,
+                          const RowSink* dst, int a, int b, int threads) {
+        if (b <= a) return;
+        stride = std::max(1, stride);
+        const int kw = S.kw, kh = S.kh;
+        const int pad_x = kw/2, pad_y = kh/2;
+        const int width = src.width();
+        const int out_w = conv_output_size(width, src.height, kw, kh, stride).width;
+        if (out_w <= 0) return;
+        const int line = (out_w - 1)*stride + kw; // padded samples the outputs read
+        const int ntaps = (int)S.tap_y.size();
+        const bool scratch = reduce != BankReduce::None && S.n > kMaxBankKernels;
+        const ConvKernels& kern = conv_kernels();
+        const std::vector<float> zeros(line, 0.0f);
+
+        auto pad_line = [&](const float* in, float* out) {
+            const int inner = std::min(width, line - pad_x);
+            std::fill_n(out, pad_x, pad == Padding::ZERO ? 0.0f : in[0]);
+            std::copy_n(in, inner, out + pad_x);
+            std::fill(out + pad_x + inner, out + line, pad == Padding::ZERO ? 0.0f : in[width - 1]);
+        };
+
+        const int band = std::max(band_rows(out_w), 8*kh);
+        for_each_band(src.channels(), a, b, band, threads, [&](int c, int y0, int y1) {
+            std::vector<float> ring((size_t)kh * line);
+            std::vector<int> held(kh, -1);
+            std::vector<const float*> rows(kh), taps(ntaps);
+            std::vector<float> resp(scratch ? (size_t)S.n * out_w : 0);
+            std::vector<float*> outs(S.n);
+            for (int oy = y0; oy < y1; ++oy) {
+                for (int k = 0; k < kh; ++k) {
+                    int sy = oy*stride - pad_y + k;
+                    if (sy < 0 || sy >= src.height) {
+                        if (pad == Padding::ZERO) { rows[k] = zeros.data(); continue; }
+                        sy = std::min(std::max(sy, 0), src.height - 1);
+                    }
+                    float* r = ring.data() + (size_t)(sy % kh)*line;
+                    if (held[sy % kh] != sy) {
+                        pad_line(src.row(sy, c), r);
+                        held[sy % kh] = sy;
+                    }
+                    rows[k] = r;
+                }
+                for (int t = 0; t < ntaps; ++t) taps[t] = rows[S.tap_y[t]] + S.tap_x[t];
+
+                if (reduce != BankReduce::None && !scratch) {
+                    float* out = dst[0].row(oy, c);
+                    const BankOut mode = reduce == BankReduce::Magnitude ? BankOut::Magnitude
+                                       : reduce == BankReduce::Orientation ? BankOut::Orientation : BankOut::Max;
+                    kern.bank_row(taps.data(), ntaps, stride, S.weights[0].data(), S.n, mode, &out, out_w);
+                    continue;
+                }
+                for (int k = 0; k < S.n; ++k) outs[k] = scratch ? resp.data() + (size_t)k*out_w : dst[k].row(oy, c);
+                for (int g = 0; g < (int)S.weights.size(); ++g) {
+                    const int first = g*kMaxBankKernels;
+                    kern.bank_row(taps.data(), ntaps, stride, S.weights[g].data(), std::min(kMaxBankKernels, S.n - first),
+                                  BankOut::Each, outs.data() + first, out_w);
+                }
+                if (!scratch) continue;
+                float* out = dst[0].row(oy, c);
+                for (int x = 0; x < out_w; ++x) {
+                    if (reduce == BankReduce::Magnitude) {
+                        float sum = 0.0f;
+                        for (int k = 0; k < S.n; ++k) sum += resp[(size_t)k*out_w + x] * resp[(size_t)k*out_w + x];
+                        out[x] = std::sqrt(sum);
+                    } else {
+                        float m = resp[x];
+                        for (int k = 1; k < S.n; ++k) m = std::max(m, resp[(size_t)k*out_w + x]);
+                        out[x] = m;
+                    }
+                }
+            }
+        });
+    }
+
+    // 8-bit path: exact int32 sums over the raw samples with fixed-point
+    // weights, rounded and saturated once per output. Rank-1 kernels run
+    // horizontal then vertical with Q10 factors each (a ring of filtered rows
+    // as in convolve_separable); others run the 2D sum with Q14 weights. The
+    // L1 bounds keep every intermediate inside int32.
+    struct QuantKernel {
+        int shift{0};
+        std::vector<int32_t> q;      // 2D, kh x kw
+        std::vector<int32_t> qx, qy; // separable factors
+    };
+
+    // Rounds w * 2^bits to integers whose sum is the rounded sum of w * 2^bits:
+    // the taps that rounded furthest are moved a unit, so a blur of many
+    // small taps keeps its gain and a flat image stays flat. Returns the L1.
+    static double quantize_taps(const std::vector<float>& w, int bits, std::vector<int32_t>& q) {
+        const double scale = (double)(1 << bits);
+        std::vector<double> residual(w.size());
+        double sum = 0;
+        int64_t qsum = 0;
+        q.resize(w.size());
+        for (size_t i = 0; i < w.size(); ++i) {
+            q[i] = (int32_t)std::lround(w[i] * scale);
+            residual[i] = w[i] * scale - q[i];
+            sum += w[i] * scale;
+            qsum += q[i];
+        }
+        int64_t diff = std::llround(sum) - qsum;
+        std::vector<size_t> order(w.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return diff > 0 ? residual[a] > residual[b] : residual[a] < residual[b];
+        });
+        for (size_t k = 0; diff != 0 && k < order.size(); ++k) {
+            const int step = diff > 0 ? 1 : -1;
+            q[order[k]] += step;
+            diff -= step;
+        }
+        double l1 = 0;
+        for (int32_t v : q) l1 += std::abs((double)v);
+        return l1;
+    }
+
+    static bool quantize_weights(const Kernel& K, QuantKernel& Q) {
+        constexpr int k2D = 14, kAxis = 10;
+        std::vector<float> ky, kx;
+        if (K.try_separable(ky, kx)) {
+            // try_separable puts the whole scale in one factor; give both the
+            // same largest tap so neither rounds away at Q10
+            float mx = 0.0f, my = 0.0f;
+            for (float v : kx) mx = std::max(mx, std::fabs(v));
+            for (float v : ky) my = std::max(my, std::fabs(v));
+            if (mx > 0.0f && my > 0.0f) {
+                const float s = std::sqrt(my / mx);
+                for (float& v : kx) v *= s;
+                for (float& v : ky) v /= s;
+            }
+            const double lx = quantize_taps(kx, kAxis, Q.qx), ly = quantize_taps(ky, kAxis, Q.qy);
+            if (255.0 * lx * ly < 1073741824.0) {
+                Q.shift = 2*kAxis;
+                return true;
+            }
+            Q.qx.clear();
+            Q.qy.clear();
+        }
+        Q.shift = k2D;
+        return 255.0 * quantize_taps(K.weights(), k2D, Q.q) < 1073741824.0;
+    }
+
+    // Output rows [a, b) of `in`; row a goes to out row 0.
+    static void convolve_q(ConstImageView8 in, ImageView8 out, const Kernel& K, const QuantKernel& Q,
+                           Padding pad, int stride, int a, int b, int threads) {
+        const int kw = K.width(), kh = K.height();
+        const int pad_x = kw/2, pad_y = kh/2;
+        const int out_w = conv_output_size(in.width(), in.height(), K, stride).width;
+        const int32_t bias = 1 << (Q.shift - 1);
+        const ConvKernels& kern = conv_kernels();
+        auto store = [&](const int32_t* acc, uint8_t* dst) {
+            for (int x = 0; x < out_w; ++x) dst[x] = (uint8_t)std::clamp((acc[x] + bias) >> Q.shift, 0, 255);
+        };
+        auto source_row = [&](int sy) {
+            if (sy >= 0 && sy < in.height()) return sy;
+            return pad == Padding::ZERO ? -1 : std::min(std::max(sy, 0), in.height() - 1);
+        };
+
+        if (!Q.qx.empty()) {
+            const std::vector<int32_t> zeros(out_w, 0);
+            const int band = std::max(band_rows(out_w), 8*kh);
+            for_each_band(in.channels(), a, b, band, threads, [&](int c, int y0, int y1) {
+                std::vector<int32_t> ring((size_t)kh * out_w), acc(out_w);
+                std::vector<int> held(kh, -1);
+                std::vector<const int32_t*> rows(kh);
+                for (int oy = y0; oy < y1; ++oy) {
+                    for (int k = 0; k < kh; ++k) {
+                        const int sy = source_row(oy*stride - pad_y + k);
+                        if (sy < 0) { rows[k] = zeros.data(); continue; }
+                        int32_t* r = ring.data() + (size_t)(sy % kh)*out_w;
+                        if (held[sy % kh] != sy) {
+                            std::fill(r, r + out_w, 0);
+                            fir_row_q_padded(kern, in.row(sy, c), in.width(), stride, pad_x,
+                                             Q.qx.data(), kw, pad, r, out_w);
+                            held[sy % kh] = sy;
+                        }
+                        rows[k] = r;
+                    }
+                    kern.fir_cols_q(rows.data(), Q.qy.data(), kh, acc.data(), out_w);
+                    store(acc.data(), out.row(oy - a, c));
+                }
+            });
+            return;
+        }
+
+        for_each_band(in.channels(), a, b, band_rows(out_w), threads, [&](int c, int y0, int y1) {
+            std::vector<int32_t> acc(out_w);
+            for (int oy = y0; oy < y1; ++oy) {
+                std::fill(acc.begin(), acc.end(), 0);
+                for (int j = 0; j < kh; ++j) {
+                    const int sy = source_row(oy*stride - pad_y + j);
+                    if (sy < 0) continue;
+                    fir_row_q_padded(kern, in.row(sy, c), in.width(), stride, pad_x,
+                                     Q.q.data() + (size_t)j*kw, kw, pad, acc.data(), out_w);
+                }
+                store(acc.data(), out.row(oy - a, c));
+            }
+        });
+    }
+
+    void apply_viz(ImageView out, VizMode viz, int threads) {
+        if (viz == VizMode::None) return;
+
+        const int rows = out.height();
+        float global_min = std::numeric_limits<float>::infinity();
+        float global_max = -std::numeric_limits<float>::infinity();
+        if (viz == VizMode::Normalize) {
+            // min/max are order independent, so per-row partials merge exactly
+            std::vector<float> row_min((size_t)out.channels()*rows), row_max(row_min.size());
+            for_each_band(out.channels(), 0, rows, band_rows(out.width()), threads, [&](int c, int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                    float mn = std::numeric_limits<float>::infinity();
+                    float mx = -std::numeric_limits<float>::infinity();
+                    for (int x = 0; x < out.width(); ++x) {
+                        float v = out.at(x, y, c);
+                        mn = std::min(mn, v);
+                        mx = std::max(mx, v);
+                    }
+                    row_min[(size_t)c*rows + y] = mn;
+                    row_max[(size_t)c*rows + y] = mx;
+                }
+            });
+            for (size_t i = 0; i < row_min.size(); ++i) {
+                global_min = std::min(global_min, row_min[i]);
+                global_max = std::max(global_max, row_max[i]);
+            }
+        }
+
+        const float range = global_max - global_min;
+        for_each_band(out.channels(), 0, rows, band_rows(out.width()), threads, [&](int c, int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                float* row = out.row(y, c);
+                if (viz == VizMode::Clamp) {
+                    for (int x = 0; x < out.width(); ++x) row[x] = std::clamp(row[x], 0.0f, 1.0f);
+                } else if (range != 0.0f) {
+                    for (int x = 0; x < out.width(); ++x) row[x] = (row[x]-global_min)/range;
+                } else {
+                    std::fill(row, row + out.width(), 0.5f);
+                }
+            }
+        });
+    }
 
-for(int c=0;c<input.channels();++c){
-for(int oy=0, iy=-pad_y; oy<out_h; ++oy, iy+=stride){
-for(int ox=0, ix=-pad_x; ox<out_w; ++ox, ix+=stride){
-float acc = 0.0f;
-for(int ky_i=0; ky_i<kh; ++ky_i){
-for(int kx_i=0; kx_i<kw; ++kx_i){
-int sx = ix + kx_i;
-int sy = iy + ky_i;
-float v = sample(input, sx, sy, c, params.padding);
-acc += v * K.weights()[(size_t)ky_i*kw + kx_i];
-}
-}
-out.at(ox,oy,c) = acc;
-global_min = std::min(global_min, acc);
-global_max = std::max(global_max, acc);
-}
-}
 }
 
+    Image Convolver::convolve(ConstImageView input, const Kernel& K, const ConvParams& params){
+        return ConvPlan(K, input.width(), input.height(), input.channels(), params).execute(input);
+    }
+
+    void Convolver::convolve(ConstImageView input, ImageView output, const Kernel& K, const ConvParams& params) {
+        ConvPlan(K, input.width(), input.height(), input.channels(), params).execute(input, output);
+    }
+
+    Image8 Convolver::convolve(ConstImageView8 input, const Kernel& K, const ConvParams& params) {
+        const Size size = detail::conv_output_size(input.width(), input.height(), K, params.stride);
+        Image8 out(size.width, size.height, input.channels(), Fill::None);
+        convolve(input, out, K, params);
+        return out;
+    }
+
+    void Convolver::convolve(ConstImageView8 input, ImageView8 output, const Kernel& K, const ConvParams& params) {
+        const int stride = std::max(1, params.stride);
+        const Size size = detail::conv_output_size(input.width(), input.height(), K, stride);
+        if (output.width() != size.width || output.height() != size.height || output.channels() != input.channels())
+            throw std::runtime_error("Convolver::convolve: output view has the wrong shape");
+        const detail::Reach reach = detail::conv_reach(K, stride);
+        LUMINE_TRACE_SCOPE("convolve.u8", "width", input.width(), "height", input.height());
+
+        // a gauss:/box: blur that plans Recursive stays independent of its
+        // size through the float path, where fixed point would sum every tap
+        const bool recursive = K.blur().kind != BlurShape::Kind::None &&
+                               choose_algorithm(K, input.width(), input.height(), params) == ConvAlgo::Recursive;
+        detail::QuantKernel q;
+        if (params.viz == VizMode::Normalize || recursive || !detail::quantize_weights(K, q)) {
+            // float path on the ROI plus the context the kernel can read
+            const auto& ctx = input.context();
+            auto grow = [&](int need, int avail) { return std::min(avail, (need + stride - 1) / stride * stride); };
+            const int l = grow(reach.left, ctx.left), t = grow(reach.top, ctx.top);
+            const Image f = input.expand(l, t, std::min(reach.right, ctx.right), std::min(reach.bottom, ctx.bottom))
+                                .convert<float>();
+            const Image r = convolve(f.view(l, t, input.width(), input.height()), K, params);
+            for (int c = 0; c < r.channels(); ++c)
+                for (int y = 0; y < r.height(); ++y) {
+                    const float* src = r.row(y, c);
+                    uint8_t* dst = output.row(y, c);
+                    for (int x = 0; x < r.width(); ++x) dst[x] = convert_pixel<uint8_t>(src[x]);
+                }
+            return;
+        }
+        LUMINE_TRACE_NOTE("conv.algo", "u8 fixed point");
+        LUMINE_TRACE_COUNT("pixels.convolved", (double)input.width() * input.height() * input.channels());
+        detail::run_roi(input, output, reach, params.padding,
+                        [&](int w) { return detail::conv_output_size(w, 1, K, stride).width; },
+                        [&](ConstImageView8 src, ImageView8 dst, int a, int b) {
+            detail::convolve_q(src, dst, K, q, params.padding, stride, a, b, params.threads);
+        });
+    }
 
+    ConvAlgo Convolver::choose_algorithm(const Kernel& K, int width, int height, const ConvParams& params) {
+        return ConvPlan(K, width, height, 1, params).algorithm();
+    }
 }
-}
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "lumine/preprocessing.hpp"
+#include "lumine/binary_image.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "conv_kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace lumine {
+
+namespace {
+
+// The pyramid halves the page while both sides stay at least twice this;
+// the wide angle search runs on the last level.
+constexpr int kCoarseSize = 256;
+// The full-resolution page is searched too when its first reduction is
+// narrower than this, which would leave the angle coarse.
+constexpr int kFineSize = 1024;
+// Columns per profile cell (one byte of a BinaryImage word): a cell's ink
+// moves between profile rows as a unit.
+constexpr int kCellBits = 8;
+// Candidates either side of the best angle so far on each finer level, one
+// step (a shear of one row at the level's edges) apart.
+constexpr int kRefineSteps = 2;
+// deskew() leaves pages with less skew than this (about the estimate's
+// resolution) alone: rotating them would only blur.
+constexpr double kMinDeskewDegrees = 0.05;
+
+// Otsu's threshold over a 256-bin histogram of [0, 1] samples; -1 when the
+// image has a single value.
+float otsu_threshold(ConstImageView img) {
+  std::array<int64_t, 256> hist{};
+  for (int y = 0; y < img.height(); ++y) {
+    const float* row = img.row(y);
+    for (int x = 0; x < img.width(); ++x) ++hist[std::clamp((int)(row[x] * 255.0f + 0.5f), 0, 255)];
+  }
+  const double total = (double)img.width() * img.height();
+  double sum = 0.0;
+  for (int i = 0; i < 256; ++i) sum += (double)i * hist[i];
+  double below = 0.0, below_sum = 0.0, best = 0.0;
+  int threshold = -1;
+  for (int i = 0; i < 255; ++i) {
+    below += hist[i];
+    below_sum += (double)i * hist[i];
+    if (below == 0.0 || below == total) continue;
+    const double d = below_sum / below - (sum - below_sum) / (total - below);
+    const double between = below * (total - below) * d * d;
+    if (between > best) { best = between; threshold = i; }
+  }
+  return threshold < 0 ? -1.0f : (threshold + 0.5f) / 255.0f;
+}
+
+// Ink (samples at or below the threshold) per cell of one pyramid level,
+// stored a cell column at a time, cells[j * height + y], so a shifted
+// column adds into the profile as one contiguous loop.
+struct InkCells {
+  int width{0}, height{0}, columns{0};
+  int64_t total{0};
+  std::vector<uint8_t> cells;
+};
+
+InkCells ink_cells(ConstImageView level, float threshold, int threads) {
+  const BinaryImage paper = BinaryImage::from_image(level, threshold, threads);
+  InkCells ink;
+  ink.width = level.width();
+  ink.height = level.height();
+  ink.columns = (ink.width + kCellBits - 1) / kCellBits;
+  ink.cells.resize((size_t)ink.columns * ink.height);
+  // blocks of rows, so each cell column is written a contiguous run at a time
+  constexpr int kBlockRows = 64;
+  const int blocks = (ink.height + kBlockRows - 1) / kBlockRows;
+  std::vector<int64_t> block_ink(blocks, 0);
+  ThreadPool::global().parallel_for(0, blocks, 1, [&](int first, int last) {
+    for (int b = first; b < last; ++b) {
+      const int y0 = b * kBlockRows, y1 = std::min(ink.height, y0 + kBlockRows);
+      int64_t n = 0;
+      for (int j = 0; j < ink.columns; ++j) {
+        const int cols = std::min(kCellBits, ink.width - j * kCellBits);
+        const int shift = 8 * (j % 8);
+        uint8_t* out = ink.cells.data() + (size_t)j * ink.height;
+        for (int y = y0; y < y1; ++y) {
+          const int c = cols - __builtin_popcountll((paper.row(y)[j / 8] >> shift) & 0xffu);
+          out[y] = (uint8_t)c;
+          n += c;
+        }
+      }
+      block_ink[b] = n;
+    }
+  }, ThreadPool::resolve(threads));
+  for (int64_t n : block_ink) ink.total += n;
+  return ink;
+}
+
+// Variance of the row profile of ink after shearing by t: cell column j
+// moves down round(x_j * t) rows, x_j its centre's offset from the middle
+// column. Text lines at angle atan(t) then fall into single profile rows,
+// and the profile is sharpest. The ink total is the same for every t, so
+// the variance is taken over the level's rows whatever the margins.
+double profile_variance(const InkCells& ink, double t, std::vector<int>& profile) {
+  const int margin = (int)std::ceil(std::abs(t) * ink.width * 0.5) + 1;
+  profile.assign((size_t)ink.height + 2 * margin, 0);
+  const double mid = (ink.width - 1) * 0.5;
+  for (int j = 0; j < ink.columns; ++j) {
+    const double x = j * kCellBits + (kCellBits - 1) * 0.5 - mid;
+    int* p = profile.data() + margin + (int)std::lround(x * t);
+    const uint8_t* c = ink.cells.data() + (size_t)j * ink.height;
+    for (int y = 0; y < ink.height; ++y) p[y] += c[y];
+  }
+  double sq = 0.0;
+  for (int v : profile) sq += (double)v * v;
+  const double mean = (double)ink.total / ink.height;
+  return sq / ink.height - mean * mean;
+}
+
+// Shear step of a level: the factor that moves the outermost cells one
+// whole profile row. A smaller step shears nothing (every shift rounds to
+// zero), so neighbouring candidates would score the same.
+double shear_step(const InkCells& ink) {
+  const double mid = (ink.width - 1) * 0.5;
+  const double edge = std::max(std::abs((kCellBits - 1) * 0.5 - mid),
+                               std::abs((ink.columns - 1) * kCellBits + (kCellBits - 1) * 0.5 - mid));
+  return 1.0 / std::max(1.0, edge);
+}
+
+// The best of `candidates` (shear factors) on one level, scored in
+// parallel; ties go to the smallest |t| (then the first), so a page with no
+// measurable skew reads as straight and the result is the same for any
+// thread count. Writes every score to `scores`.
+int best_candidate(const InkCells& ink, const std::vector<double>& candidates, std::vector<double>& scores,
+                   int threads) {
+  scores.assign(candidates.size(), 0.0);
+  ThreadPool::global().parallel_for(0, (int)candidates.size(), 1, [&](int first, int last) {
+    std::vector<int> profile;
+    for (int i = first; i < last; ++i) scores[i] = profile_variance(ink, candidates[i], profile);
+  }, ThreadPool::resolve(threads));
+  int best = 0;
+  for (int i = 1; i < (int)scores.size(); ++i)
+    if (scores[i] > scores[best] ||
+        (scores[i] == scores[best] && std::abs(candidates[i]) < std::abs(candidates[best])))
+      best = i;
+  return best;
+}
+
+void check_rotate_output(ConstImageView input, ConstImageView output) {
+  if (output.width() != input.width() || output.height() != input.height() || output.channels() != input.channels())
+    throw std::runtime_error("rotate: output view has the wrong shape");
+}
+
+}
+
+double Preprocessing::estimate_skew(ConstImageView input, double max_degrees, int threads) {
+  if (!(max_degrees > 0.0 && max_degrees <= 45.0))
+    throw std::runtime_error("estimate_skew: max_degrees must be in (0, 45]");
+  LUMINE_TRACE_SCOPE("skew_estimate", "width", input.width(), "height", input.height());
+  if (input.empty()) return 0.0;
+
+  // Pyramid: view 0 is the input, view i its i-th stride-2 gauss5
+  // reduction. The search runs on views [first, top]; the full-resolution
+  // page is only thresholded when it is small.
+  ConvParams reduce;
+  reduce.stride = 2;
+  reduce.padding = Padding::EDGE;
+  reduce.viz = VizMode::None;
+  reduce.threads = threads;
+  const Kernel gauss5 = Kernel::from_builtin("gauss5");
+  std::vector<Image> reduced;
+  std::vector<ConstImageView> views{input.channel(0)};
+  while (std::min(views.back().width(), views.back().height()) >= 2 * kCoarseSize) {
+    reduced.push_back(Convolver::convolve(views.back(), gauss5, reduce));
+    views.push_back(reduced.back());
+  }
+  const int top = (int)views.size() - 1;
+  const int first = top > 0 && views[1].width() >= kFineSize ? 1 : 0;
+
+  const float threshold = otsu_threshold(views[top]);
+  if (threshold < 0.0f) return 0.0;
+
+  // Coarse: every step across +-max_degrees on the top level.
+  const double t_max = std::tan(max_degrees * kPi<double> / 180.0);
+  InkCells ink = ink_cells(views[top], threshold, threads);
+  if (ink.total == 0) return 0.0;
+  double step = shear_step(ink);
+  std::vector<double> candidates, scores;
+  const int coarse = (int)std::ceil(t_max / step);
+  for (int k = -coarse; k <= coarse; ++k) candidates.push_back(std::clamp(k * step, -t_max, t_max));
+  int best = best_candidate(ink, candidates, scores, threads);
+  double t = candidates[best];
+
+  // Fine: each level has twice the width, so half the step; a few
+  // candidates around the best angle so far cover one step of the level
+  // above either way.
+  for (int level = top - 1; level >= first; --level) {
+    ink = ink_cells(views[level], threshold, threads);
+    step = shear_step(ink);
+    candidates.clear();
+    for (int k = -kRefineSteps; k <= kRefineSteps; ++k) candidates.push_back(std::clamp(t + k * step, -t_max, t_max));
+    best = best_candidate(ink, candidates, scores, threads);
+    t = candidates[best];
+  }
+  // Sub-step: the vertex of the parabola through the best score and its
+  // neighbours.
+  if (best > 0 && best + 1 < (int)scores.size()) {
+    const double l = scores[best - 1], c = scores[best], r = scores[best + 1];
+    const double curve = l - 2.0 * c + r;
+    if (curve < 0.0) t = std::clamp(t + 0.5 * (l - r) / curve * step, -t_max, t_max);
+  }
+  const double degrees = std::atan(t) * 180.0 / kPi<double>;
+  LUMINE_TRACE_COUNT("skew.degrees", degrees);
+  return degrees;
+}
+
+Image Preprocessing::rotate(ConstImageView input, double degrees, float background, int threads) {
+  Image output(input.width(), input.height(), input.channels(), Fill::None);
+  rotate(input, output, degrees, background, threads);
+  return output;
+}
+
+// Output pixel (x, y) samples the input at (sx, sy), which moves by
+// (cos, sin) per output column. The columns whose four taps are all inside
+// the image form one interval per row, found from the two linear
+// constraints; it goes through bilinear_row, and the few columns either
+// side read `background` for the taps outside. Rows are done in tiles of
+// kRotateRows x kRotateColumns: a tile's taps then come from a few dozen
+// input rows that stay in cache, where whole output rows would sweep
+// across hundreds of them at a few degrees.
+void Preprocessing::rotate(ConstImageView input, ImageView output, double degrees, float background, int threads) {
+  constexpr int kRotateRows = 32, kRotateColumns = 256;
+  check_rotate_output(input, output);
+  LUMINE_TRACE_SCOPE("rotate", "width", input.width(), "height", input.height());
+  LUMINE_TRACE_COUNT("pixels.rotate", (double)input.width() * input.height() * input.channels());
+  if (input.empty()) return;
+  const int width = input.width(), height = input.height();
+  const double radians = degrees * kPi<double> / 180.0;
+  const double a = std::cos(radians), c = std::sin(radians);
+  const double cx = (width - 1) * 0.5, cy = (height - 1) * 0.5;
+  const detail::ConvKernels& kern = detail::conv_kernels();
+  // 32-bit tap offsets in bilinear_row
+  const bool fast = (double)height * input.stride() < 2147483647.0;
+
+  // Narrows [lo, hi) to the columns i with 0 <= f0 + d*i < limit, less one
+  // column each side to absorb the rounding of float coordinates.
+  auto inside = [](double f0, double d, double limit, double& lo, double& hi) {
+    if (d == 0.0) {
+      if (!(f0 >= 0.0 && f0 < limit)) hi = lo;
+      return;
+    }
+    const double p = -f0 / d, q = (limit - f0) / d;
+    lo = std::max(lo, std::floor(std::min(p, q)) + 2.0);
+    hi = std::min(hi, std::ceil(std::max(p, q)) - 2.0);
+  };
+  // Output columns [xa, xb) of row y; the row starts at (bx, by) and its
+  // interior is [x0, x1).
+  auto span = [&](int ch, int y, double bx, double by, int x0, int x1, int xa, int xb) {
+    float* dst = output.row(y, ch);
+    for (int x = xa; x < xb; ++x) {
+      if (x >= x0 && x < x1) {
+        const int end = std::min(x1, xb);
+        kern.bilinear_row(input.row(0, ch), input.stride(), (float)(bx + a * x), (float)(by + c * x), (float)a,
+                          (float)c, dst + x, end - x);
+        x = end - 1;
+        continue;
+      }
+      const double sx = bx + a * x, sy = by + c * x;
+      const double fsx = std::floor(sx), fsy = std::floor(sy);
+      const float fx = (float)(sx - fsx), fy = (float)(sy - fsy);
+      auto tap = [&](double tx, double ty) {
+        return tx >= 0 && tx < width && ty >= 0 && ty < height ? input.row((int)ty, ch)[(int)tx] : background;
+      };
+      const float p00 = tap(fsx, fsy), p01 = tap(fsx + 1, fsy);
+      const float p10 = tap(fsx, fsy + 1), p11 = tap(fsx + 1, fsy + 1);
+      const float top = p00 + fx * (p01 - p00), bottom = p10 + fx * (p11 - p10);
+      dst[x] = top + fy * (bottom - top);
+    }
+  };
+
+  ThreadPool::global().parallel_for(0, (height + kRotateRows - 1) / kRotateRows, 1, [&](int first, int last) {
+    double bx[kRotateRows], by[kRotateRows];
+    int x0[kRotateRows], x1[kRotateRows];
+    for (int band = first; band < last; ++band) {
+      const int ya = band * kRotateRows, rows = std::min(kRotateRows, height - ya);
+      for (int r = 0; r < rows; ++r) {
+        const int y = ya + r;
+        bx[r] = cx - a * cx - c * (y - cy);
+        by[r] = cy - c * cx + a * (y - cy);
+        double lo = 0.0, hi = fast ? (double)width : 0.0;
+        inside(bx[r], a, width - 1, lo, hi);
+        inside(by[r], c, height - 1, lo, hi);
+        x0[r] = (int)std::clamp(lo, 0.0, (double)width);
+        x1[r] = std::max(x0[r], (int)std::clamp(hi, 0.0, (double)width));
+      }
+      for (int ch = 0; ch < input.channels(); ++ch)
+        for (int xa = 0; xa < width; xa += kRotateColumns)
+          for (int r = 0; r < rows; ++r)
+            span(ch, ya + r, bx[r], by[r], x0[r], x1[r], xa, std::min(width, xa + kRotateColumns));
+    }
+  }, ThreadPool::resolve(threads));
+}
+
+Image Preprocessing::deskew(ConstImageView input, double max_degrees, int threads) {
+  LUMINE_TRACE_SCOPE("deskew", "width", input.width(), "height", input.height());
+  const double skew = estimate_skew(input, max_degrees, threads);
+  if (std::abs(skew) < kMinDeskewDegrees) return Image(input);
+  return rotate(input, -skew, 1.0f, threads);
+}
+
+}
@@ -0,0 +1,61 @@
+#include "fft.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace lumine::detail {
+
+FFT::FFT(int n) : m_n(n) {
+    if (n < 1 || (n & (n - 1)) != 0) throw std::runtime_error("FFT size must be a power of two");
+    int bits = 0;
+    while ((1 << bits) < n) ++bits;
+    m_rev.resize(n);
+    for (int i = 0; i < n; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        m_rev[i] = r;
+    }
+    const double pi = std::acos(-1.0);
+    m_twiddle.resize(n / 2);
+    for (int k = 0; k < n / 2; ++k) m_twiddle[k] = std::polar(1.0, -2.0 * pi * k / n);
+}
+
+void FFT::transform(cplx* data, bool inverse) const {
+    const int n = m_n;
+    for (int i = 0; i < n; ++i)
+        if (i < m_rev[i]) std::swap(data[i], data[m_rev[i]]);
+
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len / 2;
+        const int step = n / len;
+        for (int i = 0; i < n; i += len) {
+            for (int j = 0; j < half; ++j) {
+                cplx w = m_twiddle[(size_t)j * step];
+                if (inverse) w = std::conj(w);
+                // written out: std::complex multiply carries NaN/inf checks
+                const cplx& b = data[i + j + half];
+                const cplx t(b.real() * w.real() - b.imag() * w.imag(),
+                             b.real() * w.imag() + b.imag() * w.real());
+                const cplx u = data[i + j];
+                data[i + j] = u + t;
+                data[i + j + half] = u - t;
+            }
+        }
+    }
+    if (inverse) {
+        const double scale = 1.0 / n;
+        for (int i = 0; i < n; ++i) data[i] *= scale;
+    }
+}
+
+void FFT::transform_2d(cplx* data, cplx* scratch, bool inverse) const {
+    const int n = m_n;
+    for (int y = 0; y < n; ++y) transform(data + (size_t)y * n, inverse);
+    for (int x = 0; x < n; ++x) {
+        for (int y = 0; y < n; ++y) scratch[y] = data[(size_t)y * n + x];
+        transform(scratch, inverse);
+        for (int y = 0; y < n; ++y) data[(size_t)y * n + x] = scratch[y];
+    }
+}
+
+}
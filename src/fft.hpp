@@ -0,0 +1,35 @@
+#pragma once
+#include <complex>
+#include <vector>
+
+// Minimal in-tree FFT used by the large-kernel convolution path: an
+// iterative radix-2 transform of a fixed power-of-two size, in double so the
+// overlap-save result stays close to the direct float sum.
+namespace lumine::detail {
+
+using cplx = std::complex<double>;
+
+class FFT {
+    public:
+        explicit FFT(int n); // n must be a power of two
+
+        int size() const { return m_n; }
+
+        // In place; inverse() includes the 1/n scale.
+        void forward(cplx* data) const { transform(data, false); }
+        void inverse(cplx* data) const { transform(data, true); }
+
+        // n x n row-major 2D transform. `scratch` holds at least n values.
+        void forward_2d(cplx* data, cplx* scratch) const { transform_2d(data, scratch, false); }
+        void inverse_2d(cplx* data, cplx* scratch) const { transform_2d(data, scratch, true); }
+
+    private:
+        void transform(cplx* data, bool inverse) const;
+        void transform_2d(cplx* data, cplx* scratch, bool inverse) const;
+
+        int m_n{0};
+        std::vector<int> m_rev;     // bit-reversal permutation
+        std::vector<cplx> m_twiddle; // exp(-2*pi*i*k/n), k < n/2
+};
+
+}
@@ -0,0 +1,123 @@
+#include "lumine/filter_bank.hpp"
+#include "lumine/trace.hpp"
+#include "row_ops.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace lumine {
+
+FilterBank::FilterBank(std::vector<Kernel> kernels, BankReduce reduce)
+: m_kernels(std::move(kernels)), m_reduce(reduce) {
+    if (m_kernels.empty()) throw std::runtime_error("FilterBank needs at least one kernel");
+    for (const Kernel& K : m_kernels)
+        if (K.width() != m_kernels[0].width() || K.height() != m_kernels[0].height())
+            throw std::runtime_error("FilterBank kernels must all have the same size");
+    if (m_reduce == BankReduce::Orientation && m_kernels.size() != 2)
+        throw std::runtime_error("FilterBank orientation needs exactly two kernels");
+    m_setup = std::make_shared<const detail::BankSetup>(detail::make_bank_setup(m_kernels));
+}
+
+// The eight Kirsch compass kernels: the 5-5-5 edge of the 3x3 ring rotated
+// in 45 degree steps.
+static std::vector<Kernel> make_kirsch() {
+    static const int ring[8][2] = {{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}, {1, 2}, {0, 2}, {0, 1}};
+    std::vector<Kernel> ks;
+    for (int d = 0; d < 8; ++d) {
+        std::vector<float> w(9, -3.0f);
+        w[4] = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            const int* p = ring[(d + i) % 8];
+            w[(size_t)p[1]*3 + p[0]] = 5.0f;
+        }
+        ks.emplace_back(3, 3, std::move(w));
+    }
+    return ks;
+}
+
+FilterBank FilterBank::from_builtin(const std::string& name) {
+    std::string n = name; std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c){ return std::tolower(c); });
+    const Kernel sobel_x = Kernel::from_builtin("sobel_x"), sobel_y = Kernel::from_builtin("sobel_y");
+    if (n == "sobel_mag") return FilterBank({sobel_x, sobel_y}, BankReduce::Magnitude);
+    if (n == "sobel_dir") return FilterBank({sobel_x, sobel_y}, BankReduce::Orientation);
+    if (n == "scharr_mag")
+        return FilterBank({Kernel(3, 3, {-3, 0, 3, -10, 0, 10, -3, 0, 3}),
+                           Kernel(3, 3, {-3, -10, -3, 0, 0, 0, 3, 10, 3})}, BankReduce::Magnitude);
+    if (n == "prewitt_mag")
+        return FilterBank({Kernel(3, 3, {-1, 0, 1, -1, 0, 1, -1, 0, 1}),
+                           Kernel(3, 3, {-1, -1, -1, 0, 0, 0, 1, 1, 1})}, BankReduce::Magnitude);
+    if (n == "kirsch_max") return FilterBank(make_kirsch(), BankReduce::Max);
+    throw std::runtime_error("Unknown builtin filter bank: " + name);
+}
+
+bool FilterBank::is_builtin(const std::string& name) {
+    std::string n = name; std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c){ return std::tolower(c); });
+    return n == "sobel_mag" || n == "sobel_dir" || n == "scharr_mag" || n == "prewitt_mag" || n == "kirsch_max";
+}
+
+Size FilterBank::output_size(int width, int height, int stride) const {
+    return detail::conv_output_size(width, height, this->width(), this->height(), stride);
+}
+
+std::vector<Image> FilterBank::apply_each(ConstImageView input, const ConvParams& params) const {
+    if (!m_setup) throw std::runtime_error("FilterBank is empty");
+    LUMINE_TRACE_SCOPE("filter_bank", "width", input.width(), "height", input.height());
+    LUMINE_TRACE_COUNT("pixels.convolved", (double)input.width() * input.height() * input.channels() * size());
+    const int stride = std::max(1, params.stride);
+    const Size size = output_size(input.width(), input.height(), stride);
+    std::vector<Image> out;
+    for (int k = 0; k < this->size(); ++k) out.emplace_back(size.width, size.height, input.channels(), Fill::None);
+    if (out[0].view().empty()) return out;
+
+    // run_roi for several outputs: rows go straight into them unless the
+    // window is wider than the ROI
+    const detail::RoiWindow<float> w = detail::roi_window(input, detail::conv_reach(m_kernels[0], stride), params.padding);
+    const int a = w.out_y, b = w.out_y + size.height;
+    const int width = output_size(w.view.width(), 1, stride).width;
+    const bool direct = w.out_x == 0 && width == size.width;
+    std::vector<Image> rows;
+    std::vector<detail::RowSink> sinks;
+    for (int k = 0; k < this->size(); ++k) {
+        if (!direct) rows.emplace_back(width, size.height, input.channels(), Fill::None);
+        sinks.push_back(detail::RowSink{direct ? out[k].view() : rows[k].view(), a});
+    }
+    detail::filter_bank_rows(*m_setup, BankReduce::None, params.padding, stride, detail::Strip::whole(w.view),
+                             sinks.data(), a, b, params.threads);
+    for (int k = 0; k < this->size(); ++k) {
+        if (!direct)
+            for (int c = 0; c < input.channels(); ++c)
+                for (int y = 0; y < size.height; ++y)
+                    std::copy_n(rows[k].row(y, c) + w.out_x, size.width, out[k].row(y, c));
+        detail::apply_viz(out[k], params.viz, params.threads);
+    }
+    return out;
+}
+
+Image FilterBank::apply(ConstImageView input, const ConvParams& params) const {
+    const Size size = output_size(input.width(), input.height(), params.stride);
+    Image out(size.width, size.height, input.channels(), Fill::None);
+    apply(input, out, params);
+    return out;
+}
+
+void FilterBank::apply(ConstImageView input, ImageView output, const ConvParams& params) const {
+    if (!m_setup) throw std::runtime_error("FilterBank is empty");
+    if (m_reduce == BankReduce::None)
+        throw std::runtime_error("FilterBank::apply needs a reduction; use apply_each for separate outputs");
+    const int stride = std::max(1, params.stride);
+    const Size size = output_size(input.width(), input.height(), stride);
+    if (output.width() != size.width || output.height() != size.height || output.channels() != input.channels())
+        throw std::runtime_error("FilterBank::apply: output view has the wrong shape");
+    LUMINE_TRACE_SCOPE("filter_bank", "width", input.width(), "height", input.height());
+    LUMINE_TRACE_COUNT("pixels.convolved", (double)input.width() * input.height() * input.channels() * this->size());
+    detail::run_roi(input, output, detail::conv_reach(m_kernels[0], stride), params.padding,
+                    [&](int w) { return output_size(w, 1, stride).width; },
+                    [&](ConstImageView src, ImageView dst, int a, int b) {
+        const detail::RowSink sink{dst, a};
+        detail::filter_bank_rows(*m_setup, m_reduce, params.padding, stride, detail::Strip::whole(src), &sink, a, b,
+                                 params.threads);
+    });
+    detail::apply_viz(output, params.viz, params.threads);
+}
+
+}
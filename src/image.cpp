@@ -1,5 +1,8 @@
 #include "lumine/image.hpp"
+#include "lumine/buffer_pool.hpp"
+#include "lumine/trace.hpp"
 #include <stdexcept>
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
 
@@ -10,72 +13,171 @@
 
 namespace lumine {
 
-Image::Image(int w, int h, int c): m_width(w), m_height(h), m_channels(c), m_data((size_t)w*h*c, 0.0f) {}
+template <typename T>
+BasicImage<T>::BasicImage(int w, int h, int c, Fill fill, int halo) {
+    allocate(w, h, c, halo);
+    if (fill == Fill::Zero && m_block)
+        std::memset(m_block.get(), 0, sizeof(T) * m_plane * m_channels);
+}
 
-Image Image::load(const std::string& path, bool force_grayscale) {
-    int w, h, comp;
-    stbi_uc* pixels = stbi_load(path.c_str(), &w, &h, &comp, force_grayscale ? 1 : 0);
-    if (!pixels) throw std::runtime_error("Failed to load image: " + path);
+template <typename T>
+BasicImage<T>::BasicImage(const BasicImage& other) {
+    allocate(other.m_width, other.m_height, other.m_channels, other.m_halo);
+    if (m_block) std::memcpy(m_block.get(), other.m_block.get(), sizeof(T) * m_plane * m_channels);
+}
 
-    int ch = force_grayscale ? 1 : comp;
-    if (ch != 1 && ch != 3 && ch != 4) {
-        stbi_image_free(pixels);
-        throw std::runtime_error("Unsupported number of channels: " + std::to_string(ch));
+template <typename T>
+BasicImage<T>::BasicImage(BasicImageView<const T> view) {
+    allocate(view.width(), view.height(), view.channels(), 0);
+    for (int c = 0; c < m_channels; ++c)
+        for (int y = 0; y < m_height; ++y) std::copy_n(view.row(y, c), m_width, row(y, c));
+}
+
+template <typename T>
+BasicImage<T>& BasicImage<T>::operator=(const BasicImage& other) {
+    if (this != &other) *this = BasicImage(other);
+    return *this;
+}
+
+// Plane layout: `halo` rows above and below, and on each row a left margin
+// of at least `halo` samples rounded up so that x = 0 is 64-byte aligned.
+template <typename T>
+void BasicImage<T>::allocate(int w, int h, int c, int halo) {
+    if (w < 0 || h < 0 || c < 0 || halo < 0) throw std::runtime_error("Invalid image dimensions");
+    constexpr size_t align = BufferPool::kAlignment / sizeof(T);
+    auto round_up = [&](size_t n) { return (n + align - 1) / align * align; };
+    m_width = w; m_height = h; m_channels = c; m_halo = halo;
+    const size_t left = round_up((size_t)halo);
+    m_stride = round_up(left + (size_t)w + halo);
+    m_plane = m_stride * ((size_t)h + 2*(size_t)halo);
+    m_block.reset();
+    m_origin = nullptr;
+    if ((size_t)w * h * c == 0) { m_stride = w; m_plane = (size_t)w*h; return; }
+    m_block = BufferPool::global().acquire(sizeof(T) * m_plane * c);
+    m_origin = static_cast<T*>(m_block.get()) + halo*m_stride + left;
+}
+
+template <typename T>
+void BasicImage<T>::fill_halo(Padding padding) {
+    const int r = m_halo;
+    if (r == 0 || !m_origin) return;
+    for (int c = 0; c < m_channels; ++c) {
+        for (int y = 0; y < m_height; ++y) {
+            T* p = row(y, c);
+            const T lo = padding == Padding::EDGE ? p[0] : T{}, hi = padding == Padding::EDGE ? p[m_width - 1] : T{};
+            std::fill(p - r, p, lo);
+            std::fill(p + m_width, p + m_width + r, hi);
+        }
+        for (int k = 1; k <= r; ++k) {
+            T* above = row(-k, c) - r;
+            T* below = row(m_height - 1 + k, c) - r;
+            if (padding == Padding::EDGE) {
+                std::copy_n(row(0, c) - r, m_width + 2*r, above);
+                std::copy_n(row(m_height - 1, c) - r, m_width + 2*r, below);
+            } else {
+                std::fill_n(above, m_width + 2*r, T{});
+                std::fill_n(below, m_width + 2*r, T{});
+            }
+        }
     }
+}
 
-    Image img(w, h, ch==4?3:ch);
+// Deinterleaves stb's pixels (1, 3 or 4 components; alpha dropped).
+template <typename T, typename S>
+static BasicImage<T> from_interleaved(const S* pixels, int w, int h, int ch) {
+    BasicImage<T> img(w, h, ch==4?3:ch, Fill::None);
     if (ch == 1) {
         for (int i = 0; i < h; ++i)
             for (int j = 0; j < w; ++j)
-                img.at(j, i, 0) = pixels[i*w + j] / 255.0f;
+                img.at(j, i, 0) = convert_pixel<T>(pixels[(size_t)i*w + j]);
     }
     else {
         int stride = ch;
         for (int i = 0; i < h; ++i)
             for (int j = 0; j < w; ++j) {
-                const stbi_uc* p = pixels + (i*w + j)*stride;
-                img.at(j,i,0) = p[0] / 255.0f;
-                img.at(j,i,1) = p[1] / 255.0f;
-                img.at(j,i,2) = p[2] / 255.0f;
+                const S* p = pixels + ((size_t)i*w + j)*stride;
+                img.at(j,i,0) = convert_pixel<T>(p[0]);
+                img.at(j,i,1) = convert_pixel<T>(p[1]);
+                img.at(j,i,2) = convert_pixel<T>(p[2]);
             }
     }
+    return img;
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::load(const std::string& path, bool force_grayscale) {
+    LUMINE_TRACE_SCOPE("image.load");
+    int w, h, comp;
+    const int want = force_grayscale ? 1 : 0;
+    void* pixels = std::is_same_v<T, uint16_t>
+        ? (void*)stbi_load_16(path.c_str(), &w, &h, &comp, want)
+        : (void*)stbi_load(path.c_str(), &w, &h, &comp, want);
+    if (!pixels) throw std::runtime_error("Failed to load image: " + path);
+    LUMINE_TRACE_COUNT("pixels.decoded", (double)w * h);
+
+    int ch = force_grayscale ? 1 : comp;
+    if (ch != 1 && ch != 3 && ch != 4) {
+        stbi_image_free(pixels);
+        throw std::runtime_error("Unsupported number of channels: " + std::to_string(ch));
+    }
+
+    BasicImage img = std::is_same_v<T, uint16_t>
+        ? from_interleaved<T>((const uint16_t*)pixels, w, h, ch)
+        : from_interleaved<T>((const uint8_t*)pixels, w, h, ch);
         stbi_image_free(pixels);
         return img;
 }
 
-void Image::save(const std::string& path) const {
+template <typename T>
+void BasicImage<T>::save(const std::string& path) const {
+    LUMINE_TRACE_SCOPE("image.save", "width", m_width, "height", m_height);
+    LUMINE_TRACE_COUNT("pixels.encoded", (double)m_width * m_height);
     auto ends_with = [](const std::string& s, const std::string& suf){
         if(s.size()<suf.size()) return false; return std::equal(suf.rbegin(), suf.rend(), s.rbegin()); };
 
 
-    // Convert planar float [0,1] -> interleaved 8-bit RGB/Gray
+    // Convert planar samples -> interleaved 8-bit RGB/Gray
     std::vector<uint8_t> inter((size_t)m_width*m_height*(m_channels==1?1:3));
     if(m_channels==1){
         for(int y=0;y<m_height;++y) for(int x=0;x<m_width;++x){
-            float v = std::clamp(at(x,y,0), 0.0f, 1.0f);
-            inter[(size_t)y*m_width + x] = (uint8_t)(v*255.0f + 0.5f);
+            inter[(size_t)y*m_width + x] = convert_pixel<uint8_t>(at(x,y,0));
         }
     } else {
         for(int y=0;y<m_height;++y) for(int x=0;x<m_width;++x){
             for(int c=0;c<3;++c){
-                float v = std::clamp(at(x,y,c), 0.0f, 1.0f);
-                inter[((size_t)y*m_width + x)*3 + c] = (uint8_t)(v*255.0f + 0.5f);
+                inter[((size_t)y*m_width + x)*3 + c] = convert_pixel<uint8_t>(at(x,y,c));
             }
         }
     }
 
 
+    int written = 0;
     if(ends_with(path, ".png")){
         if(m_channels==1)
-            stbi_write_png(path.c_str(), m_width, m_height, 1, inter.data(), m_width);
+            written = stbi_write_png(path.c_str(), m_width, m_height, 1, inter.data(), m_width);
         else
-            stbi_write_png(path.c_str(), m_width, m_height, 3, inter.data(), m_width*3);
+            written = stbi_write_png(path.c_str(), m_width, m_height, 3, inter.data(), m_width*3);
     } else if(ends_with(path, ".jpg") || ends_with(path, ".jpeg")){
-        stbi_write_jpg(path.c_str(), m_width, m_height, (m_channels==1?1:3), inter.data(), 90);
+        written = stbi_write_jpg(path.c_str(), m_width, m_height, (m_channels==1?1:3), inter.data(), 90);
     } else if(ends_with(path, ".bmp")){
-        stbi_write_bmp(path.c_str(), m_width, m_height, (m_channels==1?1:3), inter.data());
+        written = stbi_write_bmp(path.c_str(), m_width, m_height, (m_channels==1?1:3), inter.data());
+    } else if(ends_with(path, ".pgm") || ends_with(path, ".ppm") || ends_with(path, ".pnm")){
+        // binary P5 (gray) / P6 (RGB)
+        if(std::FILE* f = std::fopen(path.c_str(), "wb")){
+            const std::string header = std::string(m_channels==1 ? "P5" : "P6") + "\n" + std::to_string(m_width) + " " +
+                                       std::to_string(m_height) + "\n255\n";
+            written = std::fwrite(header.data(), 1, header.size(), f) == header.size() &&
+                      std::fwrite(inter.data(), 1, inter.size(), f) == inter.size();
+            written = std::fclose(f) == 0 && written;
+        }
     } else {
         throw std::runtime_error("Unsupported image format for save: " + path);
     }
+    if(!written) throw std::runtime_error("Failed to write image: " + path);
+}
+
+template class BasicImage<float>;
+template class BasicImage<uint8_t>;
+template class BasicImage<uint16_t>;
+template class BasicImage<half>;
 }
-}
\ No newline at end of file
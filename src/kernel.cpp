@@ -1,9 +1,11 @@
 #include "lumine/kernel.hpp"
+#include "lumine/trace.hpp"
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <cstdlib>
 
 namespace lumine {
 
@@ -49,8 +51,56 @@ static Kernel make_gauss5() {
 }
 
 
+// gauss:<sigma>: the sampled Gaussian to 4 sigma (a tail of < 1e-4 of the
+// mass is cut), normalized, as the outer product of its 1D factor.
+static Kernel make_gauss(float sigma) {
+    const int r = (int)std::ceil(4.0f * sigma);
+    std::vector<double> g(2*r + 1);
+    double sum = 0;
+    for (int i = -r; i <= r; ++i) sum += g[i + r] = std::exp(-0.5 * i * i / ((double)sigma * sigma));
+    for (double& v : g) v /= sum;
+    const int k = 2*r + 1;
+    std::vector<float> w((size_t)k*k);
+    for (int y = 0; y < k; ++y) for (int x = 0; x < k; ++x) w[(size_t)y*k + x] = (float)(g[y] * g[x]);
+    return Kernel(k, k, std::move(w));
+}
+
+// Value after "<prefix>:" in a parametric builtin name; throws unless it is
+// a number in [lo, hi].
+static double builtin_param(const std::string& name, size_t colon, double lo, double hi) {
+    const std::string arg = name.substr(colon + 1);
+    char* end = nullptr;
+    const double v = std::strtod(arg.c_str(), &end);
+    if (arg.empty() || *end != '\0' || !(v >= lo && v <= hi)) {
+        std::ostringstream os;
+        os << "Invalid builtin kernel: " << name << " (" << name.substr(0, colon) << " takes a value in ["
+           << lo << ", " << hi << "])";
+        throw std::runtime_error(os.str());
+    }
+    return v;
+}
+
+bool Kernel::is_builtin(const std::string& name) {
+    std::string n=name; std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c){ return std::tolower(c); });
+    return n=="identity" || n=="box3" || n=="box5" || n=="sharpen" || n=="sobel_x" || n=="sobel_y" || n=="gauss5" ||
+           n.rfind("gauss:", 0) == 0 || n.rfind("box:", 0) == 0;
+}
+
 Kernel Kernel::from_builtin(const std::string& name) {
     std::string n=name; std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c){ return std::tolower(c); });
+    if(n.rfind("gauss:", 0) == 0) {
+        const float sigma = (float)builtin_param(n, 5, kMinSigma, kMaxSigma);
+        Kernel K = make_gauss(sigma);
+        K.m_blur = BlurShape{BlurShape::Kind::Gaussian, K.m_w/2, sigma};
+        return K;
+    }
+    if(n.rfind("box:", 0) == 0) {
+        const double r = builtin_param(n, 3, 1, kMaxBoxRadius);
+        if (r != std::floor(r)) throw std::runtime_error("Invalid builtin kernel: " + name + " (box radius must be an integer)");
+        Kernel K = make_box(2*(int)r + 1);
+        K.m_blur = BlurShape{BlurShape::Kind::Box, (int)r, 0.0f};
+        return K;
+    }
     if(n=="identity") return make_identity();
     if(n=="box3") return make_box(3);
     if(n=="box5") return make_box(5);
@@ -87,6 +137,7 @@ Kernel Kernel::from_string(const std::string& spec) {
 }
 
 bool Kernel::try_separable(std::vector<float>& ky, std::vector<float>& kx, float eps) const {
+    LUMINE_TRACE_SCOPE("kernel.try_separable", "width", m_w, "height", m_h);
     if (m_w==0 || m_h==0) return false;
 
     int py=-1, px=-1;
@@ -118,4 +169,77 @@ bool Kernel::try_separable(std::vector<float>& ky, std::vector<float>& kx, float
 
     return true;
 }
-}
\ No newline at end of file
+
+std::vector<SeparableTerm> Kernel::low_rank(float tolerance, float* error) const {
+    LUMINE_TRACE_SCOPE("kernel.low_rank", "width", m_w, "height", m_h);
+    if (error) *error = 0.0f;
+    std::vector<SeparableTerm> terms(1);
+    if (try_separable(terms[0].ky, terms[0].kx)) return terms;
+
+    // One-sided Jacobi: rotate column pairs of U = K (h x w) until they are
+    // orthogonal; then K = sum_i |u_i| * (u_i/|u_i|) v_i^T with V the
+    // accumulated rotations. Kernels are tiny, so plain sweeps suffice.
+    const int h = m_h, w = m_w;
+    std::vector<double> U(m_wts.begin(), m_wts.end()), V((size_t)w*w, 0.0);
+    for (int i = 0; i < w; ++i) V[(size_t)i*w + i] = 1.0;
+    auto u = [&](int y, int x) -> double& { return U[(size_t)y*w + x]; };
+    for (int sweep = 0; sweep < 60; ++sweep) {
+        bool rotated = false;
+        for (int p = 0; p < w; ++p) {
+            for (int q = p + 1; q < w; ++q) {
+                double alpha = 0, beta = 0, gamma = 0;
+                for (int y = 0; y < h; ++y) {
+                    alpha += u(y, p)*u(y, p);
+                    beta += u(y, q)*u(y, q);
+                    gamma += u(y, p)*u(y, q);
+                }
+                if (std::fabs(gamma) <= 1e-15 * std::sqrt(alpha*beta)) continue;
+                rotated = true;
+                const double zeta = (beta - alpha) / (2.0*gamma);
+                const double t = (zeta >= 0 ? 1.0 : -1.0) / (std::fabs(zeta) + std::sqrt(1.0 + zeta*zeta));
+                const double c = 1.0 / std::sqrt(1.0 + t*t), sn = c*t;
+                for (int y = 0; y < h; ++y) {
+                    const double up = u(y, p), uq = u(y, q);
+                    u(y, p) = c*up - sn*uq;
+                    u(y, q) = sn*up + c*uq;
+                }
+                for (int x = 0; x < w; ++x) {
+                    const double vp = V[(size_t)x*w + p], vq = V[(size_t)x*w + q];
+                    V[(size_t)x*w + p] = c*vp - sn*vq;
+                    V[(size_t)x*w + q] = sn*vp + c*vq;
+                }
+            }
+        }
+        if (!rotated) break;
+    }
+
+    std::vector<double> sigma(w, 0.0);
+    std::vector<int> order(w);
+    double total = 0;
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y) sigma[x] += u(y, x)*u(y, x);
+        total += sigma[x];
+        sigma[x] = std::sqrt(sigma[x]);
+        order[x] = x;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b){ return sigma[a] > sigma[b]; });
+
+    // Keep terms until the discarded energy fits the budget.
+    const double budget = (double)tolerance*tolerance * total;
+    double rest = total;
+    terms.clear();
+    for (int i = 0; i < w && rest > budget; ++i) {
+        const int x = order[i];
+        if (sigma[x] == 0.0) break;
+        SeparableTerm t;
+        t.ky.resize(h);
+        t.kx.resize(w);
+        for (int y = 0; y < h; ++y) t.ky[y] = (float)u(y, x); // = sigma * left vector
+        for (int j = 0; j < w; ++j) t.kx[j] = (float)V[(size_t)j*w + x];
+        terms.push_back(std::move(t));
+        rest -= sigma[x]*sigma[x];
+    }
+    if (error) *error = total > 0 ? (float)std::sqrt(std::max(0.0, rest) / total) : 0.0f;
+    return terms;
+}
+}
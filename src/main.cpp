@@ -1,37 +1,92 @@
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include "lumine/batch.hpp"
 #include "lumine/image.hpp"
 #include "lumine/kernel.hpp"
 #include "lumine/convolver.hpp"
+#include "lumine/conv_plan.hpp"
+#include "lumine/filter_bank.hpp"
 #include "lumine/types.hpp"
 #include "lumine/preprocessing.hpp"
+#include "lumine/pipeline.hpp"
+#include "lumine/stream.hpp"
+#include "lumine/trace.hpp"
+#include "serve.hpp"
 
 
 using namespace lumine;
 
 
+// --trace: stops recording when the run ends (however it ends), writes the
+// Chrome trace and prints the summary table to stderr
+struct TraceOutput {
+    std::string path;
+    ~TraceOutput(){
+        if(path.empty()) return;
+        trace::stop();
+        try {
+            trace::write_chrome_trace(path);
+            std::cerr << trace::summary() << "Wrote trace: " << path << "\n";
+        } catch(const std::exception& e){ std::cerr << "Error: " << e.what() << "\n"; }
+    }
+};
+
 static void print_usage(){
-    std::cout << "Usage: image_convolution <input> <output> --kernel <name|spec> [--stride N] [--padding zero|edge] [--grayscale]\n";
-    std::cout << " Builtin kernels: identity, box3, box5, sharpen, sobel_x, sobel_y, gauss5\n";
+    std::cout << "Usage: image_convolution <input> <output> --kernel <name|spec> [--stride N] [--padding zero|edge] [--grayscale] [--threads N] [--algo auto|direct|separable|fft|recursive] [--rank-tolerance T] [--wisdom FILE] [--u8] [--stream] [--trace OUT.json]\n";
+    std::cout << "       image_convolution --serve [--socket PATH] [--jobs N] [--threads N]   (JSON jobs, one per line)\n";
+    std::cout << "       image_convolution --batch <dir|glob|manifest> <outdir> --kernel <name|spec> [--jobs N] [--format png|jpg|bmp] [options]\n";
+    std::cout << " Preprocessing: [--deskew] [--denoise] [--denoise-radius R] [--binarize] [--binarize-k K] [--dump-stages]\n";
+    std::cout << " Builtin kernels: identity, box3, box5, sharpen, sobel_x, sobel_y, gauss5,\n";
+    std::cout << "                  gauss:<sigma> (0.5-100), box:<radius> (1-500)  (cost independent of size)\n";
+    std::cout << " Filter banks (one pass): sobel_mag, sobel_dir, scharr_mag, prewitt_mag, kirsch_max\n";
     std::cout << " Custom spec example: \"1 0 -1; 1 0 -1; 1 0 -1\"\n";
 }
 
 
 int main(int argc, char** argv){
+    // --serve: long-running worker fed with JSON jobs (see serve.hpp)
+    if(argc >= 2 && std::string(argv[1]) == "--serve"){
+        ServeOptions options;
+        for(int i=2;i<argc;++i){
+            std::string a = argv[i];
+            if(a=="--socket" && i+1<argc){ options.socket_path = argv[++i]; }
+            else if(a=="--jobs" && i+1<argc){ options.workers = std::max(0, std::stoi(argv[++i])); }
+            else if(a=="--threads" && i+1<argc){ options.threads = std::max(1, std::stoi(argv[++i])); }
+            else { std::cerr << "Unknown arg: " << a << "\n"; print_usage(); return 1; }
+        }
+        try { return serve(options); }
+        catch(const std::exception& e){ std::cerr << "Error: " << e.what() << "\n"; return 2; }
+    }
     if(argc < 5){ print_usage(); return 1; }
-    std::string in = argv[1];
-    std::string out = argv[2];
+    // --batch: <in> is a directory, glob or manifest and <out> a directory
+    const bool batch = std::string(argv[1]) == "--batch";
+    if(batch && argc < 6){ print_usage(); return 1; }
+    std::string in = argv[batch ? 2 : 1];
+    std::string out = argv[batch ? 3 : 2];
 
 
     std::string kernel_arg;
-    int stride=1; Padding pad=Padding::ZERO; bool gray=false; VizMode viz=VizMode::Clamp;
-    bool denoise = false, binarize = false;
+    int stride=1; Padding pad=Padding::ZERO; bool gray=false; VizMode viz=VizMode::Clamp; bool viz_set=false;
+    bool denoise = false, binarize = false, deskew = false;
     int window_size = 15;
+    int threads = 0;
+    ConvAlgo algo = ConvAlgo::Auto;
+    float rank_tolerance = 1e-6f;
+    int denoise_radius = 1;
+    bool dump_stages = false;
+    std::string wisdom;
+    bool u8 = false;
     float k = 0.2f;
+    int jobs = 0;
+    std::string format;
+    bool stream = false;
+    std::string trace_path;
 
 
-    for(int i=3;i<argc;++i){
+    for(int i=batch ? 4 : 3;i<argc;++i){
         std::string a = argv[i];
         if(a=="--kernel" && i+1<argc){ kernel_arg = argv[++i]; }
         else if(a=="--stride" && i+1<argc){ stride = std::max(1, std::stoi(argv[++i])); }
@@ -39,32 +94,134 @@ int main(int argc, char** argv){
         else if(a=="--grayscale"){ gray=true; }
         else if(a=="--viz" && i+1<argc){ 
             std::string m = argv[++i];
+            viz_set = true;
             if(m == "normalize") viz = VizMode::Normalize;
             else if(m == "none") viz = VizMode::None;
             else viz = VizMode::Clamp;
         }
         else if (a == "--grayscale") { gray = true; }
+        else if (a == "--deskew") { deskew = true; }
         else if (a == "--denoise") { denoise = true; }
+        else if (a == "--denoise-radius" && i + 1 < argc) { denoise = true; denoise_radius = std::stoi(argv[++i]); }
         else if (a == "--binarize") { binarize = true; }
         else if (a == "--grayscale-window-size" && i + 1 < argc) { window_size = std::stoi(argv[++i]); }
         else if (a == "--binarize-k" && i + 1 < argc) { k = std::stof(argv[++i]); }
+        else if (a == "--threads" && i + 1 < argc) { threads = std::max(0, std::stoi(argv[++i])); }
+        else if (a == "--algo" && i + 1 < argc) {
+            std::string m = argv[++i];
+            if (m == "direct") algo = ConvAlgo::Direct;
+            else if (m == "separable") algo = ConvAlgo::Separable;
+            else if (m == "fft") algo = ConvAlgo::FFT;
+            else if (m == "recursive") algo = ConvAlgo::Recursive;
+            else if (m == "auto") algo = ConvAlgo::Auto;
+            else { std::cerr << "--algo must be auto, direct, separable, fft or recursive\n"; return 1; }
+        }
+        else if (a == "--rank-tolerance" && i + 1 < argc) { rank_tolerance = std::stof(argv[++i]); }
+        else if (a == "--wisdom" && i + 1 < argc) { wisdom = argv[++i]; }
+        else if (a == "--u8") { u8 = true; }
+        else if (a == "--dump-stages") { dump_stages = true; }
+        else if (!batch && a == "--stream") { stream = true; }
+        else if (a == "--trace" && i + 1 < argc) { trace_path = argv[++i]; }
+        else if (batch && a == "--jobs" && i + 1 < argc) { jobs = std::max(0, std::stoi(argv[++i])); }
+        else if (batch && a == "--format" && i + 1 < argc) { format = std::string(".") + argv[++i]; }
         else { std::cerr << "Unknown arg: " << a << "\n"; print_usage(); return 1; }
     }
     if(kernel_arg.empty()) { std::cerr << "--kernel is required\n"; return 1; }
 
 
+    TraceOutput trace_output;
     try{
-        Image img = Image::load(in, gray);
-        if (denoise) img = Preprocessing::denoise(img);
-        if (binarize) img = Preprocessing::sauvola_binarization(img, k, window_size);
-        if (gray) img = Preprocessing::grayscale(img);
+        if (!trace_path.empty()) {
+            if (!trace::compiled_in()) throw std::runtime_error("--trace: built with LUMINE_ENABLE_TRACE=OFF");
+            trace::start();
+            trace_output.path = trace_path;
+        }
+        // a filter bank name (sobel_mag, ...) runs its kernels in one pass
+        const bool bank = FilterBank::is_builtin(kernel_arg);
         Kernel K;
-        try { K = Kernel::from_builtin(kernel_arg); }
-        catch(...) { K = Kernel::from_string(kernel_arg); }
+        if (!bank) K = Kernel::is_builtin(kernel_arg) ? Kernel::from_builtin(kernel_arg) : Kernel::from_string(kernel_arg);
 
+        ConvParams params; params.stride=stride; params.padding=pad; params.viz=viz; params.threads=threads; params.algo=algo; params.rank_tolerance=rank_tolerance;
+        if (u8 && (denoise || binarize || bank)) throw std::runtime_error("--u8 supports convolution only");
+        if (batch && dump_stages) throw std::runtime_error("--dump-stages is not available with --batch");
+        if (stream && (u8 || dump_stages)) throw std::runtime_error("--stream cannot be combined with --u8 or --dump-stages");
+        if (deskew && (stream || u8)) throw std::runtime_error("--deskew needs the whole float image: not with --stream or --u8");
 
-        ConvParams params; params.stride=stride; params.padding=pad; params.viz=viz;
-        Image outimg = Convolver::convolve(img, K, params);
+        // grayscale -> denoise -> binarize -> convolve, fused over strips;
+        // --dump-stages taps the intermediate results to disk
+        Pipeline pipeline;
+        if (gray) { pipeline.grayscale(); if (dump_stages) pipeline.tap("gray.jpg"); }
+        if (denoise) { pipeline.denoise(denoise_radius, Padding::EDGE); if (dump_stages) pipeline.tap("denoise.jpg"); }
+        if (binarize) { pipeline.binarize(k, window_size); if (dump_stages) pipeline.tap("sauvola_binarization.jpg"); }
+        // sobel_dir's radians go onto [0, 1] unless --viz says otherwise
+        if (bank) pipeline.filter_bank(FilterBank::from_builtin(kernel_arg), params, !viz_set);
+        else pipeline.convolve(K, params);
+
+        if (batch) {
+            // many images at once, one thread each unless --threads says otherwise
+            const int image_threads = threads > 0 ? threads : 1;
+            ConvParams batch_params = params; batch_params.threads = image_threads;
+            if (!wisdom.empty()) ConvPlan::load_wisdom(wisdom);
+            const std::vector<BatchJob> job_list = list_batch_jobs(in, out, format);
+            std::filesystem::create_directories(out);
+            BatchOptions options; options.workers = jobs; options.force_grayscale = gray;
+            size_t failed = 0;
+            auto report = [&](const BatchResult& r) {
+                if (!r.ok()) { ++failed; std::cerr << "Error: " << r.input << ": " << r.error << "\n"; }
+            };
+            const auto t0 = std::chrono::steady_clock::now();
+            if (u8)
+                run_batch<uint8_t>(job_list, [&](const Image8& img) { return Convolver::convolve(img, K, batch_params); },
+                                   options, report);
+            else
+                run_batch<float>(job_list, [&](const Image& img) {
+                    if (deskew) return pipeline.run(Preprocessing::deskew(img, 5.0, image_threads), image_threads);
+                    return pipeline.run(img, image_threads);
+                }, options, report);
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "Processed " << job_list.size() << " images (" << failed << " failed) in " << secs << " s ("
+                      << (secs > 0 ? job_list.size() / secs : 0.0) << " images/s)\n";
+            return failed ? 2 : 0;
+        }
+
+        // --u8: keep the image in 8 bits and convolve in fixed point
+        if (u8) {
+            Image8 outimg = Convolver::convolve(Image8::load(in, gray), K, params);
+            outimg.save(out);
+            std::cout << "Wrote: " << out << " (" << outimg.width() << "x" << outimg.height() << ", c=" << outimg.channels() << ")\n";
+            return 0;
+        }
+
+        // --stream: read, process and write a few strips at a time, for
+        // images too large to hold in memory
+        if (stream) {
+            std::unique_ptr<ImageReader> reader = ImageReader::open(in, gray);
+            // measuring would take a full-size image: only reuse wisdom
+            if (!wisdom.empty()) ConvPlan::load_wisdom(wisdom);
+            const Pipeline::Shape shape = pipeline.output_shape({reader->width(), reader->height(), reader->channels()});
+            std::unique_ptr<ImageWriter> writer = ImageWriter::open(out, shape.width, shape.height, shape.channels);
+            pipeline.run(*reader, *writer, threads);
+            std::cout << "Wrote: " << out << " (" << shape.width << "x" << shape.height << ", c=" << shape.channels << ")\n";
+            return 0;
+        }
+
+        Image img = Image::load(in, gray);
+        // --deskew: rotate the page level before the pipeline, which works
+        // on strips and cannot see the whole page
+        if (deskew) {
+            img = Preprocessing::deskew(img, 5.0, threads);
+            if (dump_stages) img.save("deskew.jpg");
+        }
+
+        // --wisdom: reuse measured plans from FILE, tune this shape if it is
+        // new, and write the result back for the next run
+        if (!wisdom.empty() && !bank) {
+            ConvPlan::load_wisdom(wisdom);
+            const int channels = (gray || binarize) ? 1 : img.channels();
+            ConvPlan(K, img.width(), img.height(), channels, params, ConvPlan::Tuning::Measure);
+            ConvPlan::save_wisdom(wisdom);
+        }
+        Image outimg = pipeline.run(img, threads);
         outimg.save(out);
         std::cout << "Wrote: " << out << " (" << outimg.width() << "x" << outimg.height() << ", c=" << outimg.channels() << ")\n";
         return 0;
@@ -0,0 +1,567 @@
+#include "lumine/pipeline.hpp"
+#include "lumine/conv_plan.hpp"
+#include "lumine/preprocessing.hpp"
+#include "lumine/stream.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "row_ops.hpp"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace lumine {
+
+using detail::RowRange;
+using detail::RowSink;
+using detail::Strip;
+using Shape = Pipeline::Shape;
+
+struct Pipeline::Stage {
+    enum class Kind { Grayscale, Denoise, Binarize, Convolve, FilterBank, Levels };
+
+    Kind kind{Kind::Grayscale};
+    int radius{1};
+    Padding padding{Padding::EDGE};
+    float k{0.2f};
+    int window_size{15};
+    float gain{1.0f}, offset{0.0f}; // Levels
+    Kernel kernel; // FilterBank: the bank's first kernel (footprint)
+    ConvParams conv;
+    lumine::FilterBank bank;
+
+    // Convolve: plans by input shape, kept across runs so a pipeline applied
+    // to many images of a few shapes resolves its strategy once per shape.
+    mutable std::mutex plan_mutex;
+    mutable std::map<std::array<int, 4>, std::shared_ptr<const ConvPlan>> plans;
+
+    // `streaming` plans never hold whole columns: a recursive Gaussian that
+    // Auto picked becomes the separable FIR, and an explicit one throws.
+    std::shared_ptr<const ConvPlan> plan_for(const Shape& in, bool streaming) const {
+        constexpr size_t kMaxPlans = 32;
+        std::lock_guard<std::mutex> lock(plan_mutex);
+        const std::array<int, 4> key{in.width, in.height, in.channels, streaming};
+        auto it = plans.find(key);
+        if (it != plans.end()) return it->second;
+        if (plans.size() >= kMaxPlans) plans.clear();
+        auto plan = std::make_shared<const ConvPlan>(kernel, in.width, in.height, in.channels, conv);
+        if (streaming && plan->m_setup->whole_columns) {
+            if (conv.algo != ConvAlgo::Auto)
+                throw std::runtime_error("Streaming does not support the recursive Gaussian, which reads every row "
+                                         "of the image: use algo auto or separable");
+            ConvParams fir = conv;
+            fir.algo = ConvAlgo::Separable;
+            plan = std::make_shared<const ConvPlan>(kernel, in.width, in.height, in.channels, fir);
+        }
+        plans.emplace(key, plan);
+        return plan;
+    }
+
+    Shape output_shape(const Shape& in) const {
+        switch (kind) {
+            case Kind::Grayscale: return Shape{in.width, in.height, 1};
+            case Kind::Denoise:
+            case Kind::Levels: return in;
+            case Kind::Binarize: return Shape{in.width, in.height, 1};
+            case Kind::Convolve:
+            case Kind::FilterBank: {
+                const Size s = detail::conv_output_size(in.width, in.height, kernel, conv.stride);
+                return Shape{s.width, s.height, in.channels};
+            }
+        }
+        return in;
+    }
+
+    RowRange input_rows(int a, int b, int in_height) const {
+        switch (kind) {
+            case Kind::Grayscale:
+            case Kind::Levels: return b <= a ? RowRange{0, 0} : RowRange{a, b};
+            case Kind::Denoise: return detail::median_input_rows(a, b, in_height, radius);
+            case Kind::Binarize: return detail::sauvola_input_rows(a, b, in_height, window_size);
+            case Kind::Convolve:
+            case Kind::FilterBank: return detail::conv_input_rows(a, b, in_height, kernel, conv.stride);
+        }
+        return RowRange{a, b};
+    }
+
+    // Strips are the unit of parallelism, so `threads` is 1 unless the
+    // segment is a single strip. `plan` is the segment's ConvPlan for a
+    // Convolve stage.
+    void run(const Strip& src, const RowSink& dst, int a, int b, const ConvPlan* plan, int threads) const {
+        LUMINE_TRACE_SCOPE(trace_name(), "first_row", a, "rows", b - a);
+        switch (kind) {
+            case Kind::Grayscale: detail::grayscale_rows(src, dst, a, b, threads); break;
+            case Kind::Denoise: detail::median_rows(src, dst, a, b, radius, padding, threads); break;
+            case Kind::Binarize: detail::sauvola_rows(src, dst, a, b, k, window_size, threads); break;
+            case Kind::Convolve: detail::convolve_rows(*plan->m_setup, src, dst, a, b, threads); break;
+            case Kind::FilterBank: detail::filter_bank_rows(*bank.m_setup, bank.reduce(), conv.padding, conv.stride, src, &dst, a, b, threads); break;
+            case Kind::Levels:
+                for (int c = 0; c < src.channels(); ++c)
+                    for (int y = a; y < b; ++y) {
+                        const float* in = src.row(y, c);
+                        float* out = dst.row(y, c);
+                        for (int x = 0; x < src.width(); ++x) out[x] = in[x] * gain + offset;
+                    }
+                break;
+        }
+        if ((kind == Kind::Convolve || kind == Kind::FilterBank) && conv.viz == VizMode::Clamp) {
+            const int w = dst.view.width();
+            for (int c = 0; c < dst.view.channels(); ++c)
+                for (int y = a; y < b; ++y) {
+                    float* row = dst.row(y, c);
+                    for (int x = 0; x < w; ++x) row[x] = std::clamp(row[x], 0.0f, 1.0f);
+                }
+        }
+    }
+
+    const char* trace_name() const {
+        switch (kind) {
+            case Kind::Grayscale: return "pipeline.grayscale";
+            case Kind::Denoise: return "pipeline.denoise";
+            case Kind::Binarize: return "pipeline.sauvola";
+            case Kind::Convolve: return "pipeline.convolve";
+            case Kind::FilterBank: return "pipeline.filter_bank";
+            case Kind::Levels: return "pipeline.levels";
+        }
+        return "pipeline.stage";
+    }
+
+    // Input footprint of one output pixel, for ROI windows.
+    detail::Reach reach() const {
+        switch (kind) {
+            case Kind::Grayscale:
+            case Kind::Levels: return detail::Reach{};
+            case Kind::Denoise: return detail::Reach{radius, radius, radius, radius, 1};
+            case Kind::Binarize: {
+                const int half = std::max(0, window_size / 2);
+                return detail::Reach{half, half, half, half, 1};
+            }
+            case Kind::Convolve:
+            case Kind::FilterBank: return detail::conv_reach(kernel, conv.stride);
+        }
+        return detail::Reach{};
+    }
+
+    // Whether the stage pads at the image border (Sauvola clips its window).
+    bool pads() const { return kind == Kind::Denoise || kind == Kind::Convolve || kind == Kind::FilterBank; }
+    Padding border() const { return kind == Kind::Denoise ? padding : conv.padding; }
+
+    // Normalize needs global min/max, so it ends a fused segment.
+    bool is_barrier() const {
+        return (kind == Kind::Convolve || kind == Kind::FilterBank) && conv.viz == VizMode::Normalize;
+    }
+};
+
+Pipeline& Pipeline::grayscale() {
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::Grayscale;
+    m_stages.push_back(std::move(s));
+    return *this;
+}
+
+Pipeline& Pipeline::denoise(int radius, Padding padding) {
+    if (radius <= 0) return *this;
+    if (radius > Preprocessing::kMaxDenoiseRadius)
+        throw std::runtime_error("denoise radius too large: " + std::to_string(radius));
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::Denoise;
+    s->radius = radius;
+    s->padding = padding;
+    m_stages.push_back(std::move(s));
+    return *this;
+}
+
+Pipeline& Pipeline::binarize(float k, int window_size) {
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::Binarize;
+    s->k = k;
+    s->window_size = window_size;
+    m_stages.push_back(std::move(s));
+    return *this;
+}
+
+Pipeline& Pipeline::convolve(const Kernel& kernel, const ConvParams& params) {
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::Convolve;
+    s->kernel = kernel;
+    s->conv = params;
+    m_stages.push_back(std::move(s));
+    return *this;
+}
+
+Pipeline& Pipeline::filter_bank(const FilterBank& bank, const ConvParams& params, bool unit_angles) {
+    if (bank.reduce() == BankReduce::None)
+        throw std::runtime_error("Pipeline::filter_bank needs a bank with a reduction");
+    unit_angles = unit_angles && bank.reduce() == BankReduce::Orientation;
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::FilterBank;
+    s->kernel = bank.kernels()[0];
+    s->bank = bank;
+    s->conv = params;
+    if (unit_angles) s->conv.viz = VizMode::None;
+    m_stages.push_back(std::move(s));
+    return unit_angles ? levels(0.5f / kPi<float>, 0.5f) : *this;
+}
+
+Pipeline& Pipeline::levels(float gain, float offset) {
+    auto s = std::make_shared<Stage>();
+    s->kind = Stage::Kind::Levels;
+    s->gain = gain;
+    s->offset = offset;
+    m_stages.push_back(std::move(s));
+    return *this;
+}
+
+Pipeline& Pipeline::tap(std::function<void(const Image&)> fn) {
+    m_taps.emplace_back(m_stages.size(), std::move(fn));
+    return *this;
+}
+
+Pipeline& Pipeline::tap(const std::string& path) {
+    return tap([path](const Image& img){ img.save(path); });
+}
+
+Pipeline& Pipeline::strip_rows(int rows) {
+    m_strip_rows = std::max(0, rows);
+    return *this;
+}
+
+Image Pipeline::run(ConstImageView input, int threads) const {
+    const Shape shape = output_shape(Shape{input.width(), input.height(), input.channels()});
+    Image out(shape.width, shape.height, shape.channels, Fill::None);
+    run(input, out, threads);
+    return out;
+}
+
+void Pipeline::run(ConstImageView input, ImageView output, int threads) const {
+    LUMINE_TRACE_SCOPE("pipeline.run", "width", input.width(), "height", input.height());
+    const Shape shape = output_shape(Shape{input.width(), input.height(), input.channels()});
+    if (output.width() != shape.width || output.height() != shape.height || output.channels() != shape.channels)
+        throw std::runtime_error("Pipeline::run: output does not match the pipeline's output shape");
+    Image copy;
+    for (const auto& t : m_taps) {
+        if (t.first != 0) continue;
+        if (copy.width() == 0) copy = Image(input);
+        t.second(copy);
+    }
+    if (m_stages.empty()) {
+        for (int c = 0; c < input.channels(); ++c)
+            for (int y = 0; y < input.height(); ++y) std::copy_n(input.row(y, c), input.width(), output.row(y, c));
+        return;
+    }
+
+    // Split at Normalize barriers; each segment runs fused over strips. A
+    // segment after a barrier sees only the ROI's normalized outputs, so it
+    // runs on them as an image of their own.
+    Image cur;
+    ConstImageView src = input;
+    size_t first = 0;
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        const bool last = i + 1 == m_stages.size();
+        if (!m_stages[i]->is_barrier() && !last) continue;
+        ImageView dst = output;
+        if (!last) {
+            const Shape s = output_shape_of(Shape{src.width(), src.height(), src.channels()}, first, i + 1);
+            cur = Image(s.width, s.height, s.channels, Fill::None);
+            dst = cur;
+        }
+        run_segment(src, dst, first, i + 1, threads);
+        if (m_stages[i]->is_barrier()) detail::apply_viz(dst, VizMode::Normalize, threads);
+        for (const auto& t : m_taps)
+            if (t.first == i + 1) t.second(last ? Image(ConstImageView(output)) : cur);
+        src = cur;
+        first = i + 1;
+    }
+}
+
+// Strip plan of stages [first, first + n): shapes, strip rows, the row
+// ranges each strip computes at every level and the shared ConvPlans.
+struct Pipeline::Segment {
+    std::vector<const Stage*> stages;
+    std::vector<Shape> shape;  // level j is the input of stage j (level n is the output)
+    std::vector<bool> tapped;  // levels that also go to a full-size tap image
+    int rows{0}, strips{0};
+    std::vector<RowRange> ranges, owned;
+    std::vector<std::shared_ptr<const ConvPlan>> plans;
+
+    size_t size() const { return stages.size(); }
+    const RowRange& range(int k, size_t j) const { return ranges[(size_t)k * (size() + 1) + j]; }
+    RowRange& range(int k, size_t j) { return ranges[(size_t)k * (size() + 1) + j]; }
+
+    // Runs strip k: `src` holds at least range(k, 0) of the input, `out`
+    // receives range(k, n) of the output and `taps` the owned rows of the
+    // tapped levels.
+    void run_strip(int k, const Strip& src0, const RowSink& out, std::vector<Image>& taps, int threads = 1) const {
+        const size_t n = size();
+        Image prev, cur;
+        Strip src = src0;
+        for (size_t i = 0; i < n; ++i) {
+            const RowRange r = range(k, i + 1);
+            RowSink dst = out;
+            if (i + 1 < n) {
+                cur = Image(shape[i + 1].width, r.end - r.begin, shape[i + 1].channels, Fill::None);
+                dst = RowSink{cur, r.begin};
+            }
+            stages[i]->run(src, dst, r.begin, r.end, plans[i].get(), threads);
+            if (i + 1 == n) break;
+
+            if (tapped[i + 1]) {
+                const RowRange& own = owned[(size_t)k * (n + 1) + i + 1];
+                for (int c = 0; c < cur.channels(); ++c)
+                    for (int y = own.begin; y < own.end; ++y)
+                        std::copy_n(dst.row(y, c), cur.width(), &taps[i + 1].at(0, y, c));
+            }
+            std::swap(prev, cur);
+            src = Strip{prev, r.begin, shape[i + 1].height};
+        }
+    }
+};
+
+Pipeline::Shape Pipeline::output_shape(Shape input) const {
+    return output_shape_of(input, 0, m_stages.size());
+}
+
+Pipeline::Shape Pipeline::output_shape_of(Shape input, size_t first, size_t last) const {
+    for (size_t i = first; i < last; ++i) input = m_stages[i]->output_shape(input);
+    return input;
+}
+
+Pipeline::Segment Pipeline::plan_segment(const Shape& input, size_t first, size_t last, bool streaming) const {
+    constexpr size_t kStripBytes = 1 << 20;
+    Segment seg;
+    const size_t n = last - first;
+    for (size_t i = 0; i < n; ++i) seg.stages.push_back(m_stages[first + i].get());
+    auto stage = [&](size_t i) -> const Stage& { return *seg.stages[i]; };
+
+    std::vector<Shape>& shape = seg.shape;
+    shape.resize(n + 1);
+    shape[0] = input;
+    for (size_t i = 0; i < n; ++i) shape[i + 1] = stage(i).output_shape(shape[i]);
+    const int out_h = shape[n].height;
+
+    // Intermediate levels that are tapped get a full-size image.
+    std::vector<bool>& tapped = seg.tapped;
+    tapped.assign(n + 1, false);
+    for (const auto& t : m_taps)
+        if (t.first > first && t.first < last) tapped[t.first - first] = true;
+
+    // One plan per convolution, shared by all strips.
+    seg.plans.resize(n);
+    bool whole = false;
+    for (size_t i = 0; i < n; ++i)
+        if (stage(i).kind == Stage::Kind::Convolve) {
+            seg.plans[i] = stage(i).plan_for(shape[i], streaming);
+            whole = whole || seg.plans[i]->m_setup->whole_columns;
+        }
+    // Input rows stage i reads for its output rows [o.begin, o.end); a
+    // recursive Gaussian reads all of them.
+    auto input_rows = [&](size_t i, const RowRange& o) {
+        if (seg.plans[i] && seg.plans[i]->m_setup->whole_columns && o.end > o.begin)
+            return RowRange{0, shape[i].height};
+        return stage(i).input_rows(o.begin, o.end, shape[i].height);
+    };
+
+    // Strip height: keep one strip's intermediates within kStripBytes, but
+    // tall enough that recomputed halo rows stay a minor cost.
+    int rows = m_strip_rows;
+    if (rows <= 0) {
+        size_t bytes_per_row = 0;
+        for (size_t j = 1; j < n; ++j) bytes_per_row += (size_t)shape[j].width * shape[j].channels * sizeof(float);
+        RowRange r{out_h / 2, std::min(out_h, out_h / 2 + 1)};
+        for (size_t i = n; i-- > 0;) r = stage(i).input_rows(r.begin, r.end, shape[i].height);
+        const int halo = std::max(0, r.end - r.begin - 1);
+        rows = bytes_per_row ? (int)std::min<size_t>(kStripBytes / bytes_per_row, 1 << 16) : 256;
+        rows = std::max({rows, 2 * halo, 8});
+    }
+    // A recursive Gaussian needs whole columns: the segment is one strip
+    // (whose stages run multi-threaded). Streaming plans never do.
+    if (whole) rows = out_h;
+    rows = std::max(1, std::min(rows, std::max(1, out_h)));
+    const int strips = out_h > 0 ? (out_h + rows - 1) / rows : 0;
+    seg.rows = rows;
+    seg.strips = strips;
+
+    // range(k, j): rows of level j that strip k computes (or reads, for
+    // j = 0). A tapped level additionally covers the rows the strip owns
+    // ([start_k, start_k+1) of the untapped ranges), so the tap is complete
+    // even where a strided stage skips rows.
+    seg.ranges.resize((size_t)strips * (n + 1));
+    for (int k = 0; k < strips; ++k) {
+        seg.range(k, n) = RowRange{k * rows, std::min(out_h, (k + 1) * rows)};
+        for (size_t i = n; i-- > 0;) {
+            seg.range(k, i) = input_rows(i, seg.range(k, i + 1));
+        }
+    }
+    std::vector<RowRange>& owned = seg.owned;
+    owned.resize(seg.ranges.size());
+    for (size_t j = 1; j < n; ++j) {
+        if (!tapped[j]) continue;
+        for (int k = 0; k < strips; ++k) {
+            const int begin = k == 0 ? 0 : seg.range(k, j).begin;
+            const int end = k + 1 == strips ? shape[j].height : seg.range(k + 1, j).begin;
+            owned[(size_t)k * (n + 1) + j] = RowRange{begin, std::max(begin, end)};
+        }
+    }
+    for (int k = 0; k < strips; ++k) {
+        for (size_t i = n; i-- > 0;) {
+            RowRange in = input_rows(i, seg.range(k, i + 1));
+            const RowRange& own = owned[(size_t)k * (n + 1) + i];
+            if (i > 0 && tapped[i] && own.end > own.begin) {
+                in.begin = in.end > in.begin ? std::min(in.begin, own.begin) : own.begin;
+                in.end = std::max(in.end, own.end);
+            }
+            seg.range(k, i) = in;
+        }
+    }
+    return seg;
+}
+
+// Stages [first, last) on a ROI: the segment runs on the ROI grown by the
+// stages' combined reach (roi_window), and the ROI's part of the result goes
+// to `output` and to the taps. For a whole image the window is the image.
+void Pipeline::run_segment(ConstImageView input, ImageView output, size_t first, size_t last, int threads) const {
+    // Stage i reads the previous level's pixels `reach` around each of its
+    // samples, which lie `stride` input pixels apart.
+    detail::Reach reach;
+    Padding pad = Padding::ZERO;
+    bool padded = false;
+    std::vector<int> stride{1}; // input pixels per pixel of each level
+    for (size_t i = first; i < last; ++i) {
+        const detail::Reach r = m_stages[i]->reach();
+        reach.left += r.left * reach.stride;
+        reach.top += r.top * reach.stride;
+        reach.right += r.right * reach.stride;
+        reach.bottom += r.bottom * reach.stride;
+        reach.stride *= r.stride;
+        stride.push_back(reach.stride);
+        // a stride-misaligned window is padded as the first stage that pads would
+        if (!padded && m_stages[i]->pads()) { pad = m_stages[i]->border(); padded = true; }
+    }
+    const detail::RoiWindow<float> w = detail::roi_window(input, reach, pad);
+    const Segment seg = plan_segment(Shape{w.view.width(), w.view.height(), w.view.channels()}, first, last, false);
+    const size_t n = seg.size();
+    const Shape& out_shape = seg.shape[n];
+
+    // ROI part of level j: its offset in the window's level and its shape
+    auto roi_level = [&](size_t j, int& x, int& y) {
+        x = w.out_x * (reach.stride / stride[j]);
+        y = w.out_y * (reach.stride / stride[j]);
+        return output_shape_of(Shape{input.width(), input.height(), input.channels()}, first, first + j);
+    };
+
+    const bool direct = w.out_x == 0 && w.out_y == 0 && out_shape.width == output.width() &&
+                        out_shape.height == output.height();
+    Image scratch;
+    if (!direct) scratch = Image(out_shape.width, out_shape.height, out_shape.channels, Fill::None);
+    const ImageView out = direct ? output : ImageView(scratch);
+    std::vector<Image> taps(n + 1);
+    for (size_t j = 1; j < n; ++j)
+        if (seg.tapped[j]) taps[j] = Image(seg.shape[j].width, seg.shape[j].height, seg.shape[j].channels, Fill::None);
+
+    if (seg.strips == 1)
+        seg.run_strip(0, Strip::whole(w.view), RowSink{out, 0}, taps, ThreadPool::resolve(threads));
+    else
+        ThreadPool::global().parallel_for(0, seg.strips, 1, [&](int k0, int k1) {
+            for (int k = k0; k < k1; ++k) seg.run_strip(k, Strip::whole(w.view), RowSink{out, 0}, taps);
+        }, ThreadPool::resolve(threads));
+
+    if (!direct)
+        for (int c = 0; c < output.channels(); ++c)
+            for (int y = 0; y < output.height(); ++y)
+                std::copy_n(scratch.row(y + w.out_y, c) + w.out_x, output.width(), output.row(y, c));
+    for (const auto& t : m_taps) {
+        if (t.first <= first || t.first >= last) continue;
+        const size_t j = t.first - first;
+        int x = 0, y = 0;
+        const Shape s = roi_level(j, x, y);
+        if (x == 0 && y == 0 && s.width == taps[j].width() && s.height == taps[j].height()) t.second(taps[j]);
+        else t.second(Image(taps[j].view(x, y, s.width, s.height)));
+    }
+}
+
+void Pipeline::run(ImageReader& input, ImageWriter& output, int threads) const {
+    LUMINE_TRACE_SCOPE("pipeline.stream", "width", input.width(), "height", input.height());
+    for (const auto& s : m_stages)
+        if (s->is_barrier()) throw std::runtime_error("Streaming does not support normalized convolution output");
+    if (!m_taps.empty()) throw std::runtime_error("Streaming does not support taps");
+    const Shape in_shape{input.width(), input.height(), input.channels()};
+    const Shape out_shape = output_shape(in_shape);
+    if (output.width() != out_shape.width || output.height() != out_shape.height ||
+        output.channels() != out_shape.channels)
+        throw std::runtime_error("Pipeline::run: output does not match the pipeline's output shape");
+    if (input.position() != 0) throw std::runtime_error("Pipeline::run: input already partly read");
+
+    if (m_stages.empty()) {
+        Image rows(in_shape.width, std::min(in_shape.height, 256), in_shape.channels, Fill::None);
+        for (int y = 0; y < in_shape.height; y += rows.height()) {
+            const int h = std::min(rows.height(), in_shape.height - y);
+            input.read(rows.view(0, 0, in_shape.width, h));
+            output.write(rows.view(0, 0, in_shape.width, h));
+        }
+        output.finish();
+        return;
+    }
+
+    // Strips run in groups of one per thread. The window holds the input
+    // rows of the current group; rows the next group shares with it (the
+    // halo) move to the top, the rest is read fresh.
+    const Segment seg = plan_segment(in_shape, 0, m_stages.size(), true);
+    const size_t n = seg.size();
+    const int nthreads = ThreadPool::resolve(threads);
+    auto group_rows = [&](int k0, int k1) {
+        RowRange r{seg.range(k0, 0).begin, seg.range(k0, 0).end};
+        for (int k = k0 + 1; k < k1; ++k) {
+            r.begin = std::min(r.begin, seg.range(k, 0).begin);
+            r.end = std::max(r.end, seg.range(k, 0).end);
+        }
+        return r;
+    };
+    int window_rows = 0;
+    for (int k0 = 0; k0 < seg.strips; k0 += nthreads) {
+        const RowRange r = group_rows(k0, std::min(seg.strips, k0 + nthreads));
+        window_rows = std::max(window_rows, r.end - r.begin);
+    }
+    Image window(in_shape.width, window_rows, in_shape.channels, Fill::None);
+    Image out(out_shape.width, std::min(out_shape.height, seg.rows * nthreads), out_shape.channels, Fill::None);
+    std::vector<Image> taps(n + 1);
+
+    int win_begin = 0, win_end = 0; // input rows held in window rows [0, win_end - win_begin)
+    for (int k0 = 0; k0 < seg.strips; k0 += nthreads) {
+        const int k1 = std::min(seg.strips, k0 + nthreads);
+        const RowRange need = group_rows(k0, k1);
+        if (need.begin < win_begin) throw std::logic_error("Pipeline::run: strips go back in the input");
+
+        const int keep = std::max(0, win_end - need.begin);
+        if (keep > 0 && need.begin > win_begin)
+            for (int c = 0; c < in_shape.channels; ++c)
+                for (int y = 0; y < keep; ++y)
+                    std::copy_n(window.row(need.begin - win_begin + y, c), in_shape.width, window.row(y, c));
+        // rows no strip reads (a strided stage can skip some)
+        for (int y = win_end; y < need.begin;) {
+            const int h = std::min(window.height(), need.begin - y);
+            input.read(window.view(0, 0, in_shape.width, h));
+            y += h;
+        }
+        win_begin = need.begin;
+        win_end = std::max(win_end, need.begin);
+        if (need.end > win_end) input.read(window.view(0, win_end - win_begin, in_shape.width, need.end - win_end));
+        win_end = std::max(win_end, need.end);
+
+        const Strip src{window.view(0, 0, in_shape.width, win_end - win_begin), win_begin, in_shape.height};
+        const RowSink dst{out, k0 * seg.rows};
+        if (seg.strips == 1)
+            seg.run_strip(0, src, dst, taps, nthreads);
+        else
+            ThreadPool::global().parallel_for(k0, k1, 1, [&](int a, int b) {
+                for (int k = a; k < b; ++k) seg.run_strip(k, src, dst, taps);
+            }, nthreads);
+
+        const int out_end = seg.range(k1 - 1, n).end;
+        output.write(out.view(0, 0, out_shape.width, out_end - k0 * seg.rows));
+    }
+    output.finish();
+}
+
+}
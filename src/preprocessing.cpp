@@ -1,79 +1,456 @@
 #include "lumine/preprocessing.hpp" 
+#include "lumine/binary_image.hpp"
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include "row_ops.hpp"
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace lumine {
 
-Image Preprocessing::grayscale(const Image& input) {
-  int width = input.width();
-  int height = input.height();
-  Image output(width, height, 1);
+namespace detail {
 
-  for(int y = 0; y < height; ++y) {
-    for(int x = 0; x < width; ++x) {
-      float r = input.at(x, y, 0);
-      float g = input.at(x, y, 1);
-      float b = input.at(x, y, 2);
+namespace {
 
-      float gray = 0.299f * r + 0.587f * g + 0.114f * b;
-      output.at(x, y, 0) = gray;
+// Copies row `y` of channel `c` (resolved against `pad` when outside the
+// image) into dst with `halo` padded samples on each side, so window reads
+// over dst[0 .. width + 2*halo) never need a bounds check.
+void load_padded_row(const Strip& in, int c, int y, int halo, Padding pad, float* dst) {
+  const int width = in.width();
+  if (y < 0 || y >= in.height) {
+    if (pad == Padding::ZERO) { std::fill(dst, dst + width + 2 * halo, 0.0f); return; }
+    y = std::min(std::max(y, 0), in.height - 1);
+  }
+  const float* row = in.row(y, c);
+  const float left = pad == Padding::ZERO ? 0.0f : row[0];
+  const float right = pad == Padding::ZERO ? 0.0f : row[width - 1];
+  std::fill(dst, dst + halo, left);
+  std::copy(row, row + width, dst + halo);
+  std::fill(dst + halo + width, dst + width + 2 * halo, right);
+}
+
+// Compare-exchange lists: after (a, b), v[a] <= v[b].
+using Network = std::vector<std::pair<int, int>>;
+
+// Paeth's 19-exchange median-of-9 network.
+const Network& median9_network() {
+  static const Network net = {
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8},
+    {0, 3}, {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2},
+  };
+  return net;
+}
+
+// Batcher's merge-exchange sort (Knuth 5.2.2M) for n inputs, pruned to the
+// exchanges that can still move a value into the middle slot.
+Network median_network(int n) {
+  Network all;
+  int t = 0;
+  while ((1 << t) < n) ++t;
+  for (int p = 1 << (t - 1); p > 0; p >>= 1) {
+    int q = 1 << (t - 1), r = 0, d = p;
+    for (;;) {
+      for (int i = 0; i < n - d; ++i)
+        if ((i & p) == r) all.emplace_back(i, i + d);
+      if (q == p) break;
+      d = q - p; q >>= 1; r = p;
     }
   }
+  std::vector<bool> needed(n, false);
+  needed[n / 2] = true;
+  Network pruned;
+  for (auto it = all.rbegin(); it != all.rend(); ++it) {
+    if (!needed[it->first] && !needed[it->second]) continue;
+    needed[it->first] = needed[it->second] = true;
+    pruned.push_back(*it);
+  }
+  std::reverse(pruned.begin(), pruned.end());
+  return pruned;
+}
 
-  output.save("gray.jpg");
-  return output;
+const Network& median25_network() {
+  static const Network net = median_network(25);
+  return net;
 }
 
-Image Preprocessing::denoise(const Image& input) {
-  int width = input.width();
-  int height = input.height();
-  Image output(width, height, input.channels());
+// Small windows: gather the (2r+1)^2 neighbours of a run of pixels into
+// column-major lanes and run a sorting network over all lanes at once.
+// The exchanges are branch-free min/max, so the lane loop vectorizes.
+void median_network_band(const Strip& in, const RowSink& out, int c, int y0, int y1,
+                         int radius, Padding pad, const Network& net) {
+  constexpr int kLanes = 64;
+  const int width = in.width();
+  const int d = 2 * radius + 1;
+  const int n = d * d;
+  const int pw = width + 2 * radius;
+  std::vector<float> ring((size_t)d * pw);
+  std::vector<float> lanes((size_t)n * kLanes);
+  auto slot = [&](int sy) { return ring.data() + (size_t)(((sy % d) + d) % d) * pw; };
 
-  for (int y = 1; y < height - 1; ++y) {
-    for (int x = 1; x < width - 1; ++x) {
-      for (int c = 0; c < input.channels(); ++c) {
-        std::vector<float> window;
-        for (int ky = -1; ky <= 1; ++ky) {
-          for (int kx = -1; kx <= 1; ++kx) {
-            window.push_back(input.at(x + kx, y + ky, c));
-            }
-          }
-          std::sort(window.begin(), window.end());
-          output.at(x, y, c) = window[window.size() / 2];
+  for (int sy = y0 - radius; sy < y0 + radius; ++sy) load_padded_row(in, c, sy, radius, pad, slot(sy));
+  for (int y = y0; y < y1; ++y) {
+    load_padded_row(in, c, y + radius, radius, pad, slot(y + radius));
+    float* dst = out.row(y, c);
+    for (int x0 = 0; x0 < width; x0 += kLanes) {
+      const int cnt = std::min(kLanes, width - x0);
+      for (int dy = 0; dy < d; ++dy) {
+        const float* row = slot(y - radius + dy) + x0;
+        for (int dx = 0; dx < d; ++dx) {
+          float* v = lanes.data() + (size_t)(dy * d + dx) * kLanes;
+          for (int i = 0; i < cnt; ++i) v[i] = row[i + dx];
+        }
       }
+      for (const auto& [a, b] : net) {
+        float* va = lanes.data() + (size_t)a * kLanes;
+        float* vb = lanes.data() + (size_t)b * kLanes;
+        for (int i = 0; i < kLanes; ++i) {
+          const float lo = std::min(va[i], vb[i]);
+          const float hi = std::max(va[i], vb[i]);
+          va[i] = lo; vb[i] = hi;
+        }
+      }
+      std::copy_n(lanes.data() + (size_t)(n / 2) * kLanes, cnt, dst + x0);
     }
   }
-  output.save("denoise.jpg");
-  return output;
 }
 
-Image Preprocessing::sauvola_binarization(const Image& input, float k, int window_size) {
-  int width = input.width();
-  int height = input.height();
-  int half_window = window_size / 2;
+inline int quantize8(float v) { return (int)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); }
+
+// Large windows: Perreault & Hebert's constant-time median. Every column
+// keeps a 16-bin coarse and a 256-bin fine histogram of its 2r+1 window
+// rows; the window histogram slides along the row by adding one column and
+// removing another, and the coarse level narrows the search to 16 fine bins.
+// Works on values quantized to 1/255 (exact for 8-bit sources). Columns are
+// processed in tiles so the column histograms stay cache resident.
+void median_histogram_tile(const Strip& in, const RowSink& out, int c, int y0, int y1, int x0, int x1,
+                           int radius, Padding pad) {
+  const int width = in.width();
+  const int d = 2 * radius + 1;
+  const int half = d * d / 2;
+  const int cols = x1 - x0 + 2 * radius; // padded columns x0-r .. x1+r-1
+  std::vector<uint16_t> fine((size_t)cols * 256, 0), coarse((size_t)cols * 16, 0);
+  std::vector<float> row(width + 2 * (size_t)radius);
+
+  auto update = [&](int sy, int delta) {
+    load_padded_row(in, c, sy, radius, pad, row.data());
+    const float* src = row.data() + x0; // padded index of column x0 - r
+    for (int j = 0; j < cols; ++j) {
+      const int q = quantize8(src[j]);
+      fine[(size_t)j * 256 + q] += delta;
+      coarse[(size_t)j * 16 + (q >> 4)] += delta;
+    }
+  };
+  for (int sy = y0 - radius; sy <= y0 + radius; ++sy) update(sy, 1);
+
+  // kc is slid every step; a 16-bin segment of kf is only brought up to
+  // date (incrementally, or rebuilt if it is d or more columns stale) when
+  // the median lands in its coarse bucket.
+  uint16_t kf[256], kc[16];
+  int fresh[16]; // x at which each kf segment was last valid
+  auto segment = [&](int j, int bucket) { return fine.data() + (size_t)j * 256 + bucket * 16; };
+  for (int y = y0; y < y1; ++y) {
+    std::fill(kc, kc + 16, 0);
+    std::fill(fresh, fresh + 16, x0 - d);
+    for (int j = 0; j < d - 1; ++j)
+      for (int b = 0; b < 16; ++b) kc[b] += coarse[(size_t)j * 16 + b];
 
-  Image output(width, height, 1);
+    float* dst = out.row(y, c);
+    for (int x = x0; x < x1; ++x) {
+      // window of x spans padded columns [x - x0, x - x0 + d)
+      const int add = x - x0 + d - 1;
+      for (int b = 0; b < 16; ++b) kc[b] += coarse[(size_t)add * 16 + b];
+      if (x > x0)
+        for (int b = 0; b < 16; ++b) kc[b] -= coarse[(size_t)(add - d) * 16 + b];
 
-  for (int y = half_window; y < height - half_window; ++y) {
-    for (int x = half_window; x < width - half_window; ++x) {
-      float sum = 0.0f, sq_sum = 0.0f;
-      for (int ky = -half_window; ky <= half_window; ++ky) {
-        for (int kx = -half_window; kx <= half_window; ++kx) {
-          float pixel = input.at(x + kx, y + ky, 0);
-          sum += pixel;
-          sq_sum += pixel * pixel;
+      int seen = 0, bucket = 0;
+      while (seen + kc[bucket] <= half) seen += kc[bucket++];
+
+      uint16_t* kb = kf + bucket * 16;
+      if (x - fresh[bucket] >= d) {
+        std::fill(kb, kb + 16, 0);
+        for (int j = x - x0; j < x - x0 + d; ++j) {
+          const uint16_t* f = segment(j, bucket);
+          for (int i = 0; i < 16; ++i) kb[i] += f[i];
+        }
+      } else {
+        for (int xs = fresh[bucket] + 1; xs <= x; ++xs) {
+          const uint16_t* fa = segment(xs - x0 + d - 1, bucket);
+          const uint16_t* fr = segment(xs - x0 - 1, bucket);
+          for (int i = 0; i < 16; ++i) kb[i] += fa[i] - fr[i];
         }
       }
-      float mean = sum / (window_size * window_size);
-      float stddev = std::sqrt(sq_sum / (window_size * window_size) - mean * mean);
-      float threshold = mean * (1 + k * (stddev / 128 - 1));
-      output.at(x, y, 0) = input.at(x, y, 0) > threshold ? 1.0f : 0.0f;
+      fresh[bucket] = x;
+
+      int bin = 0;
+      while (seen + kb[bin] <= half) seen += kb[bin++];
+      dst[x] = (bucket * 16 + bin) / 255.0f;
+    }
+    if (y + 1 < y1) {
+      update(y - radius, -1);
+      update(y + radius + 1, 1);
     }
   }
+}
 
-  output.save("sauvola_binarization.jpg");
+}
+
+void grayscale_rows(const Strip& src, const RowSink& dst, int a, int b, int threads) {
+  const int width = src.width();
+  ThreadPool::global().parallel_for(a, b, 64, [&](int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+      float* out = dst.row(y, 0);
+      if (src.channels() < 3) {
+        // already single channel
+        std::copy(src.row(y, 0), src.row(y, 0) + width, out);
+        continue;
+      }
+      const float* r = src.row(y, 0);
+      const float* g = src.row(y, 1);
+      const float* bl = src.row(y, 2);
+      for (int x = 0; x < width; ++x)
+        out[x] = 0.299f * r[x] + 0.587f * g[x] + 0.114f * bl[x];
+    }
+  }, ThreadPool::resolve(threads));
+}
+
+RowRange median_input_rows(int a, int b, int in_height, int radius) {
+  if (b <= a) return RowRange{0, 0};
+  return RowRange{std::max(0, a - radius), std::min(in_height, b + radius)};
+}
+
+void median_rows(const Strip& src, const RowSink& dst, int a, int b, int radius, Padding pad, int threads) {
+  const int width = src.width();
+  if (b <= a || width == 0) return;
+
+  // Work items are (channel, row band, column tile); only the histogram
+  // engine tiles columns.
+  const bool network = radius <= 2;
+  const int band = std::max(32, 8 * radius);
+  const int tile = network ? width : std::max(256, 16 * radius);
+  const int bands = (b - a + band - 1) / band;
+  const int tiles = (width + tile - 1) / tile;
+  const Network& net = radius == 1 ? median9_network() : median25_network();
+
+  ThreadPool::global().parallel_for(0, src.channels() * bands * tiles, 1, [&](int first, int last) {
+    for (int i = first; i < last; ++i) {
+      const int c = i / (bands * tiles);
+      const int y0 = a + (i / tiles % bands) * band, y1 = std::min(b, y0 + band);
+      const int x0 = (i % tiles) * tile, x1 = std::min(width, x0 + tile);
+      if (network) median_network_band(src, dst, c, y0, y1, radius, pad, net);
+      else median_histogram_tile(src, dst, c, y0, y1, x0, x1, radius, pad);
+    }
+  }, ThreadPool::resolve(threads));
+}
+
+RowRange sauvola_input_rows(int a, int b, int in_height, int window_size) {
+  if (b <= a) return RowRange{0, 0};
+  const int half_window = std::max(0, window_size / 2);
+  return RowRange{std::max(0, a - half_window), std::min(in_height, b + half_window)};
+}
+
+namespace {
+
+// Where sauvola_band writes its decisions: 0/1 floats into a RowSink, or
+// bits into a BinaryImage. put(i, v) is called for i = 0, 1, ... in order.
+struct FloatRowOut {
+  const RowSink* dst;
+  float* p{nullptr};
+  void begin(int y) { p = dst->row(y, 0); }
+  void put(int i, bool v) { p[i] = v ? 1.0f : 0.0f; }
+  void end(int) {}
+};
+
+struct BitRowOut {
+  BinaryImage* dst;
+  int y0; // image row of strip row 0
+  uint64_t* p{nullptr};
+  uint64_t word{0};
+  void begin(int y) { p = dst->row(y - y0); word = 0; }
+  void put(int i, bool v) {
+    word |= (uint64_t)v << (i & 63);
+    if ((i & 63) == 63) { p[i >> 6] = word; word = 0; }
+  }
+  void end(int n) { if (n & 63) p[n >> 6] = word; }
+};
+
+// Sauvola over output rows [a, b) and columns [x0, x1) of src.
+template <typename Out>
+void sauvola_band(const Strip& src, const Out& proto, int a, int b, int x0, int x1, float k, int window_size,
+                  int threads) {
+  const int width = src.width();
+  const int height = src.height;
+  const int half_window = std::max(0, window_size / 2);
+  if (b <= a || width == 0) return;
+
+  // Running box sums: per band we keep the sum and sum of squares of every
+  // column over the current window rows, then slide a window along each row.
+  // Each pixel costs a constant number of adds regardless of window_size.
+  // Sums are kept in double; a band only ever adds/removes a few hundred
+  // values in [0, 1], so drift stays far below float resolution. Windows are
+  // clipped at the image border and normalised by the real pixel count.
+  const int band = std::max(64, 4 * window_size);
+  const int bands = (b - a + band - 1) / band;
+  ThreadPool::global().parallel_for(0, bands, 1, [&](int first, int last) {
+    std::vector<double> col_sum(width), col_sq(width);
+    Out out = proto;
+    for (int i = first; i < last; ++i) {
+      const int y0 = a + i * band;
+      const int y1 = std::min(b, y0 + band);
+
+      std::fill(col_sum.begin(), col_sum.end(), 0.0);
+      std::fill(col_sq.begin(), col_sq.end(), 0.0);
+      for (int sy = std::max(0, y0 - half_window); sy <= std::min(height - 1, y0 + half_window); ++sy) {
+        const float* row = src.row(sy, 0);
+        for (int x = 0; x < width; ++x) {
+          col_sum[x] += row[x];
+          col_sq[x] += (double)row[x] * row[x];
+        }
+      }
+
+      for (int y = y0; y < y1; ++y) {
+        const int rows = std::min(height - 1, y + half_window) - std::max(0, y - half_window) + 1;
+        const float* in = src.row(y, 0);
+        out.begin(y);
+
+        double sum = 0.0, sq_sum = 0.0;
+        for (int x = std::max(0, x0 - half_window); x < std::min(width, x0 + half_window); ++x) {
+          sum += col_sum[x];
+          sq_sum += col_sq[x];
+        }
+        for (int x = x0; x < x1; ++x) {
+          const int add = x + half_window;
+          const int sub = x - half_window - 1;
+          if (add < width) { sum += col_sum[add]; sq_sum += col_sq[add]; }
+          if (sub >= 0) { sum -= col_sum[sub]; sq_sum -= col_sq[sub]; }
+
+          const int cols = std::min(width - 1, add) - std::max(0, x - half_window) + 1;
+          const double n = (double)rows * cols;
+          const double mean = sum / n;
+          const double stddev = std::sqrt(std::max(0.0, sq_sum / n - mean * mean));
+          const double threshold = mean * (1 + k * (stddev / 128 - 1));
+          out.put(x - x0, in[x] > threshold);
+        }
+        out.end(x1 - x0);
+
+        // slide the column sums down one row
+        if (y + 1 == y1) break;
+        const int enter = y + half_window + 1;
+        const int leave = y - half_window;
+        if (enter < height) {
+          const float* row = src.row(enter, 0);
+          for (int x = 0; x < width; ++x) {
+            col_sum[x] += row[x];
+            col_sq[x] += (double)row[x] * row[x];
+          }
+        }
+        if (leave >= 0) {
+          const float* row = src.row(leave, 0);
+          for (int x = 0; x < width; ++x) {
+            col_sum[x] -= row[x];
+            col_sq[x] -= (double)row[x] * row[x];
+          }
+        }
+      }
+    }
+  }, ThreadPool::resolve(threads));
+}
+
+}
+
+void sauvola_rows(const Strip& src, const RowSink& dst, int a, int b, float k, int window_size, int threads) {
+  sauvola_band(src, FloatRowOut{&dst}, a, b, 0, src.width(), k, window_size, threads);
+}
+
+}
+
+namespace {
+
+void check_output(ConstImageView out, int width, int height, int channels, const char* op) {
+  if (out.width() != width || out.height() != height || out.channels() != channels)
+    throw std::runtime_error(std::string(op) + ": output view has the wrong shape");
+}
+
+}
+
+Image Preprocessing::grayscale(ConstImageView input, int threads) {
+  Image output(input.width(), input.height(), 1, Fill::None);
+  grayscale(input, output, threads);
+  return output;
+}
+
+void Preprocessing::grayscale(ConstImageView input, ImageView output, int threads) {
+  check_output(output, input.width(), input.height(), 1, "grayscale");
+  LUMINE_TRACE_SCOPE("grayscale", "width", input.width(), "height", input.height());
+  LUMINE_TRACE_COUNT("pixels.grayscale", (double)input.width() * input.height());
+  detail::grayscale_rows(detail::Strip::whole(input), detail::RowSink{output, 0}, 0, input.height(), threads);
+}
+
+Image Preprocessing::denoise(ConstImageView input, int radius, Padding padding, int threads) {
+  if (radius <= 0) return Image(input);
+  Image output(input.width(), input.height(), input.channels(), Fill::None);
+  denoise(input, output, radius, padding, threads);
+  return output;
+}
+
+void Preprocessing::denoise(ConstImageView input, ImageView output, int radius, Padding padding, int threads) {
+  if (radius > kMaxDenoiseRadius) throw std::runtime_error("denoise radius too large: " + std::to_string(radius));
+  check_output(output, input.width(), input.height(), input.channels(), "denoise");
+  LUMINE_TRACE_SCOPE("denoise", "width", input.width(), "height", input.height());
+  LUMINE_TRACE_COUNT("pixels.denoise", (double)input.width() * input.height() * input.channels());
+  if (radius <= 0) {
+    for (int c = 0; c < input.channels(); ++c)
+      for (int y = 0; y < input.height(); ++y) std::copy_n(input.row(y, c), input.width(), output.row(y, c));
+    return;
+  }
+  detail::run_roi(input, output, detail::Reach{radius, radius, radius, radius, 1}, padding,
+                  [](int w) { return w; }, [&](ConstImageView src, ImageView dst, int a, int b) {
+    detail::median_rows(detail::Strip::whole(src), detail::RowSink{dst, a}, a, b, radius, padding, threads);
+  });
+}
+
+Image Preprocessing::sauvola_binarization(ConstImageView input, float k, int window_size, int threads) {
+  Image output(input.width(), input.height(), 1, Fill::None);
+  sauvola_binarization(input, output, k, window_size, threads);
   return output;
 }
 
+void Preprocessing::sauvola_binarization(ConstImageView input, ImageView output, float k, int window_size,
+                                         int threads) {
+  check_output(output, input.width(), input.height(), 1, "sauvola_binarization");
+  LUMINE_TRACE_SCOPE("sauvola", "width", input.width(), "height", input.height());
+  LUMINE_TRACE_COUNT("pixels.sauvola", (double)input.width() * input.height());
+  const int half = std::max(0, window_size / 2);
+  // the window is clipped at the image border, so padding never applies
+  detail::run_roi(input.channel(0), output, detail::Reach{half, half, half, half, 1}, Padding::ZERO,
+                  [](int w) { return w; }, [&](ConstImageView src, ImageView dst, int a, int b) {
+    detail::sauvola_rows(detail::Strip::whole(src), detail::RowSink{dst, a}, a, b, k, window_size, threads);
+  });
+}
+
+BinaryImage Preprocessing::sauvola_binary(ConstImageView input, float k, int window_size, int threads) {
+  BinaryImage output(input.width(), input.height(), Fill::None);
+  sauvola_binarization(input, output, k, window_size, threads);
+  return output;
+}
+
+void Preprocessing::sauvola_binarization(ConstImageView input, BinaryImage& output, float k, int window_size,
+                                         int threads) {
+  if (output.width() != input.width() || output.height() != input.height())
+    throw std::runtime_error("sauvola_binarization: output image has the wrong shape");
+  LUMINE_TRACE_SCOPE("sauvola", "width", input.width(), "height", input.height());
+  LUMINE_TRACE_COUNT("pixels.sauvola", (double)input.width() * input.height());
+  if (output.empty()) return;
+  const int half = std::max(0, window_size / 2);
+  // as run_roi, but the window's columns map onto bits of the output
+  const detail::RoiWindow<float> w =
+      detail::roi_window(input.channel(0), detail::Reach{half, half, half, half, 1}, Padding::ZERO);
+  detail::sauvola_band(detail::Strip::whole(w.view), detail::BitRowOut{&output, w.out_y}, w.out_y,
+                       w.out_y + input.height(), w.out_x, w.out_x + input.width(), k, window_size, threads);
+}
+
 }
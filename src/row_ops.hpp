@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <complex>
+#include <vector>
+#include "lumine/convolver.hpp"
+#include "lumine/filter_bank.hpp"
+#include "lumine/image.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/types.hpp"
+
+// Row-range entry points of the image operations. Convolver and
+// Preprocessing run them over a whole image; Pipeline runs them over
+// horizontal strips, so every engine reads rows of a virtual image that is
+// only partly stored and writes a row range of its output.
+namespace lumine::detail {
+
+// Rows [y0, y0 + view.height()) of a virtual image that is `height` rows
+// tall. Padding is resolved against the virtual image; callers guarantee
+// that every in-bounds row an engine touches is stored.
+struct Strip {
+    ConstImageView view;
+    int y0{0};
+    int height{0};
+
+    static Strip whole(ConstImageView v) { return Strip{v, 0, v.height()}; }
+    int width() const { return view.width(); }
+    int channels() const { return view.channels(); }
+    const float* row(int y, int c) const { return view.row(y - y0, c); }
+};
+
+// Destination rows: output row y lives in view.row(y - y0, .).
+struct RowSink {
+    ImageView view;
+    int y0{0};
+
+    float* row(int y, int c) const { return view.row(y - y0, c); }
+};
+
+struct RowRange { int begin{0}, end{0}; };
+
+// ---- regions of interest
+// Input footprint of an operation: output (ox, oy) reads input columns
+// [ox*stride - left, ox*stride + right] and rows [oy*stride - top, oy*stride + bottom].
+struct Reach { int left{0}, top{0}, right{0}, bottom{0}; int stride{1}; };
+
+// What an operation actually runs on for a region of interest: the ROI
+// grown into its context by up to `reach` (so border outputs see the real
+// neighbours), with output (ox, oy) of the ROI at (ox + out_x, oy + out_y)
+// of the window's output. The window is a view into the caller's image
+// unless a stride-misaligned edge forces a padded copy into `storage`.
+template <typename T>
+struct RoiWindow {
+    BasicImageView<const T> view;
+    int out_x{0}, out_y{0};
+    BasicImage<T> storage;
+};
+
+template <typename T>
+RoiWindow<T> roi_window(BasicImageView<const T> roi, const Reach& reach, Padding pad) {
+    const int s = std::max(1, reach.stride);
+    const auto& ctx = roi.context();
+    auto grow = [s](int need, int avail) { return std::min(avail, (need + s - 1) / s * s); };
+    const int l = grow(reach.left, ctx.left), t = grow(reach.top, ctx.top);
+    const int r = std::min(reach.right, ctx.right), b = std::min(reach.bottom, ctx.bottom);
+
+    RoiWindow<T> w;
+    w.view = roi.expand(l, t, r, b);
+    if (l % s == 0 && t % s == 0) {
+        w.out_x = l / s;
+        w.out_y = t / s;
+        return w;
+    }
+    // The image ends inside the reach at a column/row off the stride grid:
+    // prepend the padding the operation would see there so that the
+    // window's first output stays on the ROI's grid.
+    const int pl = (l + s - 1) / s * s - l, pt = (t + s - 1) / s * s - t;
+    const BasicImageView<const T>& v = w.view;
+    w.storage = BasicImage<T>(v.width() + pl, v.height() + pt, v.channels());
+    for (int c = 0; c < v.channels(); ++c)
+        for (int y = 0; y < w.storage.height(); ++y) {
+            T* dst = w.storage.row(y, c);
+            const bool above = y < pt;
+            if (above && pad == Padding::ZERO) continue;
+            const T* src = v.row(above ? 0 : y - pt, c);
+            if (pad == Padding::EDGE) std::fill_n(dst, pl, src[0]);
+            std::copy_n(src, v.width(), dst + pl);
+        }
+    w.out_x = (l + pl) / s;
+    w.out_y = (t + pt) / s;
+    w.view = w.storage.view();
+    return w;
+}
+
+// Computes the outputs of an operation for the ROI `in` into `out`.
+// run(src, dst, a, b) is the operation's engine: output rows [a, b) of the
+// whole image `src`, written with row a at dst row 0. out_width(w) is the
+// output width for an input w pixels wide. Rows go straight into `out`
+// unless the window is wider than the ROI; then they pass through a
+// scratch image and only the ROI's columns are copied.
+template <typename T, typename Run, typename OutWidth>
+void run_roi(BasicImageView<const T> in, BasicImageView<T> out, const Reach& reach, Padding pad,
+             OutWidth&& out_width, Run&& run) {
+    if (out.empty()) return;
+    const RoiWindow<T> w = roi_window(in, reach, pad);
+    const int a = w.out_y, b = w.out_y + out.height();
+    const int width = out_width(w.view.width());
+    if (w.out_x == 0 && width == out.width()) {
+        run(w.view, out, a, b);
+        return;
+    }
+    BasicImage<T> rows(width, out.height(), out.channels(), Fill::None);
+    run(w.view, rows.view(), a, b);
+    for (int c = 0; c < out.channels(); ++c)
+        for (int y = 0; y < out.height(); ++y)
+            std::copy_n(rows.row(y, c) + w.out_x, out.width(), out.row(y, c));
+}
+
+struct FixedConv;
+
+// ---- convolution
+Size conv_output_size(int width, int height, int kw, int kh, int stride);
+Size conv_output_size(int width, int height, const Kernel& K, int stride);
+Reach conv_reach(const Kernel& K, int stride);
+// Input rows (clipped to [0, in_height)) read by output rows [a, b).
+RowRange conv_input_rows(int a, int b, int in_height, const Kernel& K, int stride);
+// Everything convolve_rows decides before it touches pixels, for one kernel
+// on a width x height virtual input. Strips of one image share a setup, so
+// they all take the same path; ConvPlan keeps one across calls.
+struct ConvSetup {
+    Kernel kernel;
+    int width{0}, height{0};
+    Padding pad{Padding::ZERO};
+    int stride{1};
+    ConvAlgo algo{ConvAlgo::Direct}; // never Auto
+    int band{1};                     // output rows per work item (Direct, Separable)
+    int fft_size{0};                 // FFT block edge
+    std::vector<SeparableTerm> terms; // Separable: K ~ sum of ky (x) kx
+    std::vector<int> live_rows;      // Direct: kernel rows with a nonzero weight
+    std::vector<std::complex<double>> spectrum; // FFT: conj(FFT(kernel)), fft_size^2 values
+    const FixedConv* fixed{nullptr}; // compile-time builtin replacing Direct/Separable
+    // Recursive Gaussian: every output reads every input row, so src must
+    // hold the whole virtual input (Pipeline runs it as a single strip).
+    bool whole_columns{false};
+};
+// band and fft_size of 0 pick the defaults; algo may be Auto.
+ConvSetup make_conv_setup(const Kernel& K, int width, int height, Padding pad, int stride,
+                          ConvAlgo algo, float rank_tolerance, int band = 0, int fft_size = 0);
+// Modelled cost of `algo` (not Auto), in vectorized multiply-adds;
+// infinity when the algorithm cannot run this kernel. fft_size 0 = best size.
+double conv_cost(const Kernel& K, int width, int height, int stride, ConvAlgo algo,
+                 float rank_tolerance, int fft_size = 0);
+// Output rows [a, b) of setup.kernel applied to src; no viz
+// post-processing. src is normally the planned shape; a ROI window may be
+// a little larger and keeps the planned strategy.
+void convolve_rows(const ConvSetup& setup, const Strip& src, const RowSink& dst, int a, int b, int threads);
+// Clamp is row local; Normalize needs the whole image in `img`.
+void apply_viz(ImageView img, VizMode viz, int threads);
+
+// ---- filter banks
+// A bank's kernels as one list of taps: each (row, column) of the footprint
+// where any kernel is nonzero, with the weights of every kernel there.
+struct BankSetup {
+    int kw{0}, kh{0}, n{0};
+    std::vector<int> tap_y, tap_x;
+    // Kernels in groups of up to kMaxBankKernels (conv_kernels.hpp): per
+    // group, taps x group size weights, tap-major.
+    std::vector<std::vector<float>> weights;
+};
+BankSetup make_bank_setup(const std::vector<Kernel>& kernels);
+// Output rows [a, b) of the bank, no viz. dst is one sink per kernel for
+// BankReduce::None, else a single sink for the reduced response.
+void filter_bank_rows(const BankSetup& setup, BankReduce reduce, Padding pad, int stride, const Strip& src,
+                      const RowSink* dst, int a, int b, int threads);
+
+// ---- preprocessing
+void grayscale_rows(const Strip& src, const RowSink& dst, int a, int b, int threads);
+RowRange median_input_rows(int a, int b, int in_height, int radius);
+void median_rows(const Strip& src, const RowSink& dst, int a, int b,
+                 int radius, Padding pad, int threads);
+RowRange sauvola_input_rows(int a, int b, int in_height, int window_size);
+void sauvola_rows(const Strip& src, const RowSink& dst, int a, int b,
+                  float k, int window_size, int threads);
+
+}
@@ -0,0 +1,583 @@
+#include "serve.hpp"
+#include "bounded_queue.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/filter_bank.hpp"
+#include "lumine/image.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/pipeline.hpp"
+#include "lumine/preprocessing.hpp"
+#include "lumine/thread_pool.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace lumine {
+
+namespace {
+
+// ---- JSON: one flat object per line, scalar values only
+
+struct JsonValue {
+    enum class Type { String, Number, Bool, Null };
+    Type type{Type::Null};
+    std::string str; // String contents
+    double num{0};
+    bool boolean{false};
+};
+using JsonObject = std::map<std::string, JsonValue>;
+
+class JsonParser {
+    public:
+        explicit JsonParser(const std::string& s) : m_s(s) {}
+
+        JsonObject object() {
+            JsonObject obj;
+            expect('{');
+            skip_ws();
+            if (peek() == '}') { ++m_pos; return finish(obj); }
+            for (;;) {
+                skip_ws();
+                std::string key = string();
+                expect(':');
+                obj[key] = value();
+                skip_ws();
+                if (peek() == ',') { ++m_pos; continue; }
+                expect('}');
+                return finish(obj);
+            }
+        }
+
+    private:
+        JsonObject& finish(JsonObject& obj) {
+            skip_ws();
+            if (m_pos != m_s.size()) fail("trailing characters");
+            return obj;
+        }
+
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::runtime_error("invalid JSON at column " + std::to_string(m_pos + 1) + ": " + what);
+        }
+        char peek() const { return m_pos < m_s.size() ? m_s[m_pos] : '\0'; }
+        void skip_ws() { while (m_pos < m_s.size() && std::strchr(" \t\r\n", m_s[m_pos])) ++m_pos; }
+        void expect(char c) {
+            skip_ws();
+            if (peek() != c) fail(std::string("expected '") + c + "'");
+            ++m_pos;
+        }
+
+        std::string string() {
+            if (peek() != '"') fail("expected a string");
+            ++m_pos;
+            std::string out;
+            for (;;) {
+                if (m_pos >= m_s.size()) fail("unterminated string");
+                const char c = m_s[m_pos++];
+                if (c == '"') return out;
+                if (c != '\\') { out += c; continue; }
+                const char e = peek();
+                ++m_pos;
+                switch (e) {
+                    case '"': case '\\': case '/': out += e; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        if (m_pos + 4 > m_s.size()) fail("bad \\u escape");
+                        const unsigned cp = (unsigned)std::strtoul(m_s.substr(m_pos, 4).c_str(), nullptr, 16);
+                        m_pos += 4;
+                        // BMP code point as UTF-8; surrogate pairs are not combined
+                        if (cp < 0x80) out += (char)cp;
+                        else if (cp < 0x800) { out += (char)(0xC0 | cp >> 6); out += (char)(0x80 | (cp & 0x3F)); }
+                        else {
+                            out += (char)(0xE0 | cp >> 12);
+                            out += (char)(0x80 | (cp >> 6 & 0x3F));
+                            out += (char)(0x80 | (cp & 0x3F));
+                        }
+                        break;
+                    }
+                    default: fail("bad escape");
+                }
+            }
+        }
+
+        JsonValue value() {
+            skip_ws();
+            JsonValue v;
+            const char c = peek();
+            if (c == '"') {
+                v.type = JsonValue::Type::String;
+                v.str = string();
+            } else if (m_s.compare(m_pos, 4, "true") == 0 || m_s.compare(m_pos, 5, "false") == 0) {
+                v.type = JsonValue::Type::Bool;
+                v.boolean = c == 't';
+                m_pos += v.boolean ? 4 : 5;
+            } else if (m_s.compare(m_pos, 4, "null") == 0) {
+                m_pos += 4;
+            } else if (c == '-' || digit()) {
+                v.type = JsonValue::Type::Number;
+                v.num = number();
+            } else if (c == '{' || c == '[') {
+                fail("nested values are not supported");
+            } else {
+                fail("expected a value");
+            }
+            return v;
+        }
+
+        bool digit() const { return peek() >= '0' && peek() <= '9'; }
+        void digits() { while (digit()) ++m_pos; }
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and nothing else
+        // (strtod alone would take hex, inf, nan and leading '+').
+        double number() {
+            const size_t start = m_pos;
+            if (peek() == '-') ++m_pos;
+            if (peek() == '0') ++m_pos;
+            else if (digit()) digits();
+            else fail("bad number");
+            if (peek() == '.') {
+                ++m_pos;
+                if (!digit()) fail("bad number");
+                digits();
+            }
+            if (peek() == 'e' || peek() == 'E') {
+                ++m_pos;
+                if (peek() == '+' || peek() == '-') ++m_pos;
+                if (!digit()) fail("bad number");
+                digits();
+            }
+            const double v = std::strtod(m_s.substr(start, m_pos - start).c_str(), nullptr);
+            if (!std::isfinite(v)) fail("number out of range");
+            return v;
+        }
+
+        const std::string& m_s;
+        size_t m_pos{0};
+};
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// Shortest form that reads back as the same double.
+std::string json_number(double v) {
+    char buf[32];
+    for (int precision = 15; precision <= 17; ++precision) {
+        std::snprintf(buf, sizeof buf, "%.*g", precision, v);
+        if (std::strtod(buf, nullptr) == v) break;
+    }
+    return buf;
+}
+
+// A parsed value written back out, e.g. to echo a job's "id".
+std::string json_value(const JsonValue& v) {
+    switch (v.type) {
+        case JsonValue::Type::String: return json_string(v.str);
+        case JsonValue::Type::Number: return json_number(v.num);
+        case JsonValue::Type::Bool: return v.boolean ? "true" : "false";
+        case JsonValue::Type::Null: break;
+    }
+    return "null";
+}
+
+// ---- jobs
+
+const JsonValue* find(const JsonObject& obj, const char* key, JsonValue::Type type) {
+    auto it = obj.find(key);
+    if (it == obj.end() || it->second.type == JsonValue::Type::Null) return nullptr;
+    if (it->second.type != type) throw std::runtime_error(std::string("wrong type for \"") + key + "\"");
+    return &it->second;
+}
+std::string get(const JsonObject& o, const char* key, const std::string& fallback) {
+    const JsonValue* v = find(o, key, JsonValue::Type::String);
+    return v ? v->str : fallback;
+}
+double get(const JsonObject& o, const char* key, double fallback) {
+    const JsonValue* v = find(o, key, JsonValue::Type::Number);
+    return v ? v->num : fallback;
+}
+// A finite number; JSON numbers are doubles, so casts to int or float must
+// check first.
+double get_finite(const JsonObject& o, const char* key, double fallback) {
+    const double v = get(o, key, fallback);
+    if (!std::isfinite(v) || std::fabs(v) > std::numeric_limits<float>::max())
+        throw std::runtime_error(std::string("\"") + key + "\" must be a finite number");
+    return v;
+}
+int get_int(const JsonObject& o, const char* key, int fallback, int lo, int hi) {
+    const double v = get(o, key, (double)fallback);
+    if (!(v >= lo && v <= hi) || v != std::floor(v))
+        throw std::runtime_error(std::string("\"") + key + "\" must be a whole number in [" + std::to_string(lo) +
+                                 ", " + std::to_string(hi) + "]");
+    return (int)v;
+}
+bool get(const JsonObject& o, const char* key, bool fallback) {
+    const JsonValue* v = find(o, key, JsonValue::Type::Bool);
+    return v ? v->boolean : fallback;
+}
+
+// What to do with an image; the same knobs as the command line.
+struct JobSpec {
+    std::string kernel;
+    ConvParams params;
+    bool grayscale{false}, denoise{false}, binarize{false}, u8{false};
+    bool unit_angles{false}; // Orientation bank without "viz": radians mapped onto [0, 1]
+    int denoise_radius{1}, window_size{15};
+    float binarize_k{0.2f};
+
+    static constexpr int kMaxStride = 1 << 16, kMaxWindowSize = 1 << 16;
+
+    static JobSpec parse(const JsonObject& o) {
+        static const std::set<std::string> known{
+            "id", "input", "output", "kernel", "stride", "padding", "viz", "algo", "rank_tolerance", "grayscale",
+            "denoise", "denoise_radius", "binarize", "binarize_k", "window_size", "u8"};
+        for (const auto& kv : o)
+            if (!known.count(kv.first)) throw std::runtime_error("unknown key \"" + kv.first + "\"");
+
+        JobSpec s;
+        s.kernel = get(o, "kernel", std::string());
+        if (s.kernel.empty()) throw std::runtime_error("\"kernel\" is required");
+        s.params.stride = get_int(o, "stride", 1, 1, kMaxStride);
+        const std::string pad = get(o, "padding", std::string("zero"));
+        if (pad != "zero" && pad != "edge") throw std::runtime_error("padding must be zero or edge");
+        s.params.padding = pad == "edge" ? Padding::EDGE : Padding::ZERO;
+        const std::string viz = get(o, "viz", std::string("clamp"));
+        if (viz == "normalize") s.params.viz = VizMode::Normalize;
+        else if (viz == "none") s.params.viz = VizMode::None;
+        else if (viz == "clamp") s.params.viz = VizMode::Clamp;
+        else throw std::runtime_error("viz must be clamp, normalize or none");
+        const std::string algo = get(o, "algo", std::string("auto"));
+        if (algo == "direct") s.params.algo = ConvAlgo::Direct;
+        else if (algo == "separable") s.params.algo = ConvAlgo::Separable;
+        else if (algo == "fft") s.params.algo = ConvAlgo::FFT;
+        else if (algo == "recursive") s.params.algo = ConvAlgo::Recursive;
+        else if (algo == "auto") s.params.algo = ConvAlgo::Auto;
+        else throw std::runtime_error("algo must be auto, direct, separable, fft or recursive");
+        s.params.rank_tolerance = (float)get_finite(o, "rank_tolerance", (double)s.params.rank_tolerance);
+        s.grayscale = get(o, "grayscale", false);
+        s.denoise_radius = get_int(o, "denoise_radius", 0, 0, Preprocessing::kMaxDenoiseRadius);
+        s.denoise = get(o, "denoise", false) || s.denoise_radius > 0;
+        if (s.denoise_radius <= 0) s.denoise_radius = 1;
+        s.binarize = get(o, "binarize", false);
+        s.binarize_k = (float)get_finite(o, "binarize_k", (double)s.binarize_k);
+        s.window_size = get_int(o, "window_size", s.window_size, 1, kMaxWindowSize);
+        s.u8 = get(o, "u8", false);
+        s.unit_angles = !find(o, "viz", JsonValue::Type::String) && FilterBank::is_builtin(s.kernel) &&
+                        FilterBank::from_builtin(s.kernel).reduce() == BankReduce::Orientation;
+        if (s.u8 && (s.denoise || s.binarize || FilterBank::is_builtin(s.kernel))) throw std::runtime_error("u8 supports convolution only");
+        return s;
+    }
+
+    // Identifies the pipeline this spec builds; floats round-trip, so specs
+    // that differ in any bit get their own pipeline.
+    std::string key() const {
+        std::ostringstream os;
+        os << std::setprecision(std::numeric_limits<float>::max_digits10) << kernel << '\n' << params.stride << ' ' << (int)params.padding << ' ' << (int)params.viz << ' '
+           << (int)params.algo << ' ' << params.rank_tolerance << ' ' << grayscale << denoise << binarize << ' '
+           << denoise_radius << ' ' << binarize_k << ' ' << window_size << ' ' << unit_angles;
+        return os.str();
+    }
+};
+
+// Parsed kernels and pipelines (with their convolution plans) by spec.
+// `warm`, if given, is set when the entry was already there.
+class WarmCache {
+    public:
+        Kernel kernel(const std::string& spec, bool* warm = nullptr) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_kernels.find(spec);
+            if (warm) *warm = it != m_kernels.end();
+            if (it != m_kernels.end()) return it->second;
+            const Kernel K = Kernel::is_builtin(spec) ? Kernel::from_builtin(spec) : Kernel::from_string(spec);
+            if (m_kernels.size() >= kMaxEntries) m_kernels.clear();
+            return m_kernels.emplace(spec, K).first->second;
+        }
+
+        std::shared_ptr<const Pipeline> pipeline(const JobSpec& s, bool* warm = nullptr) {
+            const std::string key = s.key();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_pipelines.find(key);
+                if (warm) *warm = it != m_pipelines.end();
+                if (it != m_pipelines.end()) return it->second;
+            }
+            auto p = std::make_shared<Pipeline>();
+            if (s.grayscale) p->grayscale();
+            if (s.denoise) p->denoise(s.denoise_radius, Padding::EDGE);
+            if (s.binarize) p->binarize(s.binarize_k, s.window_size);
+            if (FilterBank::is_builtin(s.kernel)) {
+                p->filter_bank(FilterBank::from_builtin(s.kernel), s.params, s.unit_angles);
+            } else {
+                p->convolve(kernel(s.kernel), s.params);
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pipelines.size() >= kMaxEntries) m_pipelines.clear();
+            return m_pipelines.emplace(key, std::move(p)).first->second;
+        }
+
+    private:
+        static constexpr size_t kMaxEntries = 256;
+        std::mutex m_mutex;
+        std::map<std::string, Kernel> m_kernels;
+        std::map<std::string, std::shared_ptr<const Pipeline>> m_pipelines;
+};
+
+// ---- transport
+
+// Where replies go: a client socket (closed with the last reference) or stdout.
+class Connection {
+    public:
+        Connection(int fd, bool owned) : m_fd(fd), m_owned(owned) {}
+        ~Connection() { if (m_owned) ::close(m_fd); }
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        int fd() const { return m_fd; }
+
+        // Whole lines only, so concurrent replies never interleave. A client
+        // that went away just stops getting answers.
+        void send(const std::string& line) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const std::string out = line + "\n";
+            for (size_t done = 0; done < out.size();) {
+                const ssize_t n = ::write(m_fd, out.data() + done, out.size() - done);
+                if (n <= 0) return;
+                done += (size_t)n;
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        int m_fd;
+        bool m_owned;
+};
+
+struct Job {
+    JsonObject fields;
+    std::shared_ptr<Connection> reply;
+};
+
+std::string error_reply(const std::string& id, const std::string& error) {
+    return "{\"id\":" + id + ",\"ok\":false,\"error\":" + json_string(error) + "}";
+}
+
+void run_job(const Job& job, WarmCache& cache, int threads) {
+    const auto it = job.fields.find("id");
+    const std::string id = it == job.fields.end() ? "null" : json_value(it->second);
+    try {
+        const auto t0 = std::chrono::steady_clock::now();
+        const JobSpec spec = JobSpec::parse(job.fields);
+        const std::string input = get(job.fields, "input", std::string());
+        const std::string output = get(job.fields, "output", std::string());
+        if (input.empty() || output.empty()) throw std::runtime_error("\"input\" and \"output\" are required");
+
+        int width = 0, height = 0, channels = 0;
+        bool warm = false;
+        if (spec.u8) {
+            ConvParams params = spec.params;
+            params.threads = threads;
+            const Image8 out = Convolver::convolve(Image8::load(input, spec.grayscale), cache.kernel(spec.kernel, &warm), params);
+            out.save(output);
+            width = out.width(); height = out.height(); channels = out.channels();
+        } else {
+            const Image out = cache.pipeline(spec, &warm)->run(Image::load(input, spec.grayscale), threads);
+            out.save(output);
+            width = out.width(); height = out.height(); channels = out.channels();
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::ostringstream os;
+        os << "{\"id\":" << id << ",\"ok\":true,\"output\":" << json_string(output) << ",\"width\":" << width
+           << ",\"height\":" << height << ",\"channels\":" << channels << ",\"warm\":" << (warm ? "true" : "false")
+           << ",\"ms\":" << ms << "}";
+        job.reply->send(os.str());
+    } catch (const std::exception& e) {
+        job.reply->send(error_reply(id, e.what()));
+    }
+}
+
+// Calls fn(line) for each '\n'-terminated line read from fd until end of
+// input or until fn returns false. Lines over kMaxLine are rejected.
+template <typename Fn>
+void read_lines(int fd, Connection& reply, Fn&& fn) {
+    constexpr size_t kMaxLine = 1 << 20;
+    std::string pending;
+    char buf[65536];
+    for (;;) {
+        const ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0) break;
+        pending.append(buf, (size_t)n);
+        size_t start = 0;
+        for (size_t nl; (nl = pending.find('\n', start)) != std::string::npos; start = nl + 1)
+            if (!fn(pending.substr(start, nl - start))) return;
+        pending.erase(0, start);
+        if (pending.size() > kMaxLine) {
+            reply.send(error_reply("null", "line too long"));
+            return;
+        }
+    }
+    if (!pending.empty()) fn(pending);
+}
+
+std::atomic<bool> g_stop{false};
+std::atomic<int> g_listen_fd{-1};
+
+// shutdown() is async-signal-safe; it wakes the thread blocked in accept().
+void on_signal(int) {
+    g_stop = true;
+    const int fd = g_listen_fd.load();
+    if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+}
+
+}
+
+int serve(const ServeOptions& options) {
+    std::signal(SIGPIPE, SIG_IGN);
+    const int workers = options.workers > 0 ? options.workers : ThreadPool::resolve(0);
+    const int threads = std::max(1, options.threads);
+
+    WarmCache cache;
+    detail::BoundedQueue<Job> queue((size_t)workers * 2, 1);
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; ++i)
+        pool.emplace_back([&] { for (Job job; queue.pop(job);) run_job(job, cache, threads); });
+
+    // One line from a client: a job for the workers or a control command.
+    // Returns false when the line asks the server to stop.
+    auto handle = [&](const std::string& line, const std::shared_ptr<Connection>& reply) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) return true;
+        try {
+            JsonObject fields = JsonParser(line).object();
+            const auto cmd = fields.find("cmd");
+            if (cmd == fields.end()) {
+                queue.push(Job{std::move(fields), reply}); // blocks while the workers are behind
+                return true;
+            }
+            const std::string id = fields.count("id") ? json_value(fields["id"]) : "null";
+            if (cmd->second.str == "ping") { reply->send("{\"id\":" + id + ",\"ok\":true}"); return true; }
+            if (cmd->second.str == "shutdown") { reply->send("{\"id\":" + id + ",\"ok\":true}"); return false; }
+            reply->send(error_reply(id, "unknown cmd"));
+        } catch (const std::exception& e) {
+            reply->send(error_reply("null", e.what()));
+        }
+        return true;
+    };
+
+    auto drain = [&] {
+        queue.producer_done();
+        for (auto& t : pool) t.join();
+    };
+
+    if (options.socket_path.empty()) {
+        auto out = std::make_shared<Connection>(STDOUT_FILENO, false);
+        read_lines(STDIN_FILENO, *out, [&](const std::string& line) { return handle(line, out); });
+        drain();
+        return 0;
+    }
+
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (listen_fd < 0 || options.socket_path.size() >= sizeof addr.sun_path) {
+        drain();
+        throw std::runtime_error("Cannot create socket: " + options.socket_path);
+    }
+    std::strncpy(addr.sun_path, options.socket_path.c_str(), sizeof addr.sun_path - 1);
+    ::unlink(options.socket_path.c_str());
+    if (::bind(listen_fd, (const sockaddr*)&addr, sizeof addr) != 0 || ::listen(listen_fd, 64) != 0) {
+        ::close(listen_fd);
+        drain();
+        throw std::runtime_error("Cannot listen on " + options.socket_path + ": " + std::strerror(errno));
+    }
+    g_listen_fd = listen_fd;
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+
+    // One reader thread per client; finished ones are joined as new clients arrive.
+    struct Client { std::thread thread; std::shared_ptr<std::atomic<bool>> done; };
+    std::list<Client> clients;
+    std::mutex open_mutex;
+    std::set<int> open_fds;
+    while (!g_stop) {
+        const int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        for (auto it = clients.begin(); it != clients.end();)
+            if (*it->done) { it->thread.join(); it = clients.erase(it); } else ++it;
+        {
+            std::lock_guard<std::mutex> lock(open_mutex);
+            open_fds.insert(fd);
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        clients.push_back(Client{std::thread([&, fd, done] {
+            auto conn = std::make_shared<Connection>(fd, true);
+            read_lines(fd, *conn, [&](const std::string& line) {
+                if (handle(line, conn)) return true;
+                on_signal(0);
+                return false;
+            });
+            {
+                std::lock_guard<std::mutex> lock(open_mutex);
+                open_fds.erase(fd);
+            }
+            *done = true;
+        }), done});
+    }
+
+    // stop reading; jobs already queued still run and get their replies
+    g_listen_fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex);
+        for (int fd : open_fds) ::shutdown(fd, SHUT_RD);
+    }
+    for (auto& c : clients) c.thread.join();
+    drain();
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+    return 0;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+namespace lumine {
+
+struct ServeOptions {
+    std::string socket_path; // empty = jobs on stdin, replies on stdout
+    int workers{0};          // jobs processed at once; 0 = hardware threads
+    int threads{1};          // threads per job
+};
+
+// `lumine --serve`: a long-running worker that takes one JSON job per line
+// and answers each with one JSON line, keeping the thread pool, buffer pool,
+// parsed kernels and convolution plans warm between jobs.
+//
+//   {"id": 7, "input": "a.png", "output": "b.png", "kernel": "gauss5",
+//    "grayscale": true, "denoise": true, "binarize": true}
+//   -> {"id":7,"ok":true,"output":"b.png","width":640,"height":480,"channels":1,"warm":false,"ms":12.5}
+//
+// Job keys mirror the command line flags: kernel, stride, padding, viz,
+// algo, rank_tolerance, grayscale, denoise, denoise_radius, binarize,
+// binarize_k, window_size, u8. "warm" says whether the job's pipeline (or
+// kernel, with u8) was already cached. Replies to concurrent jobs come in
+// completion order; "id" (any JSON scalar) is echoed back, normalized, to
+// match them up. A line that is not valid JSON gets an error reply with a
+// null id. Control lines: {"cmd": "ping"} and {"cmd": "shutdown"}. With a
+// socket, each connection is a separate stream of jobs and the server runs
+// until shutdown, SIGINT or SIGTERM; on stdin it stops at end of input once
+// every job has been answered. Returns the process exit code.
+int serve(const ServeOptions& options);
+
+}
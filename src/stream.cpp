@@ -0,0 +1,312 @@
+#include "lumine/stream.hpp"
+#include "lumine/trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+namespace lumine {
+
+namespace {
+
+constexpr int kChunkRows = 64;
+
+bool ends_with(const std::string& s, const std::string& suf) {
+    return s.size() >= suf.size() && std::equal(suf.rbegin(), suf.rend(), s.rbegin());
+}
+
+struct FileCloser { void operator()(std::FILE* f) const { if (f) std::fclose(f); } };
+using File = std::unique_ptr<std::FILE, FileCloser>;
+
+// stb_image's luma for RGB -> gray.
+inline uint8_t luma(const uint8_t* p) { return (uint8_t)((p[0] * 77 + p[1] * 150 + 29 * p[2]) >> 8); }
+
+// Fixed-size rows of raw samples at a known file offset: 8-bit P5/P6 and
+// 24-bit BMP. `comp` samples per pixel are stored (BMP as BGR, bottom-up
+// unless the height is negative).
+class RawReader : public ImageReader {
+    public:
+        RawReader(File file, int w, int h, bool gray, int comp, long offset, size_t row_bytes, bool bgr, bool bottom_up)
+            : ImageReader(w, h, gray ? 1 : comp), m_file(std::move(file)), m_comp(comp), m_offset(offset),
+              m_row_bytes(row_bytes), m_bgr(bgr), m_bottom_up(bottom_up), m_line(row_bytes) {
+            if (!m_bottom_up && std::fseek(m_file.get(), m_offset, SEEK_SET) != 0)
+                throw std::runtime_error("Failed to read image rows");
+        }
+
+    protected:
+        void read_rows(uint8_t* rows, int count) override {
+            const int w = width(), out = channels();
+            for (int i = 0; i < count; ++i) {
+                if (m_bottom_up) {
+                    const long y = height() - 1 - (position() + i);
+                    if (std::fseek(m_file.get(), m_offset + y * (long)m_row_bytes, SEEK_SET) != 0)
+                        throw std::runtime_error("Failed to read image rows");
+                }
+                if (std::fread(m_line.data(), 1, m_row_bytes, m_file.get()) != m_row_bytes)
+                    throw std::runtime_error("Image file truncated");
+                uint8_t* dst = rows + (size_t)i * w * out;
+                for (int x = 0; x < w; ++x) {
+                    const uint8_t* s = &m_line[(size_t)x * m_comp];
+                    uint8_t px[3] = {s[0], s[0], s[0]};
+                    if (m_comp == 3) {
+                        px[0] = s[m_bgr ? 2 : 0]; px[1] = s[1]; px[2] = s[m_bgr ? 0 : 2];
+                    }
+                    if (out == 1) dst[x] = m_comp == 1 ? px[0] : luma(px);
+                    else std::copy_n(px, 3, dst + (size_t)x * 3);
+                }
+            }
+        }
+
+    private:
+        File m_file;
+        int m_comp;
+        long m_offset;
+        size_t m_row_bytes;
+        bool m_bgr, m_bottom_up;
+        std::vector<uint8_t> m_line;
+};
+
+// Everything else: stb_image decodes the whole file up front.
+class DecodedReader : public ImageReader {
+    public:
+        DecodedReader(uint8_t* pixels, int w, int h, int comp, int channels)
+            : ImageReader(w, h, channels), m_pixels(pixels, stbi_image_free), m_comp(comp) {}
+
+    protected:
+        void read_rows(uint8_t* rows, int count) override {
+            const int w = width(), out = channels();
+            const uint8_t* src = m_pixels.get() + (size_t)position() * w * m_comp;
+            for (size_t i = 0; i < (size_t)count * w; ++i)
+                for (int c = 0; c < out; ++c) rows[i * out + c] = src[i * m_comp + c];
+        }
+
+    private:
+        std::unique_ptr<uint8_t, void (*)(void*)> m_pixels;
+        int m_comp;
+};
+
+// Header of a binary PGM/PPM, parsed the way stb_image parses it so that
+// both read the same samples. Returns false for anything but 8-bit P5/P6.
+bool parse_pnm(std::FILE* f, int& w, int& h, int& comp, long& offset) {
+    auto get = [f] { const int c = std::fgetc(f); return c == EOF ? 0 : (char)c; };
+    auto space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; };
+    auto skip = [&](char& c) {
+        for (;;) {
+            while (!std::feof(f) && space(c)) c = get();
+            if (std::feof(f) || c != '#') break;
+            while (!std::feof(f) && c != '\n' && c != '\r') c = get();
+        }
+    };
+    auto integer = [&](char& c) {
+        long v = 0;
+        while (!std::feof(f) && c >= '0' && c <= '9' && v <= (1L << 24)) { v = v * 10 + (c - '0'); c = get(); }
+        return (int)std::min(v, 1L << 25);
+    };
+    if (get() != 'P') return false;
+    const char t = get();
+    if (t != '5' && t != '6') return false;
+    comp = t == '6' ? 3 : 1;
+    char c = get();
+    skip(c); w = integer(c);
+    skip(c); h = integer(c);
+    skip(c); const int maxv = integer(c);
+    offset = std::ftell(f);
+    return !std::feof(f) && w > 0 && h > 0 && w <= (1 << 24) && h <= (1 << 24) && maxv <= 255;
+}
+
+// Uncompressed 24-bit BMP with a BITMAPINFOHEADER.
+bool parse_bmp(std::FILE* f, int& w, int& h, bool& bottom_up, long& offset) {
+    uint8_t hdr[54];
+    if (std::fread(hdr, 1, sizeof hdr, f) != sizeof hdr || hdr[0] != 'B' || hdr[1] != 'M') return false;
+    auto u16 = [&](int i) { return (uint32_t)hdr[i] | (uint32_t)hdr[i + 1] << 8; };
+    auto u32 = [&](int i) { return u16(i) | u16(i + 2) << 16; };
+    if (u32(14) != 40 || u16(26) != 1 || u16(28) != 24 || u32(30) != 0) return false;
+    w = (int)u32(18);
+    const int sh = (int)u32(22);
+    bottom_up = sh > 0;
+    h = sh < 0 ? -sh : sh;
+    offset = (long)u32(10);
+    return w > 0 && h > 0 && w <= (1 << 24) && h <= (1 << 24);
+}
+
+class RawWriter : public ImageWriter {
+    public:
+        // BMP rows are stored bottom-up, BGR, padded to 4 bytes; the header
+        // matches stbi_write_bmp byte for byte.
+        RawWriter(const std::string& path, int w, int h, int c, bool bmp)
+            : ImageWriter(w, h, c), m_bmp(bmp), m_file(std::fopen(path.c_str(), "wb")), m_path(path) {
+            if (!m_file) throw std::runtime_error("Failed to write image: " + path);
+            std::string header;
+            if (bmp) {
+                const int pad = (-w * 3) & 3;
+                m_row_bytes = (size_t)w * 3 + pad;
+                auto put = [&](uint32_t v, int bytes) { for (int i = 0; i < bytes; ++i) header += (char)(v >> (8 * i)); };
+                header += "BM";
+                put((uint32_t)(54 + m_row_bytes * h), 4); put(0, 2); put(0, 2); put(54, 4);
+                put(40, 4); put((uint32_t)w, 4); put((uint32_t)h, 4); put(1, 2); put(24, 2);
+                for (int i = 0; i < 6; ++i) put(0, 4);
+            } else {
+                m_row_bytes = (size_t)w * (c == 1 ? 1 : 3);
+                header = std::string(c == 1 ? "P5" : "P6") + "\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n";
+            }
+            m_offset = (long)header.size();
+            if (std::fwrite(header.data(), 1, header.size(), m_file.get()) != header.size())
+                throw std::runtime_error("Failed to write image: " + path);
+            m_line.resize(m_row_bytes);
+        }
+
+    protected:
+        void write_rows(const uint8_t* rows, int count) override {
+            const int w = width(), in = channels() == 1 ? 1 : 3;
+            for (int i = 0; i < count; ++i) {
+                const uint8_t* src = rows + (size_t)i * w * in;
+                const uint8_t* line = src;
+                if (m_bmp) {
+                    for (int x = 0; x < w; ++x) {
+                        const uint8_t* p = src + (size_t)x * in;
+                        m_line[(size_t)x * 3 + 0] = p[in == 1 ? 0 : 2];
+                        m_line[(size_t)x * 3 + 1] = p[in == 1 ? 0 : 1];
+                        m_line[(size_t)x * 3 + 2] = p[0];
+                    }
+                    const long y = height() - 1 - (m_rows + i);
+                    if (std::fseek(m_file.get(), m_offset + y * (long)m_row_bytes, SEEK_SET) != 0)
+                        throw std::runtime_error("Failed to write image: " + m_path);
+                    line = m_line.data();
+                }
+                if (std::fwrite(line, 1, m_row_bytes, m_file.get()) != m_row_bytes)
+                    throw std::runtime_error("Failed to write image: " + m_path);
+            }
+            m_rows += count;
+        }
+        void close() override {
+            if (std::fclose(m_file.release()) != 0) throw std::runtime_error("Failed to write image: " + m_path);
+        }
+
+    private:
+        bool m_bmp;
+        File m_file;
+        std::string m_path;
+        size_t m_row_bytes{0};
+        long m_offset{0};
+        int m_rows{0};
+        std::vector<uint8_t> m_line;
+};
+
+// PNG and JPEG compress the image as a whole: rows are kept as 8-bit
+// samples and handed to stb_image_write by close().
+class EncodedWriter : public ImageWriter {
+    public:
+        EncodedWriter(const std::string& path, int w, int h, int c)
+            : ImageWriter(w, h, c), m_path(path), m_pixels((size_t)w * h * (c == 1 ? 1 : 3)) {}
+
+    protected:
+        void write_rows(const uint8_t* rows, int count) override {
+            const size_t n = (size_t)count * width() * (channels() == 1 ? 1 : 3);
+            std::copy_n(rows, n, m_pixels.data() + m_used);
+            m_used += n;
+        }
+        void close() override {
+            const int w = width(), h = height(), comp = channels() == 1 ? 1 : 3;
+            const int written = ends_with(m_path, ".png")
+                ? stbi_write_png(m_path.c_str(), w, h, comp, m_pixels.data(), w * comp)
+                : stbi_write_jpg(m_path.c_str(), w, h, comp, m_pixels.data(), 90);
+            std::vector<uint8_t>().swap(m_pixels);
+            if (!written) throw std::runtime_error("Failed to write image: " + m_path);
+        }
+
+    private:
+        std::string m_path;
+        std::vector<uint8_t> m_pixels;
+        size_t m_used{0};
+};
+
+}
+
+void ImageReader::read(ImageView rows) {
+    if (rows.width() != m_width || rows.channels() != m_channels)
+        throw std::runtime_error("ImageReader::read: rows do not match the image");
+    if (rows.height() > m_height - m_next) throw std::runtime_error("ImageReader::read: past the last row");
+    LUMINE_TRACE_SCOPE("stream.read", "first_row", m_next, "rows", rows.height());
+    std::vector<uint8_t> buf((size_t)std::min(rows.height(), kChunkRows) * m_width * m_channels);
+    for (int y0 = 0; y0 < rows.height(); y0 += kChunkRows) {
+        const int n = std::min(kChunkRows, rows.height() - y0);
+        read_rows(buf.data(), n);
+        m_next += n;
+        for (int y = 0; y < n; ++y)
+            for (int c = 0; c < m_channels; ++c) {
+                const uint8_t* src = buf.data() + (size_t)y * m_width * m_channels + c;
+                float* dst = rows.row(y0 + y, c);
+                for (int x = 0; x < m_width; ++x) dst[x] = convert_pixel<float>(src[(size_t)x * m_channels]);
+            }
+    }
+}
+
+std::unique_ptr<ImageReader> ImageReader::open(const std::string& path, bool force_grayscale) {
+    File f(std::fopen(path.c_str(), "rb"));
+    if (!f) throw std::runtime_error("Failed to load image: " + path);
+    int w = 0, h = 0, comp = 0;
+    long offset = 0;
+    bool bottom_up = false;
+    if (parse_pnm(f.get(), w, h, comp, offset))
+        return std::unique_ptr<ImageReader>(new RawReader(std::move(f), w, h, force_grayscale, comp, offset,
+                                                          (size_t)w * comp, false, false));
+    std::rewind(f.get());
+    if (parse_bmp(f.get(), w, h, bottom_up, offset))
+        return std::unique_ptr<ImageReader>(new RawReader(std::move(f), w, h, force_grayscale, 3, offset,
+                                                          (size_t)w * 3 + ((-w * 3) & 3), true, bottom_up));
+    f.reset();
+
+    uint8_t* pixels = stbi_load(path.c_str(), &w, &h, &comp, force_grayscale ? 1 : 0);
+    if (!pixels) throw std::runtime_error("Failed to load image: " + path);
+    const int ch = force_grayscale ? 1 : comp;
+    if (ch != 1 && ch != 3 && ch != 4) {
+        stbi_image_free(pixels);
+        throw std::runtime_error("Unsupported number of channels: " + std::to_string(ch));
+    }
+    return std::unique_ptr<ImageReader>(new DecodedReader(pixels, w, h, ch, ch == 4 ? 3 : ch));
+}
+
+void ImageWriter::write(ConstImageView rows) {
+    if (m_finished) throw std::runtime_error("ImageWriter::write: already finished");
+    if (rows.width() != m_width || rows.channels() != m_channels)
+        throw std::runtime_error("ImageWriter::write: rows do not match the image");
+    if (rows.height() > m_height - m_next) throw std::runtime_error("ImageWriter::write: past the last row");
+    LUMINE_TRACE_SCOPE("stream.write", "first_row", m_next, "rows", rows.height());
+    const int comp = m_channels == 1 ? 1 : 3;
+    std::vector<uint8_t> buf((size_t)std::min(rows.height(), kChunkRows) * m_width * comp);
+    for (int y0 = 0; y0 < rows.height(); y0 += kChunkRows) {
+        const int n = std::min(kChunkRows, rows.height() - y0);
+        for (int y = 0; y < n; ++y)
+            for (int c = 0; c < comp; ++c) {
+                const float* src = rows.row(y0 + y, c);
+                uint8_t* dst = buf.data() + (size_t)y * m_width * comp + c;
+                for (int x = 0; x < m_width; ++x) dst[(size_t)x * comp] = convert_pixel<uint8_t>(src[x]);
+            }
+        write_rows(buf.data(), n);
+        m_next += n;
+    }
+}
+
+void ImageWriter::finish() {
+    if (m_finished) return;
+    if (m_next != m_height) throw std::runtime_error("ImageWriter::finish: image incomplete");
+    LUMINE_TRACE_SCOPE("stream.finish");
+    m_finished = true;
+    close();
+}
+
+std::unique_ptr<ImageWriter> ImageWriter::open(const std::string& path, int width, int height, int channels) {
+    if (width <= 0 || height <= 0 || channels <= 0) throw std::runtime_error("ImageWriter: empty image");
+    if (ends_with(path, ".bmp"))
+        return std::unique_ptr<ImageWriter>(new RawWriter(path, width, height, channels, true));
+    if (ends_with(path, ".pgm") || ends_with(path, ".ppm") || ends_with(path, ".pnm"))
+        return std::unique_ptr<ImageWriter>(new RawWriter(path, width, height, channels, false));
+    if (ends_with(path, ".png") || ends_with(path, ".jpg") || ends_with(path, ".jpeg"))
+        return std::unique_ptr<ImageWriter>(new EncodedWriter(path, width, height, channels));
+    throw std::runtime_error("Unsupported image format for save: " + path);
+}
+
+}
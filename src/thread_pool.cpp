@@ -0,0 +1,137 @@
+#include "lumine/thread_pool.hpp"
+#include "lumine/trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace lumine {
+
+namespace {
+
+thread_local bool t_is_worker = false;
+
+// Shared between the caller and its helpers; helpers that start after the
+// last chunk was claimed only touch the counters, never `fn`.
+struct LoopState {
+    int first{0}, last{0}, grain{1}, chunks{0};
+    const std::function<void(int, int)>* fn{nullptr};
+    const char* trace_name{nullptr}; // caller's scope; chunks are traced as its tiles
+    std::atomic<int> next{0};
+    std::atomic<int> done{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+
+    void run_chunks() {
+        for (;;) {
+            int i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= chunks) return;
+            int b = first + i * grain;
+            int e = std::min(last, b + grain);
+            try {
+                LUMINE_TRACE_SCOPE(trace_name, trace::Tile{i}, "begin", b, "end", e);
+                (*fn)(b, e);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lk(mutex);
+                if (!error) error = std::current_exception();
+            }
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                std::lock_guard<std::mutex> lk(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+ThreadPool::ThreadPool(int threads) {
+    int n = resolve(threads);
+    m_workers.reserve((size_t)n - 1);
+    for (int i = 1; i < n; ++i)
+        m_workers.emplace_back([this]{ worker_loop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_workers) t.join();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool(0);
+    return pool;
+}
+
+int ThreadPool::resolve(int threads) {
+    int hw = (int)std::thread::hardware_concurrency();
+    if (hw <= 0) hw = 1;
+    return threads <= 0 || threads > hw ? hw : threads;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (m_workers.empty()) {
+        try { task(); } catch (...) {}
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+    t_is_worker = true;
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_cv.wait(lk, [this]{ return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        try { task(); } catch (...) {}
+    }
+}
+
+void ThreadPool::parallel_for(int first, int last, int grain,
+                              const std::function<void(int, int)>& fn, int max_threads) {
+    if (last <= first) return;
+    grain = std::max(1, grain);
+    const int chunks = (last - first + grain - 1) / grain;
+    int threads = max_threads > 0 ? std::min(max_threads, size()) : size();
+    threads = std::min(threads, chunks);
+    if (threads <= 1 || t_is_worker) {
+        fn(first, last);
+        return;
+    }
+
+    auto state = std::make_shared<LoopState>();
+    state->first = first;
+    state->last = last;
+    state->grain = grain;
+    state->chunks = chunks;
+    state->fn = &fn;
+#if LUMINE_TRACE
+    state->trace_name = trace::Scope::current() ? trace::Scope::current() : "parallel_for";
+#endif
+
+    for (int i = 1; i < threads; ++i)
+        submit([state]{ state->run_chunks(); });
+    state->run_chunks();
+
+    {
+        std::unique_lock<std::mutex> lk(state->mutex);
+        state->cv.wait(lk, [&]{ return state->done.load(std::memory_order_acquire) == chunks; });
+    }
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+}
@@ -0,0 +1,244 @@
+#include "lumine/trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace lumine::trace {
+
+namespace detail { std::atomic<bool> g_active{false}; }
+
+namespace {
+
+enum class Phase : char { Complete = 'X', Counter = 'C', Instant = 'i' };
+
+struct Event {
+    Phase phase{Phase::Complete};
+    const char* name{nullptr};
+    int64_t start{0}, duration{0}; // ns since the session started
+    int tile{-1};
+    const char* key[2]{nullptr, nullptr};
+    double value[2]{0, 0};
+    std::string text; // notes
+};
+
+// Events of one thread. The owning thread appends under its own (normally
+// uncontended) mutex; the writers lock it to read.
+struct ThreadBuffer {
+    int tid{0};
+    std::mutex mutex;
+    std::vector<Event> events;
+};
+
+struct Session {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers; // kept after their thread exits
+    std::map<std::string, double> counters;
+    std::atomic<int64_t> epoch_ns{0};
+};
+
+Session& session() { static Session s; return s; }
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t since_start() { return now_ns() - session().epoch_ns.load(std::memory_order_relaxed); }
+
+ThreadBuffer& buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+    if (!t_buffer) {
+        t_buffer = std::make_shared<ThreadBuffer>();
+        Session& s = session();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        t_buffer->tid = (int)s.buffers.size();
+        s.buffers.push_back(t_buffer);
+    }
+    return *t_buffer;
+}
+
+void record(Event e) {
+    ThreadBuffer& b = buffer();
+    std::lock_guard<std::mutex> lock(b.mutex);
+    b.events.push_back(std::move(e));
+}
+
+thread_local const char* t_current = nullptr;
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20) { char buf[8]; std::snprintf(buf, sizeof buf, "\\u%04x", c); out += buf; }
+        else out += c;
+    }
+    return out;
+}
+
+// Snapshot of every thread's events, as (tid, event).
+std::vector<std::pair<int, Event>> collect() {
+    Session& s = session();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        buffers = s.buffers;
+    }
+    std::vector<std::pair<int, Event>> all;
+    for (const auto& b : buffers) {
+        std::lock_guard<std::mutex> lock(b->mutex);
+        for (const Event& e : b->events) all.emplace_back(b->tid, e);
+    }
+    std::stable_sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.second.start < b.second.start; });
+    return all;
+}
+
+}
+
+void start() {
+    Session& s = session();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& b : s.buffers) {
+            std::lock_guard<std::mutex> bl(b->mutex);
+            b->events.clear();
+        }
+        s.counters.clear();
+    }
+    s.epoch_ns.store(now_ns(), std::memory_order_relaxed);
+    detail::g_active.store(true, std::memory_order_release);
+}
+
+void stop() { detail::g_active.store(false, std::memory_order_release); }
+
+void count(const char* name, double value) {
+    if (!active()) return;
+    Session& s = session();
+    double total;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total = s.counters[name] += value;
+    }
+    Event e;
+    e.phase = Phase::Counter;
+    e.name = name;
+    e.start = since_start();
+    e.value[0] = total;
+    record(std::move(e));
+}
+
+void note(const char* key, const std::string& value) {
+    if (!active()) return;
+    Event e;
+    e.phase = Phase::Instant;
+    e.name = key;
+    e.start = since_start();
+    e.text = value;
+    record(std::move(e));
+}
+
+Scope::Scope(const char* name, Tile tile, const char* key1, double value1, const char* key2, double value2)
+    : m_name(name), m_key{key1, key2}, m_value{value1, value2}, m_tile(tile.id) {
+    if (!active()) return;
+    m_outer = t_current;
+    t_current = name;
+    m_start = since_start();
+}
+
+Scope::~Scope() {
+    if (m_start < 0) return;
+    t_current = m_outer;
+    Event e;
+    e.name = m_name;
+    e.start = m_start;
+    e.duration = since_start() - m_start;
+    e.tile = m_tile;
+    e.key[0] = m_key[0]; e.key[1] = m_key[1];
+    e.value[0] = m_value[0]; e.value[1] = m_value[1];
+    record(std::move(e));
+}
+
+const char* Scope::current() { return t_current; }
+
+void write_chrome_trace(const std::string& path) {
+    const auto events = collect();
+    std::ofstream f(path);
+    if (!f) throw std::runtime_error("Failed to write trace: " + path);
+    f << std::setprecision(12) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    f << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"lumine\"}}";
+    std::set<int> tids;
+    for (const auto& te : events) tids.insert(te.first);
+    for (int tid : tids)
+        f << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+          << ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+    for (const auto& [tid, e] : events) {
+        f << ",\n{\"name\": \"" << json_escape(e.name) << "\", \"ph\": \"" << (char)e.phase
+          << "\", \"pid\": 1, \"tid\": " << tid << ", \"ts\": " << e.start / 1e3;
+        if (e.phase == Phase::Complete) {
+            f << ", \"dur\": " << e.duration / 1e3 << ", \"cat\": \"" << (e.tile >= 0 ? "tile" : "op") << "\"";
+            f << ", \"args\": {";
+            const char* sep = "";
+            if (e.tile >= 0) { f << "\"tile\": " << e.tile; sep = ", "; }
+            for (int i = 0; i < 2; ++i)
+                if (e.key[i]) { f << sep << "\"" << json_escape(e.key[i]) << "\": " << e.value[i]; sep = ", "; }
+            f << "}";
+        } else if (e.phase == Phase::Counter) {
+            f << ", \"args\": {\"value\": " << e.value[0] << "}";
+        } else {
+            f << ", \"s\": \"t\", \"args\": {\"value\": \"" << json_escape(e.text) << "\"}";
+        }
+        f << "}";
+    }
+    f << "\n]}\n";
+    if (!f) throw std::runtime_error("Failed to write trace: " + path);
+}
+
+std::string summary() {
+    struct Row { int calls{0}; int64_t total{0}, max{0}; std::set<int> threads; };
+    std::map<std::string, Row> rows;
+    std::map<std::string, int> notes;
+    for (const auto& [tid, e] : collect()) {
+        if (e.phase == Phase::Complete) {
+            Row& r = rows[std::string(e.name) + (e.tile >= 0 ? " [tiles]" : "")];
+            ++r.calls;
+            r.total += e.duration;
+            r.max = std::max(r.max, e.duration);
+            r.threads.insert(tid);
+        } else if (e.phase == Phase::Instant) {
+            ++notes[std::string(e.name) + " = " + e.text];
+        }
+    }
+    std::vector<std::pair<std::string, Row>> sorted(rows.begin(), rows.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.total > b.second.total; });
+
+    std::ostringstream os;
+    os << std::fixed << std::left << std::setw(32) << "scope" << std::right << std::setw(8) << "calls"
+       << std::setw(12) << "total ms" << std::setw(11) << "mean ms" << std::setw(11) << "max ms"
+       << std::setw(9) << "threads" << "\n";
+    for (const auto& [name, r] : sorted)
+        os << std::left << std::setw(32) << name << std::right << std::setw(8) << r.calls << std::setprecision(3)
+           << std::setw(12) << r.total / 1e6 << std::setw(11) << r.total / 1e6 / r.calls << std::setw(11)
+           << r.max / 1e6 << std::setw(9) << r.threads.size() << "\n";
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.counters.empty()) {
+        os << "\n" << std::left << std::setw(32) << "counter" << std::right << std::setw(20) << "total" << "\n";
+        for (const auto& [name, total] : s.counters)
+            os << std::left << std::setw(32) << name << std::right << std::setprecision(0) << std::setw(20) << total << "\n";
+    }
+    if (!notes.empty()) {
+        os << "\n" << std::left << std::setw(52) << "note" << std::right << std::setw(8) << "times" << "\n";
+        for (const auto& [text, n] : notes) os << std::left << std::setw(52) << text << std::right << std::setw(8) << n << "\n";
+    }
+    return os.str();
+}
+
+}
@@ -0,0 +1,33 @@
+# The --baseline regression gate of lumine_bench: one tiny case is compared
+# against a baseline that is far faster (must fail with exit status 1) and
+# one that is far slower (must pass). Run by ctest with -DBENCH=<path> and
+# -DWORK=<scratch dir>.
+set(name "conv/box3/s1/zero")
+set(args --filter ${name} --sizes 64x48 --threads 1 --reps 1 --min-time 0)
+
+function(write_baseline path ns)
+    file(WRITE ${path} "{\n  \"lumine_bench\": 1,\n  \"results\": [\n"
+         "    {\"name\": \"${name}/64x48/t1\", \"case\": \"${name}\", \"ns_per_pixel\": ${ns}}\n  ]\n}\n")
+endfunction()
+
+file(MAKE_DIRECTORY ${WORK})
+write_baseline(${WORK}/fast.json 1e-9)
+execute_process(COMMAND ${BENCH} ${args} --baseline ${WORK}/fast.json RESULT_VARIABLE rc OUTPUT_VARIABLE out)
+if (NOT rc EQUAL 1 OR NOT out MATCHES "REGRESSION" OR NOT out MATCHES "1 of 1 cases more than 10% slower")
+    message(FATAL_ERROR "expected a regression (exit ${rc}):\n${out}")
+endif()
+
+write_baseline(${WORK}/slow.json 1e9)
+execute_process(COMMAND ${BENCH} ${args} --baseline ${WORK}/slow.json --tolerance 0.25 RESULT_VARIABLE rc
+                OUTPUT_VARIABLE out)
+if (NOT rc EQUAL 0 OR out MATCHES "REGRESSION" OR NOT out MATCHES "0 of 1 cases more than 25% slower")
+    message(FATAL_ERROR "expected no regression (exit ${rc}):\n${out}")
+endif()
+
+# a baseline written by --json reads back and matches its own case
+execute_process(COMMAND ${BENCH} ${args} --json ${WORK}/own.json RESULT_VARIABLE rc OUTPUT_QUIET)
+execute_process(COMMAND ${BENCH} ${args} --baseline ${WORK}/own.json --tolerance 1000 RESULT_VARIABLE rc
+                OUTPUT_VARIABLE out)
+if (NOT rc EQUAL 0 OR out MATCHES "\\(new\\)")
+    message(FATAL_ERROR "own baseline not matched (exit ${rc}):\n${out}")
+endif()
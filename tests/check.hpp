@@ -0,0 +1,15 @@
+#pragma once
+#include <iostream>
+
+// CHECK(cond, what...) prints what... (streamed) when cond is false and
+// counts the failure; return check_failures() != 0 from main.
+inline int& check_failures() { static int n = 0; return n; }
+
+#define CHECK(cond, ...)                                                                    \
+    do {                                                                                    \
+        if (!(cond)) {                                                                      \
+            ++check_failures();                                                             \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << ": " << __VA_ARGS__ \
+                      << "\n";                                                              \
+        }                                                                                   \
+    } while (0)
@@ -0,0 +1,47 @@
+# `lumine --serve` on stdin: a bad job or a malformed line gets an error
+# reply and the other jobs still run, ids come back normalized, and a
+# repeated job reuses the cached pipeline. Run by ctest with
+# -DLUMINE=<path> and -DWORK=<scratch dir>.
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+# an 8x6 gray PGM; printable bytes only, so file(WRITE) can make it
+string(REPEAT "A0z~" 12 pixels)
+file(WRITE ${WORK}/in.pgm "P5\n8 6\n255\n${pixels}")
+
+set(job "\"input\": \"in.pgm\", \"kernel\": \"gauss5\", \"binarize\": true")
+file(WRITE ${WORK}/jobs.txt
+     "{\"id\": 1, ${job}, \"output\": \"a.png\"}\n"
+     "{\"id\": \"two\", ${job}, \"output\": \"b.png\"}\n"
+     "{\"id\": 3, ${job}, \"output\": \"c.png\", \"binarize_k\": 0.2000001}\n"
+     "{\"id\": 4, \"input\": \"missing.pgm\", \"output\": \"d.png\", \"kernel\": \"gauss5\"}\n"
+     "{\"id\": 5, \"input\": \n"
+     "{\"id\": 0x10, ${job}, \"output\": \"e.png\"}\n"
+     "{\"id\": 1e999, ${job}, \"output\": \"f.png\"}\n"
+     "{\"id\": -0.50E+1, \"cmd\": \"ping\"}\n")
+execute_process(COMMAND ${LUMINE} --serve --jobs 1 WORKING_DIRECTORY ${WORK} INPUT_FILE ${WORK}/jobs.txt
+                RESULT_VARIABLE rc OUTPUT_VARIABLE out)
+
+function(expect what regex)
+    if (NOT out MATCHES "${regex}")
+        message(FATAL_ERROR "${what}: no reply matching ${regex} in:\n${out}")
+    endif()
+endfunction()
+
+if (NOT rc EQUAL 0)
+    message(FATAL_ERROR "lumine --serve exited with ${rc}:\n${out}")
+endif()
+expect("first job" "{\"id\":1,\"ok\":true,[^\n]*\"warm\":false")
+expect("repeated job" "{\"id\":\"two\",\"ok\":true,[^\n]*\"warm\":true")
+expect("job with another binarize_k" "{\"id\":3,\"ok\":true,[^\n]*\"warm\":false")
+expect("missing input" "{\"id\":4,\"ok\":false,\"error\":")
+expect("normalized id" "{\"id\":-5,\"ok\":true}")
+string(REGEX MATCHALL "{\"id\":null,\"ok\":false,\"error\":\"invalid JSON" bad "${out}")
+list(LENGTH bad n)
+if (NOT n EQUAL 3)
+    message(FATAL_ERROR "expected 3 invalid JSON replies (truncated, hex, out of range), got ${n}:\n${out}")
+endif()
+foreach(f a.png b.png c.png)
+    if (NOT EXISTS ${WORK}/${f})
+        message(FATAL_ERROR "${f} was not written:\n${out}")
+    endif()
+endforeach()
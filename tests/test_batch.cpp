@@ -0,0 +1,55 @@
+// A batch with a missing input, an undecodable file and a job whose
+// processing throws: each is reported in job order and the other images
+// still come out.
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "lumine/batch.hpp"
+
+using namespace lumine;
+namespace fs = std::filesystem;
+
+int main() {
+    const fs::path dir = "test_batch_work";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "out");
+
+    std::vector<BatchJob> jobs;
+    for (int i = 0; i < 6; ++i) {
+        const std::string in = (dir / ("in" + std::to_string(i) + ".png")).string();
+        Image img(16 + i, 9, 1);
+        for (int y = 0; y < img.height(); ++y)
+            for (int x = 0; x < img.width(); ++x) img.at(x, y) = (float)((x + y + i) % 4) / 3.0f;
+        if (i == 1) {
+            std::ofstream(in) << "not an image";
+        } else if (i != 3) {
+            img.save(in);
+        }
+        jobs.push_back({in, (dir / "out" / ("out" + std::to_string(i) + ".png")).string()});
+    }
+
+    // job 4's image is 20 wide
+    const BatchProcess<float> process = [](const Image& img) {
+        if (img.width() == 20) throw std::runtime_error("rejected");
+        return img;
+    };
+    BatchOptions options;
+    options.workers = 2;
+    int reported = 0;
+    const std::vector<BatchResult> results =
+        run_batch<float>(jobs, process, options, [&](const BatchResult&) { ++reported; });
+
+    CHECK(reported == (int)jobs.size(), reported << " reports for " << jobs.size() << " jobs");
+    CHECK(results.size() == jobs.size(), results.size() << " results for " << jobs.size() << " jobs");
+    for (size_t i = 0; i < results.size() && i < jobs.size(); ++i) {
+        const bool bad = i == 1 || i == 3 || i == 4;
+        CHECK(results[i].input == jobs[i].input, "result " << i << " is for " << results[i].input);
+        CHECK(results[i].ok() != bad, "job " << i << (bad ? " should fail" : " failed: ") << results[i].error);
+        CHECK(fs::exists(jobs[i].output) != bad, "job " << i << (bad ? " wrote " : " did not write ") << jobs[i].output);
+    }
+    if (results.size() > 4) CHECK(results[4].error.find("rejected") != std::string::npos, results[4].error);
+    return check_failures() != 0;
+}
@@ -0,0 +1,120 @@
+// Run-length labelling against a flood fill, on noise near the
+// percolation threshold and on shapes that only join below a band seam
+// (a U whose arms meet rows later, a staircase of corner contacts), so
+// the stitching across bands decides the labels.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "lumine/components.hpp"
+
+using namespace lumine;
+
+// Components in raster order of their first pixel, and the label of each
+// pixel (-1 for background).
+static std::vector<Component> flood_fill(const BinaryImage& img, bool eight, bool foreground, std::vector<int>& labels) {
+    const int w = img.width(), h = img.height();
+    labels.assign((size_t)w * h, -1);
+    std::vector<Component> out;
+    std::vector<int> stack;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            if (img.get(x, y) != foreground || labels[(size_t)y * w + x] >= 0) continue;
+            const int id = (int)out.size();
+            int x0 = x, x1 = x, y0 = y, y1 = y;
+            int64_t area = 0, sx = 0, sy = 0;
+            labels[(size_t)y * w + x] = id;
+            stack.assign(1, y * w + x);
+            while (!stack.empty()) {
+                const int p = stack.back(), px = p % w, py = p / w;
+                stack.pop_back();
+                ++area; sx += px; sy += py;
+                x0 = std::min(x0, px); x1 = std::max(x1, px); y0 = std::min(y0, py); y1 = std::max(y1, py);
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        if ((dx == 0 && dy == 0) || (!eight && dx != 0 && dy != 0)) continue;
+                        const int nx = px + dx, ny = py + dy;
+                        if (nx < 0 || ny < 0 || nx >= w || ny >= h || img.get(nx, ny) != foreground) continue;
+                        int& l = labels[(size_t)ny * w + nx];
+                        if (l < 0) { l = id; stack.push_back(ny * w + nx); }
+                    }
+            }
+            Component c;
+            c.x = x0; c.y = y0; c.width = x1 - x0 + 1; c.height = y1 - y0 + 1;
+            c.area = area; c.cx = (double)sx / area; c.cy = (double)sy / area;
+            out.push_back(c);
+        }
+    return out;
+}
+
+static void compare(const BinaryImage& img, const char* what, int threads) {
+    for (bool eight : {false, true})
+        for (bool foreground : {true, false}) {
+            std::vector<int> labels;
+            const std::vector<Component> want = flood_fill(img, eight, foreground, labels);
+            const ConnectedComponents cc = ConnectedComponents::label(
+                img, eight ? Connectivity::Eight : Connectivity::Four, foreground, threads);
+            const char* conn = eight ? " c8" : " c4";
+            CHECK(cc.size() == (int)want.size(),
+                  what << conn << " t" << threads << ": " << cc.size() << " components, expected " << want.size());
+            if (cc.size() != (int)want.size()) continue;
+            int wrong = 0;
+            for (int i = 0; i < cc.size(); ++i) {
+                const Component &a = cc.components()[i], &b = want[i];
+                wrong += a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height || a.area != b.area ||
+                         std::fabs(a.cx - b.cx) > 1e-9 || std::fabs(a.cy - b.cy) > 1e-9;
+            }
+            CHECK(wrong == 0, what << conn << " t" << threads << ": " << wrong << " components differ");
+            int64_t covered = 0;
+            int mislabeled = 0;
+            for (const LabeledRun& r : cc.runs())
+                for (int x = r.x0; x < r.x1; ++x) {
+                    ++covered;
+                    mislabeled += labels[(size_t)r.y * img.width() + x] != r.label;
+                }
+            int64_t expected = 0;
+            for (const Component& c : want) expected += c.area;
+            CHECK(covered == expected && mislabeled == 0,
+                  what << conn << " t" << threads << ": runs cover " << covered << " pixels (expected " << expected
+                       << "), " << mislabeled << " with the wrong label");
+        }
+}
+
+int main() {
+    // several 64-row bands even on one thread
+    const int w = 203, h = 517;
+    BinaryImage noise(w, h), shapes(w, h);
+    uint32_t seed = 8080;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            noise.set(x, y, (seed >> 24) < 150);
+        }
+    for (int y = 0; y < h; ++y) {
+        // U shapes: two arms from the top joined by a bar far below
+        for (int i = 0; i < 6; ++i) {
+            const int x0 = 5 + i * 33;
+            if (y < 40 + 70 * i) {
+                shapes.set(x0, y, true);
+                shapes.set(x0 + 20, y, true);
+            } else if (y == 40 + 70 * i) {
+                for (int x = x0; x <= x0 + 20; ++x) shapes.set(x, y, true);
+            }
+        }
+        // a diagonal staircase (corner contacts only) through every seam
+        if (y < w) shapes.set(w - 1 - y, y, true);
+        // a horizontal line exactly on each row that could start a band
+        if (y % 64 == 0 || y % 64 == 63) for (int x = 190; x < w; ++x) shapes.set(x, y, true);
+    }
+
+    std::vector<int> counts = {1, 2};
+    const int hw = (int)std::thread::hardware_concurrency();
+    if (hw > 2) counts.push_back(hw);
+    for (int threads : counts) {
+        compare(noise, "noise", threads);
+        compare(shapes, "shapes", threads);
+    }
+    return check_failures() != 0;
+}
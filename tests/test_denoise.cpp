@@ -0,0 +1,59 @@
+// The median filter against sorting each window, at radii that use the
+// sorting networks (1, 2) and the histogram engine (3+), on an image wide
+// and tall enough to cross its bands and column tiles. Inputs are multiples
+// of 1/255, which the histogram engine represents exactly, so results must
+// match bit for bit, borders included.
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "check.hpp"
+#include "lumine/preprocessing.hpp"
+
+using namespace lumine;
+
+static float brute_force(const Image& in, int x, int y, int c, int radius, Padding pad, std::vector<float>& window) {
+    window.clear();
+    for (int dy = -radius; dy <= radius; ++dy)
+        for (int dx = -radius; dx <= radius; ++dx) {
+            int sx = x + dx, sy = y + dy;
+            if (sx < 0 || sy < 0 || sx >= in.width() || sy >= in.height()) {
+                if (pad == Padding::ZERO) {
+                    window.push_back(0.0f);
+                    continue;
+                }
+                sx = std::min(std::max(sx, 0), in.width() - 1);
+                sy = std::min(std::max(sy, 0), in.height() - 1);
+            }
+            window.push_back(in.at(sx, sy, c));
+        }
+    std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+    return window[window.size() / 2];
+}
+
+int main() {
+    Image in(301, 83, 2);
+    uint32_t seed = 2024;
+    for (int c = 0; c < in.channels(); ++c)
+        for (int y = 0; y < in.height(); ++y)
+            for (int x = 0; x < in.width(); ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                // salt and pepper over a gradient
+                int v = (x + 2 * y + 40 * c) % 256;
+                if ((seed >> 24) < 20) v = (seed >> 16) & 1 ? 255 : 0;
+                in.at(x, y, c) = (float)v / 255.0f;
+            }
+
+    std::vector<float> window;
+    for (int radius : {1, 2, 3, 4, 7, 12})
+        for (Padding pad : {Padding::EDGE, Padding::ZERO}) {
+            const Image out = Preprocessing::denoise(in, radius, pad, 1);
+            int wrong = 0;
+            for (int c = 0; c < in.channels(); ++c)
+                for (int y = 0; y < in.height(); ++y)
+                    for (int x = 0; x < in.width(); ++x)
+                        if (out.at(x, y, c) != brute_force(in, x, y, c, radius, pad, window)) ++wrong;
+            CHECK(wrong == 0, "radius " << radius << (pad == Padding::EDGE ? " edge" : " zero") << ": " << wrong
+                                        << " pixels differ from the sorted window");
+        }
+    return check_failures() != 0;
+}
@@ -0,0 +1,59 @@
+// estimate_skew on synthetic text pages, tilted by hand and by rotate():
+// small angles either way must come back with their sign, and a straight
+// page must read as straight.
+#include <cmath>
+#include <cstdint>
+#include "check.hpp"
+#include "lumine/preprocessing.hpp"
+
+using namespace lumine;
+
+// Lines of box "glyphs" `line` pixels apart, tilted counter-clockwise by
+// `degrees`, with a little noise.
+static Image page(int width, int height, int line, double degrees) {
+    Image img(width, height, 1, Fill::None);
+    const double t = degrees * 3.14159265358979 / 180.0, c = std::cos(t), s = std::sin(t);
+    const double cx = (width - 1) * 0.5, cy = (height - 1) * 0.5;
+    const int cell = line * 11 / 25, glyph = line * 3 / 5;
+    uint32_t seed = 7;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            const double u = cx + (x - cx) * c - (y - cy) * s, v = cy + (x - cx) * s + (y - cy) * c;
+            const int iu = (int)std::floor(u), iv = (int)std::floor(v);
+            float value = 0.92f;
+            if (iu > width / 16 && iu < width - width / 16 && iv > height / 16 && iv < height - height / 16) {
+                const int lx = iu % cell, ly = iv % line;
+                const uint32_t h = (uint32_t)(iu / cell) * 2654435761u + (uint32_t)(iv / line) * 40503u;
+                if (ly < glyph && lx < cell * 3 / 4 && (h >> 28) % 5 != 0 &&
+                    (lx < 2 || lx >= cell * 3 / 4 - 2 || ly < 2 || ly >= glyph - 2))
+                    value = 0.12f;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            img.at(x, y) = value + ((float)(seed >> 8) / 16777216.0f - 0.5f) * 0.06f;
+        }
+    return img;
+}
+
+int main() {
+    struct Size { int width, height, line; double tolerance; };
+    // tolerance: about half a shear step on the finest level searched
+    const Size sizes[] = {{1240, 1754, 25, 0.06}, {800, 600, 20, 0.09}};
+    for (const Size& z : sizes) {
+        const Image straight = page(z.width, z.height, z.line, 0.0);
+        const double zero = Preprocessing::estimate_skew(straight, 5.0, 1);
+        CHECK(std::abs(zero) <= 0.01, z.width << "x" << z.height << ": a straight page reads " << zero);
+        for (double d : {0.1, 0.2, 0.3, 0.5, 1.0, 2.5, 4.0}) {
+            const double drawn_pos = Preprocessing::estimate_skew(page(z.width, z.height, z.line, d), 5.0, 1);
+            const double drawn_neg = Preprocessing::estimate_skew(page(z.width, z.height, z.line, -d), 5.0, 2);
+            const double rot_pos = Preprocessing::estimate_skew(Preprocessing::rotate(straight, d, 1.0f), 5.0, 1);
+            const double rot_neg = Preprocessing::estimate_skew(Preprocessing::rotate(straight, -d, 1.0f), 5.0, 3);
+            for (double e : {drawn_pos, rot_pos})
+                CHECK(std::abs(e - d) <= z.tolerance, z.width << "x" << z.height << ": +" << d << " reads " << e);
+            for (double e : {drawn_neg, rot_neg})
+                CHECK(std::abs(e + d) <= z.tolerance, z.width << "x" << z.height << ": -" << d << " reads " << e);
+            CHECK(std::abs(drawn_pos + drawn_neg) <= 0.01,
+                  z.width << "x" << z.height << ": +-" << d << " read " << drawn_pos << " and " << drawn_neg);
+        }
+    }
+    return check_failures() != 0;
+}
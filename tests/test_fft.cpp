@@ -0,0 +1,67 @@
+// The FFT path against the direct sum on large kernels: they must agree to
+// 1e-6 of sum|w| * max|input|, the bound the README documents.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/kernel.hpp"
+
+using namespace lumine;
+
+int main() {
+    uint32_t seed = 4242;
+    auto next = [&] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / 16777216.0f;
+    };
+    Image in(157, 113, 2);
+    float max_in = 0.0f;
+    for (int c = 0; c < in.channels(); ++c)
+        for (int y = 0; y < in.height(); ++y)
+            for (int x = 0; x < in.width(); ++x) {
+                in.at(x, y, c) = 4.0f * next() - 1.0f;
+                max_in = std::max(max_in, std::fabs(in.at(x, y, c)));
+            }
+
+    // square and rectangular, odd and even sides
+    const int sizes[][2] = {{31, 31}, {33, 21}, {17, 45}, {40, 40}, {64, 7}};
+    for (const auto& wh : sizes) {
+        std::vector<float> w((size_t)wh[0] * wh[1]);
+        double sum_abs = 0.0;
+        for (float& v : w) {
+            v = next() - 0.5f;
+            sum_abs += std::fabs(v);
+        }
+        const Kernel K(wh[0], wh[1], w);
+        const double bound = 1e-6 * sum_abs * max_in;
+        for (Padding pad : {Padding::ZERO, Padding::EDGE})
+            for (int stride : {1, 2, 3}) {
+                ConvParams params;
+                params.padding = pad;
+                params.stride = stride;
+                params.viz = VizMode::None;
+                params.threads = 1;
+                params.algo = ConvAlgo::Direct;
+                const Image direct = Convolver::convolve(in, K, params);
+                params.algo = ConvAlgo::FFT;
+                const Image fft = Convolver::convolve(in, K, params);
+                const std::string what = std::to_string(wh[0]) + "x" + std::to_string(wh[1]) +
+                                         (pad == Padding::EDGE ? " edge" : " zero") + " stride " +
+                                         std::to_string(stride);
+                CHECK(fft.width() == direct.width() && fft.height() == direct.height() &&
+                          fft.channels() == direct.channels(),
+                      what << ": FFT output has a different shape");
+                if (fft.width() != direct.width() || fft.height() != direct.height()) continue;
+                double worst = 0.0;
+                for (int c = 0; c < fft.channels(); ++c)
+                    for (int y = 0; y < fft.height(); ++y)
+                        for (int x = 0; x < fft.width(); ++x)
+                            worst = std::max(worst, (double)std::fabs(fft.at(x, y, c) - direct.at(x, y, c)));
+                CHECK(worst <= bound, what << ": FFT is " << worst << " off direct, bound " << bound);
+            }
+    }
+    return check_failures() != 0;
+}
@@ -0,0 +1,67 @@
+// Word-parallel morphology against counting each clipped rectangle with a
+// summed-area table, at radii that are not powers of two (the doubling
+// spans must not overshoot) and on widths that end mid-word.
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "check.hpp"
+#include "lumine/binary_image.hpp"
+
+using namespace lumine;
+
+// Set pixels of the rectangle around each pixel, clipped at the border,
+// compared with its full size (erode) or with zero (dilate).
+static BinaryImage brute_force(const BinaryImage& in, int rx, int ry, bool erode) {
+    const int w = in.width(), h = in.height();
+    std::vector<int64_t> sat((size_t)(w + 1) * (h + 1), 0);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            sat[(size_t)(y + 1) * (w + 1) + x + 1] = in.get(x, y) + sat[(size_t)y * (w + 1) + x + 1] +
+                                                     sat[(size_t)(y + 1) * (w + 1) + x] - sat[(size_t)y * (w + 1) + x];
+    BinaryImage out(w, h);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const int x0 = std::max(0, x - rx), x1 = std::min(w, x + rx + 1);
+            const int y0 = std::max(0, y - ry), y1 = std::min(h, y + ry + 1);
+            const int64_t n = sat[(size_t)y1 * (w + 1) + x1] - sat[(size_t)y0 * (w + 1) + x1] -
+                              sat[(size_t)y1 * (w + 1) + x0] + sat[(size_t)y0 * (w + 1) + x0];
+            out.set(x, y, erode ? n == (int64_t)(x1 - x0) * (y1 - y0) : n > 0);
+        }
+    return out;
+}
+
+static int differences(const BinaryImage& a, const BinaryImage& b) {
+    if (a.width() != b.width() || a.height() != b.height()) return -1;
+    int n = 0;
+    for (int y = 0; y < a.height(); ++y)
+        for (int x = 0; x < a.width(); ++x) n += a.get(x, y) != b.get(x, y);
+    return n;
+}
+
+int main() {
+    // blobs and specks, dense enough that erosion keeps something
+    BinaryImage in(237, 101);
+    uint32_t seed = 31337;
+    for (int y = 0; y < in.height(); ++y)
+        for (int x = 0; x < in.width(); ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            const bool blob = ((x / 23) * 7 + (y / 17) * 3) % 4 != 0;
+            in.set(x, y, blob ? (seed >> 24) > 12 : (seed >> 24) < 40);
+        }
+
+    const int radii[][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}, {2, 3}, {3, 2}, {5, 5},
+                            {6, 1}, {7, 7}, {13, 9}, {31, 4}, {33, 17}, {63, 0}, {65, 3}, {100, 50}};
+    for (const auto& r : radii) {
+        const int rx = r[0], ry = r[1];
+        const BinaryImage er = brute_force(in, rx, ry, true), di = brute_force(in, rx, ry, false);
+        int d = differences(Morphology::erode(in, rx, ry, 1), er);
+        CHECK(d == 0, "erode " << rx << "x" << ry << ": " << d << " pixels differ");
+        d = differences(Morphology::dilate(in, rx, ry, 1), di);
+        CHECK(d == 0, "dilate " << rx << "x" << ry << ": " << d << " pixels differ");
+        d = differences(Morphology::open(in, rx, ry, 1), brute_force(er, rx, ry, false));
+        CHECK(d == 0, "open " << rx << "x" << ry << ": " << d << " pixels differ");
+        d = differences(Morphology::close(in, rx, ry, 1), brute_force(di, rx, ry, true));
+        CHECK(d == 0, "close " << rx << "x" << ry << ": " << d << " pixels differ");
+    }
+    return check_failures() != 0;
+}
@@ -0,0 +1,100 @@
+// Pipeline::run on a ROI against the same pipeline on the whole image,
+// cropped: stages must read the ROI's real neighbours.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include "check.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/filter_bank.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/pipeline.hpp"
+
+using namespace lumine;
+
+static float max_difference(ConstImageView a, ConstImageView b) {
+    if (a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels()) return INFINITY;
+    float worst = 0.0f;
+    for (int c = 0; c < a.channels(); ++c)
+        for (int y = 0; y < a.height(); ++y)
+            for (int x = 0; x < a.width(); ++x) worst = std::max(worst, std::fabs(a.at(x, y, c) - b.at(x, y, c)));
+    return worst;
+}
+
+struct Roi { int x, y, w, h; };
+
+int main() {
+    Image img(173, 131, 3);
+    uint32_t seed = 777;
+    for (int c = 0; c < img.channels(); ++c)
+        for (int y = 0; y < img.height(); ++y)
+            for (int x = 0; x < img.width(); ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                img.at(x, y, c) = (float)(seed >> 8) / 16777216.0f;
+            }
+    const Roi rois[] = {{40, 30, 100, 60}, {0, 0, 50, 40}, {120, 90, 53, 41}, {0, 20, 173, 30}, {1, 1, 171, 129}};
+
+    ConvParams edge;
+    edge.padding = Padding::EDGE;
+    ConvParams zero2;
+    zero2.stride = 2;
+    // Exact except where the ROI's width moves pixels between the SIMD body
+    // and the scalar tail of an operation whose two paths round differently:
+    // the bank's sum of squares is fused in the AVX2 body only.
+    struct Case { std::string name; Pipeline p; float tolerance; };
+    std::vector<Case> cases;
+    cases.push_back({"denoise", Pipeline().denoise(2), 0.0f});
+    cases.push_back({"denoise zero", Pipeline().denoise(1, Padding::ZERO), 0.0f});
+    cases.push_back({"gray denoise binarize", Pipeline().grayscale().denoise(1).binarize(0.2f, 15), 0.0f});
+    cases.push_back({"gauss5 then sobel_mag", Pipeline().convolve(Kernel::from_builtin("gauss5"), edge)
+                                                  .filter_bank(FilterBank::from_builtin("sobel_mag"), edge), 1e-6f});
+    // FIR tails use the same (fused or not) multiply-add as their SIMD body
+    cases.push_back({"denoise stride 2", Pipeline().denoise(1).convolve(Kernel::from_builtin("box3"), zero2), 0.0f});
+    cases.back().p.strip_rows(8);
+
+    for (Case& t : cases) {
+        const Image whole = t.p.run(img, 1);
+        for (const Roi& r : rois) {
+            // strided output of a ROI only lines up with the whole image's
+            // on even offsets
+            if (t.name == "denoise stride 2" && (r.x % 2 || r.y % 2)) continue;
+            const int s = t.name == "denoise stride 2" ? 2 : 1;
+            const Image part = t.p.run(img.view(r.x, r.y, r.w, r.h), 2);
+            const ConstImageView expect = whole.view(r.x / s, r.y / s, part.width(), part.height());
+            const float d = max_difference(part, expect);
+            CHECK(d <= t.tolerance, t.name << " ROI " << r.x << "," << r.y << " differs by " << d);
+
+            // into a caller's view, inside a larger image
+            Image big(part.width() + 7, part.height() + 5, part.channels());
+            t.p.run(img.view(r.x, r.y, r.w, r.h), big.view(3, 2, part.width(), part.height()), 1);
+            const float e = max_difference(big.view(3, 2, part.width(), part.height()), part);
+            CHECK(e == 0.0f, t.name << " ROI " << r.x << "," << r.y << " into a view differs by " << e);
+        }
+    }
+
+    // taps on a ROI see the ROI's part of each stage; the denoise before
+    // this one is exact
+    Image whole_tap, part_tap;
+    const Roi r{30, 20, 90, 70};
+    Pipeline().denoise(2).tap([&](const Image& i) { whole_tap = i; }).convolve(Kernel::from_builtin("gauss5"), edge)
+        .run(img, 1);
+    Pipeline().denoise(2).tap([&](const Image& i) { part_tap = i; }).convolve(Kernel::from_builtin("gauss5"), edge)
+        .run(img.view(r.x, r.y, r.w, r.h), 1);
+    const float d = max_difference(part_tap, whole_tap.view(r.x, r.y, r.w, r.h));
+    CHECK(d == 0.0f, "tap on a ROI differs by " << d);
+
+    // a single stage matches the one-shot operation on the ROI, also with
+    // Normalize and a stride that leaves the ROI off the image's grid
+    ConvParams norm = edge;
+    norm.viz = VizMode::Normalize;
+    norm.stride = 3;
+    const Kernel sharpen = Kernel::from_builtin("sharpen");
+    for (const Roi& q : rois) {
+        const ConstImageView roi = img.view(q.x, q.y, q.w, q.h);
+        const float e = max_difference(Pipeline().convolve(sharpen, norm).run(roi, 1),
+                                       Convolver::convolve(roi, sharpen, norm));
+        CHECK(e == 0.0f, "normalized stride-3 ROI " << q.x << "," << q.y << " differs from Convolver by " << e);
+    }
+
+    return check_failures() != 0;
+}
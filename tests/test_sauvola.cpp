@@ -0,0 +1,56 @@
+// Sauvola binarization against a brute-force window sum per pixel. Inputs
+// are multiples of 1/256, so every sum is exact in double and the running
+// sums must reproduce the brute-force threshold bit for bit.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "check.hpp"
+#include "lumine/preprocessing.hpp"
+
+using namespace lumine;
+
+static float brute_force(const Image& in, int x, int y, float k, int window_size) {
+    const int half = std::max(0, window_size / 2);
+    const int x0 = std::max(0, x - half), x1 = std::min(in.width() - 1, x + half);
+    const int y0 = std::max(0, y - half), y1 = std::min(in.height() - 1, y + half);
+    double sum = 0.0, sq_sum = 0.0;
+    for (int sy = y0; sy <= y1; ++sy)
+        for (int sx = x0; sx <= x1; ++sx) {
+            sum += in.at(sx, sy);
+            sq_sum += (double)in.at(sx, sy) * in.at(sx, sy);
+        }
+    const double n = (double)(y1 - y0 + 1) * (x1 - x0 + 1);
+    const double mean = sum / n;
+    const double stddev = std::sqrt(std::max(0.0, sq_sum / n - mean * mean));
+    const double threshold = mean * (1 + k * (stddev / 128 - 1));
+    return in.at(x, y) > threshold ? 1.0f : 0.0f;
+}
+
+int main() {
+    // text-like: a bright page with a slow gradient, dark strokes and noise
+    Image page(131, 97, 1);
+    uint32_t seed = 99;
+    for (int y = 0; y < page.height(); ++y)
+        for (int x = 0; x < page.width(); ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            int v = 200 - x / 8 + (int)(seed >> 28);
+            if ((x / 7 + y / 11) % 5 == 0) v = 30 + (int)(seed >> 27);
+            page.at(x, y) = (float)std::min(255, std::max(0, v)) / 256.0f;
+        }
+
+    // even, small, band-sized and larger-than-image windows
+    for (int window_size : {1, 2, 3, 15, 16, 31, 71, 301})
+        for (float k : {0.2f, 0.5f}) {
+            const Image out = Preprocessing::sauvola_binarization(page, k, window_size, 1);
+            int wrong = 0, first_x = -1, first_y = -1;
+            for (int y = 0; y < page.height(); ++y)
+                for (int x = 0; x < page.width(); ++x)
+                    if (out.at(x, y) != brute_force(page, x, y, k, window_size) && wrong++ == 0) {
+                        first_x = x;
+                        first_y = y;
+                    }
+            CHECK(wrong == 0, "window " << window_size << " k " << k << ": " << wrong << " pixels differ, first at ("
+                                        << first_x << ", " << first_y << ")");
+        }
+    return check_failures() != 0;
+}
@@ -0,0 +1,69 @@
+// Streaming never holds whole columns: a large gauss: blur that Auto would
+// run as the recursive Gaussian streams through the separable FIR, and an
+// explicit recursive Gaussian is refused.
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "check.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/kernel.hpp"
+#include "lumine/pipeline.hpp"
+#include "lumine/stream.hpp"
+
+using namespace lumine;
+
+static std::string slurp(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+int main() {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "lumine_test_stream_blur";
+    std::filesystem::create_directories(dir);
+    const std::string in = (dir / "in.pgm").string();
+    Image img(300, 700, 1);
+    uint32_t seed = 99;
+    for (int y = 0; y < img.height(); ++y)
+        for (int x = 0; x < img.width(); ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            img.at(x, y) = (float)(seed >> 24) / 255.0f;
+        }
+    img.save(in);
+
+    const Kernel K = Kernel::from_builtin("gauss:20");
+    ConvParams params;
+    params.padding = Padding::EDGE;
+    CHECK(Convolver::choose_algorithm(K, img.width(), img.height(), params) == ConvAlgo::Recursive,
+          "gauss:20 no longer plans recursive; pick a larger sigma");
+
+    // streamed Auto == in-memory separable, byte for byte
+    Pipeline streamed;
+    streamed.convolve(K, params).strip_rows(32);
+    {
+        std::unique_ptr<ImageReader> reader = ImageReader::open(in);
+        std::unique_ptr<ImageWriter> writer = ImageWriter::open((dir / "stream.pgm").string(), 300, 700, 1);
+        streamed.run(*reader, *writer, 2);
+    }
+    ConvParams fir = params;
+    fir.algo = ConvAlgo::Separable;
+    Pipeline().convolve(K, fir).run(Image::load(in), 2).save((dir / "memory.pgm").string());
+    CHECK(slurp((dir / "stream.pgm").string()) == slurp((dir / "memory.pgm").string()),
+          "streamed gauss:20 differs from the separable result");
+
+    ConvParams recursive = params;
+    recursive.algo = ConvAlgo::Recursive;
+    bool threw = false;
+    try {
+        std::unique_ptr<ImageReader> reader = ImageReader::open(in);
+        std::unique_ptr<ImageWriter> writer = ImageWriter::open((dir / "refused.pgm").string(), 300, 700, 1);
+        Pipeline().convolve(K, recursive).run(*reader, *writer, 1);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw, "streaming an explicit recursive Gaussian did not throw");
+
+    std::filesystem::remove_all(dir);
+    return check_failures() != 0;
+}
@@ -0,0 +1,66 @@
+// Row bands keep each output pixel's serial accumulation order, so a
+// convolution must come out bit-identical for any thread count.
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/kernel.hpp"
+
+using namespace lumine;
+
+static bool same(const Image& a, const Image& b) {
+    if (a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels()) return false;
+    for (int c = 0; c < a.channels(); ++c)
+        for (int y = 0; y < a.height(); ++y)
+            for (int x = 0; x < a.width(); ++x)
+                if (!(a.at(x, y, c) == b.at(x, y, c))) return false;
+    return true;
+}
+
+int main() {
+    // large enough for several ~64 KiB bands per pass
+    Image in(403, 301, 2);
+    uint32_t seed = 777;
+    auto next = [&] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / 16777216.0f;
+    };
+    for (int c = 0; c < in.channels(); ++c)
+        for (int y = 0; y < in.height(); ++y)
+            for (int x = 0; x < in.width(); ++x) in.at(x, y, c) = next();
+
+    std::vector<std::pair<std::string, Kernel>> kernels;
+    for (const char* name : {"identity", "box3", "box5", "sharpen", "sobel_x", "sobel_y", "gauss5"})
+        kernels.emplace_back(name, Kernel::from_builtin(name));
+    std::vector<float> dense(7 * 5), kx = {0.1f, -0.3f, 0.7f, 0.2f, -0.05f}, ky = {0.4f, 0.25f, -0.6f};
+    for (float& w : dense) w = next() - 0.5f;
+    std::vector<float> outer;
+    for (float a : ky)
+        for (float b : kx) outer.push_back(a * b);
+    kernels.emplace_back("custom 7x5", Kernel(7, 5, dense));
+    kernels.emplace_back("custom separable 5x3", Kernel(5, 3, outer));
+
+    std::vector<int> counts = {2};
+    const int hw = (int)std::thread::hardware_concurrency();
+    if (hw > 2) counts.push_back(hw);
+
+    for (const auto& k : kernels)
+        for (Padding pad : {Padding::ZERO, Padding::EDGE})
+            for (int stride : {1, 2}) {
+                ConvParams params;
+                params.padding = pad;
+                params.stride = stride;
+                params.viz = VizMode::None;
+                params.threads = 1;
+                const Image serial = Convolver::convolve(in, k.second, params);
+                for (int threads : counts) {
+                    params.threads = threads;
+                    CHECK(same(Convolver::convolve(in, k.second, params), serial),
+                          k.first << (pad == Padding::EDGE ? " edge" : " zero") << " stride " << stride << ": "
+                                  << threads << " threads differ from 1");
+                }
+            }
+    return check_failures() != 0;
+}
@@ -0,0 +1,74 @@
+// The 8-bit fixed-point path against the float path on blurs: the weights
+// are quantised, so the two may differ by one level, never more.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "lumine/convolver.hpp"
+#include "lumine/kernel.hpp"
+
+using namespace lumine;
+
+static int max_difference(const Image8& in, const Kernel& K, const ConvParams& params) {
+    const Image8 q = Convolver::convolve(in, K, params);
+    const Image8 f = Convolver::convolve(in.convert<float>(), K, params).convert<uint8_t>();
+    int worst = 0;
+    for (int c = 0; c < q.channels(); ++c)
+        for (int y = 0; y < q.height(); ++y)
+            for (int x = 0; x < q.width(); ++x) worst = std::max(worst, std::abs(q.at(x, y, c) - f.at(x, y, c)));
+    return worst;
+}
+
+int main() {
+    Image8 noise(97, 61, 2), flat(97, 61, 1);
+    uint32_t seed = 12345;
+    for (int c = 0; c < noise.channels(); ++c)
+        for (int y = 0; y < noise.height(); ++y)
+            for (int x = 0; x < noise.width(); ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                noise.at(x, y, c) = (uint8_t)(seed >> 24);
+            }
+    for (int y = 0; y < flat.height(); ++y)
+        for (int x = 0; x < flat.width(); ++x) flat.at(x, y) = 255;
+
+    // every blur builtin up to 25 taps a side
+    std::vector<std::string> names = {"box3", "box5", "gauss5"};
+    for (const char* s : {"0.5", "0.8", "1", "1.5", "2", "2.5", "3"}) names.push_back(std::string("gauss:") + s);
+    for (int r = 1; r <= 12; ++r) names.push_back("box:" + std::to_string(r));
+
+    for (const std::string& name : names) {
+        const Kernel K = Kernel::from_builtin(name);
+        for (Padding pad : {Padding::ZERO, Padding::EDGE})
+            for (int stride : {1, 2}) {
+                ConvParams params;
+                params.padding = pad;
+                params.stride = stride;
+                params.threads = 1;
+                const int d = max_difference(noise, K, params);
+                CHECK(d <= 1, name << " stride " << stride << ": u8 and float differ by " << d);
+                if (pad == Padding::EDGE) {
+                    const Image8 out = Convolver::convolve(flat, K, params);
+                    int lo = 255;
+                    for (int y = 0; y < out.height(); ++y)
+                        for (int x = 0; x < out.width(); ++x) lo = std::min(lo, (int)out.at(x, y));
+                    CHECK(lo == 255, name << " stride " << stride << ": a flat 255 image blurs to " << lo);
+                }
+            }
+    }
+
+    // a custom separable kernel of small taps, 7x7
+    std::string spec;
+    const float f[7] = {1, 3, 6, 8, 6, 3, 1};
+    for (int y = 0; y < 7; ++y) {
+        for (int x = 0; x < 7; ++x) spec += std::to_string(f[y] * f[x] / 784.0f) + " ";
+        spec += ";";
+    }
+    ConvParams params;
+    params.padding = Padding::EDGE;
+    const int d = max_difference(noise, Kernel::from_string(spec), params);
+    CHECK(d <= 1, "custom 7x7: u8 and float differ by " << d);
+
+    return check_failures() != 0;
+}